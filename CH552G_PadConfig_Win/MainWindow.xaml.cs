@@ -25,9 +25,10 @@ namespace CH552G_PadConfig_Win
             var hidCommunicator = new HidCommunicator(_logger);
             var profileManager = new ProfileManager(_logger);
             var settings = AppSettings.Load();
+            var deviceCache = DeviceCache.Load();
 
             // Initialize ViewModel
-            _viewModel = new MainViewModel(hidCommunicator, profileManager, settings);
+            _viewModel = new MainViewModel(hidCommunicator, profileManager, settings, deviceCache);
             DataContext = _viewModel;
 
             // Window size from settings
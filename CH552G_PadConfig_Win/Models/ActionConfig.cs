@@ -15,7 +15,10 @@ public class ActionConfig
         Keyboard = 0x1,
         Media = 0x2,
         Mouse = 0x3,
-        Scroll = 0x4
+        Scroll = 0x4,
+        Macro = 0x5,
+        Host = 0x6,     // Event report for tools/pad_hostd.py (host-events firmware)
+        Script = 0x7    // Bytecode script compiled by tools/script_compile.py
     }
 
     // Modifiers (bits 4-7 of control byte)
@@ -119,6 +122,9 @@ public class ActionConfig
             ActionType.Media => GetMediaDescription(),
             ActionType.Mouse => GetMouseDescription(),
             ActionType.Scroll => GetScrollDescription(),
+            ActionType.Macro => $"Macro #{PrimaryValue}",
+            ActionType.Host => "Host Action",
+            ActionType.Script => $"Script #{PrimaryValue}",
             _ => "Unknown"
         };
 
@@ -79,6 +79,70 @@ public class DeviceConfiguration
         }
     }
 
+    /// <summary>
+    /// Size of the action table exchanged by READ_CONFIG / WRITE_ALL (15 x 8 bytes)
+    /// </summary>
+    public const int ImageSize = 15 * 8;
+
+    /// <summary>
+    /// Serialize all actions to the firmware action table image
+    /// </summary>
+    public byte[] ToImage()
+    {
+        var image = new byte[ImageSize];
+        var actions = GetAllActions();
+
+        for (int i = 0; i < actions.Length; i++)
+        {
+            Array.Copy(actions[i].ToBytes(), 0, image, i * 8, 8);
+        }
+
+        return image;
+    }
+
+    /// <summary>
+    /// Build a configuration from a firmware action table image
+    /// </summary>
+    public static DeviceConfiguration FromImage(byte[] image, byte activeSlot, byte ledBrightness)
+    {
+        if (image.Length != ImageSize)
+            throw new ArgumentException($"Image must be {ImageSize} bytes");
+
+        var config = new DeviceConfiguration
+        {
+            ActiveSlot = activeSlot,
+            LedBrightness = ledBrightness,
+            ProfileName = "Device Configuration"
+        };
+
+        var actions = new ActionConfig[15];
+        for (int i = 0; i < actions.Length; i++)
+        {
+            actions[i] = ActionConfig.FromBytes(image[(i * 8)..(i * 8 + 8)]);
+        }
+        config.SetAllActions(actions);
+
+        return config;
+    }
+
+    /// <summary>
+    /// Fletcher-16 over the image, active slot and LED brightness
+    /// Matches firmware configFingerprint() (GET_INFO bytes 37-38)
+    /// </summary>
+    public static ushort Fingerprint(byte[] image, byte activeSlot, byte ledBrightness)
+    {
+        int sum1 = 0;
+        int sum2 = 0;
+
+        foreach (var b in image.Append(activeSlot).Append(ledBrightness))
+        {
+            sum1 = (sum1 + b) % 255;
+            sum2 = (sum2 + sum1) % 255;
+        }
+
+        return (ushort)((sum2 << 8) | sum1);
+    }
+
     /// <summary>
     /// Create default configuration matching firmware defaults
     /// </summary>
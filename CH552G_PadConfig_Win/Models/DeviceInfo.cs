@@ -17,6 +17,11 @@ public class DeviceInfo
     public string BuildDate { get; set; } = string.Empty;
     public string GitHash { get; set; } = string.Empty;
 
+    /// <summary>
+    /// Fingerprint of the device's current configuration (0 on older firmware)
+    /// </summary>
+    public ushort ConfigFingerprint { get; set; }
+
     public string FirmwareVersion => $"{FirmwareMajor}.{FirmwareMinor}.{FirmwarePatch}";
 
     public override string ToString()
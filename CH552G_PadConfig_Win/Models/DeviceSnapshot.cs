@@ -0,0 +1,62 @@
+namespace CH552G_PadConfig_Win.Models;
+
+/// <summary>
+/// Last known state of one device: the raw READ_CONFIG image plus the
+/// app-side slot names. Kept in DeviceCache, keyed by USB serial number.
+/// </summary>
+public class DeviceSnapshot
+{
+    /// <summary>
+    /// Action table exactly as the device returned it (8 bytes per action)
+    /// </summary>
+    public byte[] Image { get; set; } = Array.Empty<byte>();
+
+    public byte ActiveSlot { get; set; }
+    public byte LedBrightness { get; set; }
+
+    /// <summary>
+    /// Names the user gave the slots (not stored on the device)
+    /// </summary>
+    public string[] SlotNames { get; set; } = Array.Empty<string>();
+
+    public string Firmware { get; set; } = string.Empty;
+    public DateTime LastSeen { get; set; } = DateTime.Now;
+
+    /// <summary>
+    /// Matches firmware configFingerprint(), reported in GET_INFO bytes 37-38
+    /// </summary>
+    public ushort Fingerprint => DeviceConfiguration.Fingerprint(Image, ActiveSlot, LedBrightness);
+
+    /// <summary>
+    /// Indices (slot * 5 + input) of the actions that differ from the device
+    /// </summary>
+    public List<int> GetChangedActions(DeviceConfiguration config)
+    {
+        var image = config.ToImage();
+        var changed = new List<int>();
+
+        for (int i = 0; i < image.Length / 8; i++)
+        {
+            if (i * 8 + 8 > Image.Length ||
+                !image.AsSpan(i * 8, 8).SequenceEqual(Image.AsSpan(i * 8, 8)))
+            {
+                changed.Add(i);
+            }
+        }
+
+        return changed;
+    }
+
+    /// <summary>
+    /// Build an editable configuration from the image
+    /// </summary>
+    public DeviceConfiguration ToConfiguration()
+    {
+        var config = DeviceConfiguration.FromImage(Image, ActiveSlot, LedBrightness);
+        for (int i = 0; i < Math.Min(SlotNames.Length, config.Slots.Length); i++)
+        {
+            config.Slots[i].Name = SlotNames[i];
+        }
+        return config;
+    }
+}
@@ -0,0 +1,102 @@
+using System.IO;
+using System.Text.Json;
+using CH552G_PadConfig_Win.Models;
+
+namespace CH552G_PadConfig_Win.Services;
+
+/// <summary>
+/// Last known configuration of every device, keyed by USB serial number
+/// Saved to %AppData%\CH552G_PadConfig\devices.json
+/// A known device whose GET_INFO fingerprint still matches needs no READ_CONFIG
+/// </summary>
+public class DeviceCache
+{
+    private static readonly string CacheFilePath = Path.Combine(
+        Environment.GetFolderPath(Environment.SpecialFolder.ApplicationData),
+        "CH552G_PadConfig",
+        "devices.json"
+    );
+
+    private static readonly JsonSerializerOptions JsonOptions = new()
+    {
+        WriteIndented = true
+    };
+
+    public Dictionary<string, DeviceSnapshot> Devices { get; set; } = new();
+
+    /// <summary>
+    /// Cached snapshot if it still matches the device, otherwise null
+    /// </summary>
+    public DeviceSnapshot? Get(string serial, DeviceInfo info)
+    {
+        if (!Devices.TryGetValue(serial, out var snapshot))
+            return null;
+
+        // Older firmware reports no fingerprint - always read those
+        if (info.ConfigFingerprint == 0 ||
+            snapshot.Firmware != info.FirmwareVersion ||
+            snapshot.Image.Length != info.TotalActions * 8 ||
+            snapshot.Fingerprint != info.ConfigFingerprint)
+            return null;
+
+        snapshot.LastSeen = DateTime.Now;
+        return snapshot;
+    }
+
+    /// <summary>
+    /// Store a snapshot; slot names are carried over from the previous entry
+    /// when the snapshot has none (fresh READ_CONFIG)
+    /// </summary>
+    public void Put(string serial, DeviceSnapshot snapshot)
+    {
+        if (snapshot.SlotNames.Length == 0 && Devices.TryGetValue(serial, out var previous))
+        {
+            snapshot.SlotNames = previous.SlotNames;
+        }
+
+        snapshot.LastSeen = DateTime.Now;
+        Devices[serial] = snapshot;
+        Save();
+    }
+
+    /// <summary>
+    /// Save cache to disk
+    /// </summary>
+    public bool Save()
+    {
+        try
+        {
+            Directory.CreateDirectory(Path.GetDirectoryName(CacheFilePath)!);
+
+            var json = JsonSerializer.Serialize(this, JsonOptions);
+            File.WriteAllText(CacheFilePath, json);
+            return true;
+        }
+        catch
+        {
+            return false;
+        }
+    }
+
+    /// <summary>
+    /// Load cache from disk, or start empty if not found
+    /// </summary>
+    public static DeviceCache Load()
+    {
+        try
+        {
+            if (File.Exists(CacheFilePath))
+            {
+                var json = File.ReadAllText(CacheFilePath);
+                var cache = JsonSerializer.Deserialize<DeviceCache>(json, JsonOptions);
+                return cache ?? new DeviceCache();
+            }
+        }
+        catch
+        {
+            // Fall through to empty cache
+        }
+
+        return new DeviceCache();
+    }
+}
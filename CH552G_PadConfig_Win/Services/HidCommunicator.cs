@@ -22,11 +22,19 @@ public class HidCommunicator
     private const byte CMD_SET_SLOT = 0x05;
     private const byte CMD_FACTORY_RESET = 0x06;
 
+    private const int CONFIG_PACKET_BYTES = 56; // Action bytes per READ_CONFIG / WRITE_ALL packet
+    private const byte KEEP_ACTIVE_SLOT = 0xFF; // WRITE_ALL slot value the firmware ignores
+
     private readonly DebugLogger? _logger;
     private HidDevice? _device;
 
     public bool IsConnected => _device != null;
 
+    /// <summary>
+    /// USB serial number of the connected device (cache key)
+    /// </summary>
+    public string SerialNumber { get; private set; } = string.Empty;
+
     public HidCommunicator(DebugLogger? logger = null)
     {
         _logger = logger;
@@ -68,10 +76,11 @@ public class HidCommunicator
                     if (maxFeatureLength >= 64)
                     {
                         _device = device;
+                        SerialNumber = _device.TryGetSerialNumber(out var serial) ? serial : string.Empty;
                         _logger?.LogSuccess($"Selected vendor configuration collection");
                         _logger?.Log($"  Product: {_device.GetProductName()}");
                         _logger?.Log($"  Manufacturer: {_device.GetManufacturer()}");
-                        _logger?.Log($"  Serial: {_device.GetSerialNumber()}");
+                        _logger?.Log($"  Serial: {SerialNumber}");
                         _logger?.Log($"  Path: {_device.DevicePath}");
                         return true;
                     }
@@ -133,7 +142,8 @@ public class HidCommunicator
                 MaxInputs = response[10],
                 TotalActions = response[11],
                 BuildDate = System.Text.Encoding.ASCII.GetString(response, 12, 8).Trim('\0'),
-                GitHash = System.Text.Encoding.ASCII.GetString(response, 20, 16).Trim('\0')
+                GitHash = System.Text.Encoding.ASCII.GetString(response, 20, 16).Trim('\0'),
+                ConfigFingerprint = (ushort)(response[37] | (response[38] << 8))
             };
 
             _logger?.LogSuccess($"Device info: {info}");
@@ -146,6 +156,72 @@ public class HidCommunicator
         }
     }
 
+    /// <summary>
+    /// Read the full action table (one READ_CONFIG transfer per 56-byte packet)
+    /// </summary>
+    public DeviceSnapshot? ReadConfig(DeviceInfo info)
+    {
+        if (_device == null)
+        {
+            _logger?.LogError("No device connected");
+            return null;
+        }
+
+        try
+        {
+            var image = new byte[info.TotalActions * 8];
+            int packets = GetPacketCount(image.Length);
+            byte activeSlot = 0;
+            byte ledBrightness = 0;
+
+            _logger?.Log($"Reading configuration ({packets} packets)...");
+
+            for (int sequence = 0; sequence < packets; sequence++)
+            {
+                byte[] request = new byte[REPORT_SIZE];
+                request[0] = REPORT_ID;
+                request[1] = CMD_READ_CONFIG;
+                request[2] = (byte)sequence;
+                request[63] = CalculateChecksum(request);
+
+                byte[] response = new byte[REPORT_SIZE];
+                if (!SendFeatureReport(request, response))
+                    return null;
+
+                if (response[1] != CMD_READ_CONFIG || response[2] != sequence || response[3] != packets)
+                {
+                    _logger?.LogError($"Unexpected READ_CONFIG response: packet {response[2]} of {response[3]}, expected {sequence} of {packets}");
+                    return null;
+                }
+
+                int offset = sequence * CONFIG_PACKET_BYTES;
+                Array.Copy(response, 4, image, offset, Math.Min(CONFIG_PACKET_BYTES, image.Length - offset));
+
+                if (sequence == 0)
+                {
+                    // Packet 0 carries the status bytes after its actions
+                    activeSlot = response[60];
+                    ledBrightness = response[62];
+                }
+            }
+
+            _logger?.LogSuccess($"Configuration read ({image.Length} bytes, active slot {activeSlot})");
+
+            return new DeviceSnapshot
+            {
+                Image = image,
+                ActiveSlot = activeSlot,
+                LedBrightness = ledBrightness,
+                Firmware = info.FirmwareVersion
+            };
+        }
+        catch (Exception ex)
+        {
+            _logger?.LogError($"Failed to read configuration: {ex.Message}");
+            return null;
+        }
+    }
+
     /// <summary>
     /// Write a single action to the device
     /// </summary>
@@ -208,7 +284,7 @@ public class HidCommunicator
 
     /// <summary>
     /// Write complete configuration to device (all 15 actions)
-    /// Uses 3-packet transfer protocol
+    /// Uses the multi-packet WRITE_ALL protocol, active slot unchanged
     /// </summary>
     public bool WriteAllConfig(DeviceConfiguration config)
     {
@@ -222,15 +298,58 @@ public class HidCommunicator
         {
             _logger?.Log("Writing full configuration (15 actions)...");
 
-            var allActions = config.GetAllActions();
+            if (!WriteAllPackets(config.ToImage()))
+                return false;
 
-            // Write all 15 actions individually (simpler than multi-packet)
-            for (byte slot = 0; slot < 3; slot++)
+            _logger?.LogSuccess("Configuration written successfully");
+            return true;
+        }
+        catch (Exception ex)
+        {
+            _logger?.LogError($"Failed to write configuration: {ex.Message}");
+            return false;
+        }
+    }
+
+    /// <summary>
+    /// Write only the actions that differ from the device snapshot
+    /// Single WRITE_ACTIONs when they need fewer transfers than WRITE_ALL
+    /// On success the snapshot holds the new device image
+    /// </summary>
+    public bool WriteChanges(DeviceSnapshot device, DeviceConfiguration config)
+    {
+        if (_device == null)
+        {
+            _logger?.LogError("No device connected");
+            return false;
+        }
+
+        try
+        {
+            var image = config.ToImage();
+            if (device.Image.Length != image.Length)
+            {
+                _logger?.LogError($"Device has {device.Image.Length / 8} actions, app expects {image.Length / 8}");
+                return false;
+            }
+
+            var changed = device.GetChangedActions(config);
+            if (changed.Count == 0)
             {
-                for (byte input = 0; input < 5; input++)
+                _logger?.Log("Device configuration already up to date");
+                return true;
+            }
+
+            int packets = GetPacketCount(image.Length);
+            if (changed.Count < packets)
+            {
+                _logger?.Log($"Writing {changed.Count} changed action(s)...");
+
+                foreach (int index in changed)
                 {
-                    int actionIndex = (slot * 5) + input;
-                    var action = allActions[actionIndex];
+                    byte slot = (byte)(index / 5);
+                    byte input = (byte)(index % 5);
+                    var action = config.Slots[slot].Actions[input];
 
                     _logger?.Log($"  Writing Slot {slot}, {SlotConfig.GetInputName(input)}: {action.GetDescription()}");
 
@@ -239,12 +358,17 @@ public class HidCommunicator
                         _logger?.LogError($"Failed at Slot {slot}, Input {input}");
                         return false;
                     }
-
-                    // Small delay to avoid overwhelming device
-                    Thread.Sleep(20);
                 }
             }
+            else
+            {
+                _logger?.Log($"{changed.Count} actions changed, writing full configuration ({packets} packets)...");
+
+                if (!WriteAllPackets(image))
+                    return false;
+            }
 
+            device.Image = image;
             _logger?.LogSuccess("Configuration written successfully");
             return true;
         }
@@ -255,6 +379,53 @@ public class HidCommunicator
         }
     }
 
+    /// <summary>
+    /// Send an action table image as WRITE_ALL packets (committed to DataFlash)
+    /// </summary>
+    private bool WriteAllPackets(byte[] image)
+    {
+        int packets = GetPacketCount(image.Length);
+
+        for (int sequence = 0; sequence < packets; sequence++)
+        {
+            int offset = sequence * CONFIG_PACKET_BYTES;
+            int length = Math.Min(CONFIG_PACKET_BYTES, image.Length - offset);
+
+            byte[] request = new byte[REPORT_SIZE];
+            request[0] = REPORT_ID;
+            request[1] = CMD_WRITE_ALL;
+            request[2] = (byte)sequence;
+            request[3] = (byte)packets;
+            Array.Copy(image, offset, request, 4, length);
+
+            if (sequence == packets - 1)
+            {
+                // Last packet: active slot, then commit flag
+                request[4 + length] = KEEP_ACTIVE_SLOT;
+                request[5 + length] = 0x01;
+            }
+
+            request[63] = CalculateChecksum(request);
+
+            byte[] response = new byte[REPORT_SIZE];
+            if (!SendFeatureReport(request, response))
+                return false;
+
+            if (response[2] != 0x00)
+            {
+                _logger?.LogError($"WRITE_ALL packet {sequence} rejected: error 0x{response[2]:X2}");
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    private static int GetPacketCount(int imageBytes)
+    {
+        return (imageBytes + CONFIG_PACKET_BYTES - 1) / CONFIG_PACKET_BYTES;
+    }
+
     /// <summary>
     /// Set the active slot on the device
     /// </summary>
@@ -16,11 +16,13 @@ public class MainViewModel : INotifyPropertyChanged
     private readonly HidCommunicator _hidCommunicator;
     private readonly ProfileManager _profileManager;
     private readonly AppSettings _settings;
+    private readonly DeviceCache _deviceCache;
     private int _selectedSlotIndex;
     private byte _ledBrightness;
     private bool _isConnected;
     private string _statusMessage;
     private DeviceInfo? _deviceInfo;
+    private DeviceSnapshot? _deviceState; // What the device holds now, null = unknown
 
     public event PropertyChangedEventHandler? PropertyChanged;
 
@@ -85,11 +87,13 @@ public class MainViewModel : INotifyPropertyChanged
     public RelayCommand SaveAsProfileCommand { get; }
     public RelayCommand ResetToDefaultsCommand { get; }
 
-    public MainViewModel(HidCommunicator hidCommunicator, ProfileManager profileManager, AppSettings settings)
+    public MainViewModel(HidCommunicator hidCommunicator, ProfileManager profileManager, AppSettings settings,
+                         DeviceCache deviceCache)
     {
         _hidCommunicator = hidCommunicator;
         _profileManager = profileManager;
         _settings = settings;
+        _deviceCache = deviceCache;
         _statusMessage = "Ready";
         _ledBrightness = 100;
 
@@ -134,9 +138,14 @@ public class MainViewModel : INotifyPropertyChanged
     {
         IsConnected = _hidCommunicator.FindDevice();
 
+        _deviceState = null;
         if (IsConnected)
         {
             _deviceInfo = _hidCommunicator.GetDeviceInfo();
+            if (_deviceInfo != null)
+            {
+                LoadDeviceState(_deviceInfo);
+            }
         }
 
         RefreshDeviceCommand.RaiseCanExecuteChanged();
@@ -144,11 +153,65 @@ public class MainViewModel : INotifyPropertyChanged
         SetActiveSlotCommand.RaiseCanExecuteChanged();
     }
 
+    /// <summary>
+    /// Show the device's configuration: from the cache when its fingerprint
+    /// still matches (no transfer beyond GET_INFO), otherwise via READ_CONFIG
+    /// </summary>
+    private void LoadDeviceState(DeviceInfo info)
+    {
+        var serial = _hidCommunicator.SerialNumber;
+        var state = _deviceCache.Get(serial, info);
+
+        if (state != null)
+        {
+            StatusMessage = "Loaded device configuration from cache";
+        }
+        else
+        {
+            state = _hidCommunicator.ReadConfig(info);
+            if (state == null)
+            {
+                StatusMessage = "Failed to read configuration from device";
+                return;
+            }
+
+            _deviceCache.Put(serial, state);
+            StatusMessage = "Read configuration from device";
+        }
+
+        if (state.Image.Length != DeviceConfiguration.ImageSize)
+        {
+            StatusMessage = $"Device has {state.Image.Length / 8} actions, not shown";
+            return;
+        }
+
+        _deviceState = state;
+
+        var config = state.ToConfiguration();
+        Slots.Clear();
+        for (int i = 0; i < config.Slots.Length; i++)
+        {
+            Slots.Add(new SlotViewModel(i, config.Slots[i]));
+        }
+
+        LedBrightness = config.LedBrightness;
+        SelectedSlotIndex = config.ActiveSlot;
+    }
+
     private async void ApplyToDevice()
     {
         if (!IsConnected)
             return;
 
+        var config = GetCurrentConfiguration();
+        var state = _deviceState;
+
+        if (state != null && state.GetChangedActions(config).Count == 0)
+        {
+            StatusMessage = "Device already up to date";
+            return;
+        }
+
         var result = MessageBox.Show(
             "This will write the current configuration to the device.\nContinue?",
             "Apply Configuration",
@@ -161,12 +224,23 @@ public class MainViewModel : INotifyPropertyChanged
 
         StatusMessage = "Writing configuration...";
 
-        var config = GetCurrentConfiguration();
+        var serial = _hidCommunicator.SerialNumber;
 
         await Task.Run(() =>
         {
-            if (_hidCommunicator.WriteAllConfig(config))
+            // Only the differences when the device state is known
+            bool written = state != null
+                ? _hidCommunicator.WriteChanges(state, config)
+                : _hidCommunicator.WriteAllConfig(config);
+
+            if (written)
             {
+                if (state != null)
+                {
+                    state.SlotNames = config.Slots.Select(s => s.Name).ToArray();
+                    _deviceCache.Put(serial, state);
+                }
+
                 Application.Current.Dispatcher.Invoke(() =>
                 {
                     StatusMessage = "Configuration applied successfully";
@@ -182,6 +256,7 @@ public class MainViewModel : INotifyPropertyChanged
             {
                 Application.Current.Dispatcher.Invoke(() =>
                 {
+                    _deviceState = null; // Partly written - read back on the next refresh
                     StatusMessage = "Failed to apply configuration";
                     MessageBox.Show(
                         "Failed to write configuration to device. Check the status log for details.",
@@ -200,6 +275,8 @@ public class MainViewModel : INotifyPropertyChanged
             return;
 
         byte slotIndex = (byte)SelectedSlotIndex;
+        var state = _deviceState;
+        var serial = _hidCommunicator.SerialNumber;
 
         StatusMessage = $"Setting active slot to {slotIndex}...";
 
@@ -207,6 +284,12 @@ public class MainViewModel : INotifyPropertyChanged
         {
             if (_hidCommunicator.SetActiveSlot(slotIndex))
             {
+                if (state != null)
+                {
+                    state.ActiveSlot = slotIndex;
+                    _deviceCache.Put(serial, state);
+                }
+
                 Application.Current.Dispatcher.Invoke(() =>
                 {
                     StatusMessage = $"Active slot set to {slotIndex}";
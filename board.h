@@ -0,0 +1,190 @@
+// ===================================================================================
+// Board Descriptor for CH552G Keyboard v2.0
+// ===================================================================================
+//
+// Everything that differs between PCB variants lives here: key wiring, the
+// WS2812 chain, which LED sits under which key, and config sizing. The
+// firmware expands the lists below as X-macros, so key sampling and LED
+// mapping compile to direct SFR accesses with constant indices - there are no
+// pin tables or loops over pins at runtime.
+//
+// Keys are wired either directly (BOARD_BUTTONS, one pin per key, all in key
+// row 0) or as a matrix (BOARD_MATRIX_ROWS driven low one at a time, columns
+// read with one whole-port read). Key index = row * BOARD_KEY_COLS + column.
+//
+// Pins are written as "port, bit" pairs (P3.4 -> 3, 4). The ch55xduino pin
+// number is port * 10 + bit.
+//
+// The number of config slots follows from the chip's DataFlash and the
+// board's input count (BOARD_SLOTS may still be set explicitly).
+//
+// A direct key wired to P1.1 (T2EX, whose falling edge raises the Timer2
+// interrupt) may be named in BOARD_T2EX_KEY for the press fast path.
+//
+// Rotary encoders are listed in BOARD_ENCODERS. Encoder 0 is the system
+// encoder (its button opens the slot menu and enters the bootloader at
+// power-up); every further encoder also gets a press action.
+//
+// The default is the original 3-key + encoder PCB; -DBOARD_PAD_3X4 selects a
+// 3x4 matrix pad and -DBOARD_KNOBS_3 a 2-key, 3-encoder board, both on a
+// CH552T. For another variant, define BOARD_CUSTOM and provide
+// board_custom.h with the same macros.
+// ===================================================================================
+
+#pragma once
+
+#if defined(BOARD_CUSTOM)
+#include "board_custom.h"
+
+#elif defined(BOARD_PAD_3X4)
+
+#define BOARD_NAME          "pad-3x4"
+
+// Matrix without diodes: rows X(row, port, bit) are driven low one at a time,
+// the four columns sit on P1.4-P1.7 and are read in one go (1 = pressed)
+#define BOARD_MATRIX_ROWS(X) \
+    X(0, 1, 0)      /* P1.0 */ \
+    X(1, 1, 1)      /* P1.1 */ \
+    X(2, 1, 2)      /* P1.2 */
+#define BOARD_MATRIX_ROW_COUNT  3
+#define BOARD_MATRIX_COLS(X) \
+    X(0, 1, 4) X(1, 1, 5) X(2, 1, 6) X(3, 1, 7)
+#define BOARD_MATRIX_COL_COUNT  4
+#define BOARD_MATRIX_COLS_READ()  ((uint8_t)~P1 >> 4)
+
+// LEDs under the top row of keys: X(key, led)
+#define BOARD_KEY_LEDS(X) \
+    X(0, 0) X(1, 1) X(2, 2) X(3, 3)
+
+#define BOARD_ENCODERS(X) \
+    X(0, 3, 1, 3, 0, 3, 3)      /* A=P3.1 B=P3.0 BTN=P3.3 */
+#define BOARD_ENCODER_COUNT 1
+
+#define BOARD_LED_PIN       3, 4    // P3.4
+#define BOARD_LED_COUNT     4
+
+#elif defined(BOARD_KNOBS_3)
+
+#define BOARD_NAME          "knobs-3"
+
+#define BOARD_BUTTONS(X) \
+    X(0, 1, 0)      /* P1.0 */ \
+    X(1, 1, 1)      /* P1.1 */
+#define BOARD_BUTTON_COUNT  2
+#define BOARD_T2EX_KEY      1       // P1.1
+
+#define BOARD_KEY_LEDS(X) \
+    X(0, 0) X(1, 1)
+
+#define BOARD_ENCODERS(X) \
+    X(0, 3, 1, 3, 0, 3, 3)      /* A=P3.1 B=P3.0 BTN=P3.3 */ \
+    X(1, 1, 4, 1, 5, 1, 2)      /* A=P1.4 B=P1.5 BTN=P1.2 */ \
+    X(2, 1, 6, 1, 7, 1, 3)      /* A=P1.6 B=P1.7 BTN=P1.3 */
+#define BOARD_ENCODER_COUNT 3
+
+#define BOARD_LED_PIN       3, 4    // P3.4
+#define BOARD_LED_COUNT     2
+
+#else
+
+#define BOARD_NAME          "mini-3key"
+
+// Buttons (active low): X(index, port, bit). Index order = key order.
+#define BOARD_BUTTONS(X) \
+    X(0, 1, 1)      /* P1.1 */ \
+    X(1, 1, 7)      /* P1.7 */ \
+    X(2, 1, 6)      /* P1.6 */
+#define BOARD_BUTTON_COUNT  3
+
+// Key on T2EX for the press fast path (FAST_KEY in the sketch)
+#define BOARD_T2EX_KEY      0       // P1.1
+
+// WS2812 position under each key: X(key, led)
+#define BOARD_KEY_LEDS(X) \
+    X(0, 0) X(1, 1) X(2, 2)
+
+// Rotary encoders (active low): X(index, A port, A bit, B port, B bit,
+// button port, button bit)
+#define BOARD_ENCODERS(X) \
+    X(0, 3, 1, 3, 0, 3, 3)      /* A=P3.1 B=P3.0 BTN=P3.3 */
+#define BOARD_ENCODER_COUNT 1
+
+// WS2812 chain
+#define BOARD_LED_PIN       3, 4    // P3.4
+#define BOARD_LED_COUNT     3
+
+#endif
+
+// ===================================================================================
+// Chip Resources
+// ===================================================================================
+//
+// CH551/CH552/CH554 share 128 bytes of DataFlash and too little USB RAM for
+// more than EP0/EP1. The CH559 has 1 KB of DataFlash; the config image stays
+// inside the 8-bit eeprom_*_byte() address range (0xFF marks an idle commit),
+// and there is USB RAM for a separate config endpoint (EP2, raw HID).
+
+#if defined(CH559)
+#define CHIP_CONFIG_BYTES       248
+#define CHIP_BOOTLOADER_ADDR    "0xF400"
+#define CHIP_CONFIG_ENDPOINT    1
+#else
+#define CHIP_CONFIG_BYTES       128
+#define CHIP_BOOTLOADER_ADDR    "0x3800"
+#define CHIP_CONFIG_ENDPOINT    0
+#endif
+
+#define CHIP_MAX_SLOTS          8
+
+// ===================================================================================
+// Derived Values
+// ===================================================================================
+
+// Key grid
+#ifdef BOARD_MATRIX_ROWS
+#define BOARD_KEY_ROWS      BOARD_MATRIX_ROW_COUNT
+#define BOARD_KEY_COLS      BOARD_MATRIX_COL_COUNT
+#else
+#define BOARD_KEY_ROWS      1
+#define BOARD_KEY_COLS      BOARD_BUTTON_COUNT
+#endif
+#define BOARD_KEY_COUNT     (BOARD_KEY_ROWS * BOARD_KEY_COLS)
+
+// Inputs: keys, encoder 0 CW/CCW, then CW/CCW/press for each further encoder
+#define BOARD_INPUT_COUNT   (BOARD_KEY_COUNT + 3 * BOARD_ENCODER_COUNT - 1)
+
+// Encoder A/B state at a detent (A << 1 | B): 3 on the usual pull-up EC11
+// parts, 0 on encoders that rest with both contacts closed
+#ifndef BOARD_ENCODER_DETENT
+#define BOARD_ENCODER_DETENT 3
+#endif
+
+// As many slots as fit the DataFlash: 8-byte header + 8 bytes per input
+#ifndef BOARD_SLOTS
+#define BOARD_SLOTS_FIT     ((CHIP_CONFIG_BYTES - 8) / (BOARD_INPUT_COUNT * 8))
+#define BOARD_SLOTS         (BOARD_SLOTS_FIT > CHIP_MAX_SLOTS ? CHIP_MAX_SLOTS : BOARD_SLOTS_FIT)
+#endif
+
+// Pin helpers taking a "port, bit" pair
+#define BOARD_PIN(p)                BOARD_PIN_(p)
+#define BOARD_PIN_(port, bit)       ((port) * 10 + (bit))
+#define BOARD_SBIT(p)               BOARD_SBIT_(p)
+#define BOARD_SBIT_(port, bit)      P##port##_##bit
+#define BOARD_SBIT_ADDR(p)          BOARD_SBIT_ADDR_(p)
+#define BOARD_SBIT_ADDR_(port, bit) (0x80 + (port) * 0x10 + (bit))
+
+#if BOARD_SLOTS < 1 || 8 + BOARD_SLOTS * BOARD_INPUT_COUNT * 8 > CHIP_CONFIG_BYTES
+#error "Board config does not fit this chip's DataFlash"
+#endif
+#if BOARD_SLOTS > 4 * BOARD_LED_COUNT
+#error "Slot menu shows slots as LED position x 4 bank colors - not enough LEDs"
+#endif
+#if BOARD_KEY_COLS > 8
+#error "A key row is one byte - at most 8 columns"
+#endif
+#if BOARD_ENCODER_COUNT < 1 || BOARD_ENCODER_COUNT > 4
+#error "Boards have 1-4 encoders (encoder 0 runs the slot menu)"
+#endif
+#if BOARD_ENCODER_DETENT != 0 && BOARD_ENCODER_DETENT != 3
+#error "Full-step encoders rest at A/B = 0 or 3"
+#endif
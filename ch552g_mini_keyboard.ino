@@ -3,7 +3,7 @@
  *
  * PC-configurable USB mini keyboard with 3 buttons and rotary encoder.
  *
- * Board: CH55xDuino CH552
+ * Board: CH55xDuino CH552 (CH551/CH554/CH559 also supported, see board.h)
  * Settings:
  *   - Clock: 16MHz (internal) 3.5V or 5V
  *   - Upload Method: USB
@@ -12,35 +12,39 @@
 
 #include <Arduino.h>
 #include "src/usb/userUsbHidKeyboardMouse/USBHIDKeyboardMouse.h"
+#include "src/usb/userUsbHidKeyboardMouse/USBcopy.h"
 #include "ws2812.h"
 #include "led_colors.h"
-
-// ============================================================================
-// Pin Definitions
-// ============================================================================
-
-#define PIN_BTN_1       11  // P1.1
-#define PIN_BTN_2       17  // P1.7
-#define PIN_BTN_3       16  // P1.6
-#define PIN_ENC_BTN     33  // P3.3
-#define PIN_ENC_A       31  // P3.1
-#define PIN_ENC_B       30  // P3.0
-#define PIN_LED         34  // P3.4 - WS2812 LEDs
+#include "macro.h"
+#include "script.h"
+#include "stack.h"
+#include "board.h"
+#include "keyscan.h"
+#include "encoder.h"
 
 // ============================================================================
 // Configuration Constants
 // ============================================================================
 
-#define MAX_SLOTS       3
-#define MAX_INPUTS      5
-#define TOTAL_ACTIONS   15
-
-// Input indices
-#define INPUT_BTN_1     0
-#define INPUT_BTN_2     1
-#define INPUT_BTN_3     2
-#define INPUT_ENC_CW    3
-#define INPUT_ENC_CCW   4
+#define MAX_SLOTS       BOARD_SLOTS
+#define MAX_INPUTS      BOARD_INPUT_COUNT
+#define TOTAL_ACTIONS   (MAX_SLOTS * MAX_INPUTS)
+
+// Input indices (see board.h): keys 0..BOARD_KEY_COUNT-1, then encoder 0
+// CW/CCW, then CW/CCW/PRESS for each further encoder
+#define INPUT_ENC_CW    BOARD_KEY_COUNT
+#define INPUT_ENC_CCW   (BOARD_KEY_COUNT + 1)
+#define INPUT_ENC_BASE(e)  (BOARD_KEY_COUNT + 3 * (e) - ((e) ? 1 : 0))  // CW of encoder e
+
+// Press fast path: the key on T2EX (board.h BOARD_T2EX_KEY) sends its press
+// report from the pin's edge interrupt, ahead of the debounce (see
+// fastKeyInterrupt). 0 scans it like every other key.
+#ifndef FAST_KEY
+#define FAST_KEY        0
+#endif
+#if FAST_KEY && !defined(BOARD_T2EX_KEY)
+#error "FAST_KEY needs a key on T2EX (BOARD_T2EX_KEY in board.h)"
+#endif
 
 // Action types
 #define ACTION_NONE     0x0
@@ -48,6 +52,9 @@
 #define ACTION_MEDIA    0x2
 #define ACTION_MOUSE    0x3
 #define ACTION_SCROLL   0x4
+#define ACTION_MACRO    0x5
+#define ACTION_HOST     0x6   // Event report for a host executor (host-events build)
+#define ACTION_SCRIPT   0x7   // Bytecode script (script_data.h)
 
 // Modifiers
 #define MOD_CTRL        0x10
@@ -66,6 +73,14 @@
 #define COLOR_MAGENTA   6
 #define COLOR_WHITE     7
 
+// Factory presets (slot images in code flash)
+#define PRESET_TEAMS    0
+#define PRESET_MEDIA    1
+#define PRESET_VS2022   2
+#define PRESET_COUNT    3
+#define PRESET_KEYS     3   // Key actions per image, followed by ENC_CW, ENC_CCW
+#define PRESET_COPY_KEYS ((BOARD_KEY_COUNT < PRESET_KEYS) ? BOARD_KEY_COUNT : PRESET_KEYS)
+
 // ============================================================================
 // Action Structure (8 bytes)
 // ============================================================================
@@ -80,7 +95,7 @@ typedef struct {
 } Action;
 
 // ============================================================================
-// Configuration Structure (128 bytes for DataFlash)
+// Configuration Structure (DataFlash image, 128 bytes on CH552)
 // ============================================================================
 
 typedef struct {
@@ -111,6 +126,12 @@ typedef struct {
 #define REPORT_ID_CONFIG    0xF0
 #define REPORT_SIZE         64
 
+// READ_CONFIG / WRITE_ALL split the action table into 56-byte packets
+#define CONFIG_ACTION_BYTES (TOTAL_ACTIONS * 8)
+#define CONFIG_PACKET_BYTES 56
+#define CONFIG_PACKETS      ((CONFIG_ACTION_BYTES + CONFIG_PACKET_BYTES - 1) / CONFIG_PACKET_BYTES)
+#define CONFIG_LAST_BYTES   (CONFIG_ACTION_BYTES - (CONFIG_PACKETS - 1) * CONFIG_PACKET_BYTES)
+
 // Commands
 #define CMD_READ_CONFIG     0x01
 #define CMD_WRITE_ACTION    0x02
@@ -118,69 +139,195 @@ typedef struct {
 #define CMD_GET_INFO        0x04
 #define CMD_SET_SLOT        0x05
 #define CMD_FACTORY_RESET   0x06
+#define CMD_LOAD_PRESET     0x07
+#define CMD_GET_STATS       0x08
+#define CMD_GET_COUNTERS    0x09
+#define CMD_GET_DIAG        0x0A
+#define CMD_ENTER_BOOTLOADER 0x0B
+#define CMD_WRITE_OVERLAY   0x0C
+
+// GET_DIAG: [3]=layout version [4..7]=millis() [8..11]=loop passes
+// [12..13]=dropped reports [14..15]=flash commits [16..17]=encoder errors
+// [18]=worst task latency (ms) [19]=task count [20..]=deadline misses
+// then [+0..1]=encoder reversals [+2]=encoder oversampling active
+// [+3]=first stack byte [+4]=stack high-water address (internal RAM)
+#define DIAG_VERSION        3
+
+// GET_COUNTERS: [3]=slots [4]=inputs [5]=first index [6]=count
+// [7..10]=millis() LE, then 16-bit LE counters (index = slot * inputs + input)
+#define COUNTERS_OFFSET     11
+#define COUNTERS_PER_PACKET ((REPORT_SIZE - 1 - COUNTERS_OFFSET) / 2)
+
+// WRITE_OVERLAY: [2]=first input [3]=count [4]=flags [5]=host tag
+// [6..]=actions. The overlay is a RAM-only slot after the DataFlash slots
+// (current_slot == OVERLAY_SLOT); nothing is ever written to DataFlash.
+#define OVERLAY_OFFSET      6
+#define OVERLAY_PER_PACKET  ((REPORT_SIZE - 1 - OVERLAY_OFFSET) / 8)
+#define OVERLAY_ACTIVATE    0x01  // flags: switch to the overlay after the copy
+#define OVERLAY_SLOT        MAX_SLOTS
+
+// GET_INFO capability bits
+#define CAP_CONFIG_ENDPOINT 0x01  // Config packets also accepted on raw HID EP2
+#define CAP_NKRO            0x02  // Keyboard report is an NKRO bitmap
+#define CAP_HIRES_SCROLL    0x04  // Wheel has a Resolution Multiplier
+#define CAP_HOST_EVENTS     0x08  // Host actions send event report 0xF1
+#define CAP_OVERLAY_SLOT    0x10  // WRITE_OVERLAY RAM slot
+
+// USB feature set from src/usb/userUsbHidKeyboardMouse/usb_features.h
+#define CONFIG_ENDPOINT     (CHIP_CONFIG_ENDPOINT && USB_HID_RAW_HID)
+#define DEVICE_CAPS         ((CONFIG_ENDPOINT ? CAP_CONFIG_ENDPOINT : 0) | \
+                             (USB_HID_NKRO ? CAP_NKRO : 0) | \
+                             (USB_HID_HIRES_SCROLL ? CAP_HIRES_SCROLL : 0) | \
+                             (USB_HID_HOST_EVENTS ? CAP_HOST_EVENTS : 0) | \
+                             CAP_OVERLAY_SLOT)
 
 // Error codes
 #define ERR_SUCCESS         0x00
 #define ERR_INVALID_CMD     0x01
 #define ERR_INVALID_SLOT    0x02
 #define ERR_INVALID_INPUT   0x03
+#define ERR_INVALID_PRESET  0x04
 #define ERR_CHECKSUM        0x05
 
+// ============================================================================
+// Task Scheduler
+// ============================================================================
+
+// Tasks in priority order - the lowest ready index runs first
+#define TASK_INPUT      0   // Buttons, encoder, bootloader combo
+#define TASK_HID        1   // Mouse / macro report flush (only when EP1 is free)
+#define TASK_CONFIG     2   // Feature Report command queued by the USB ISR
+#define TASK_LED        3   // WS2812 frame
+#define TASK_FLASH      4   // Deferred DataFlash commit
+#define TASK_COUNT      5
+
+#define TASK_BIT(t)     ((uint8_t)(1 << (t)))
+
+#define INPUT_PERIOD_MS      1
+#define INPUT_SOF_DELAY_US   700  // Scan this far into each USB frame (see pollTasks)
+#define INPUT_SOF_TIMEOUT_MS 3    // No frames this long (suspend): free-running scan
+#define LED_PERIOD_MS        20
+#define FLASH_HOLDOFF_MS     100  // Coalesce bursts of writes into one commit
+#define FLASH_BYTES_PER_RUN  8    // DataFlash bytes written per TASK_FLASH run
+#define FLASH_IDLE           0xFF
+
+#define BOOTLOADER_DELAY_MS  100  // Host collects the response before the jump
+
+// Longest a ready task may wait (ms) before it counts as a deadline miss
+__code const uint8_t TASK_DEADLINE_MS[TASK_COUNT] = {2, 10, 20, 40, 250};
+
 // ============================================================================
 // Global Variables
 // ============================================================================
 
 Configuration config;
-uint8_t current_slot = 0;
+uint8_t current_slot = 0;  // 0..MAX_SLOTS-1, or OVERLAY_SLOT
+
+// RAM overlay slot (WRITE_OVERLAY), lost at power-off
+Action overlay[MAX_INPUTS];
+bool overlay_loaded = false;
+uint8_t overlay_tag = 0;   // Host's id for the loaded profile, echoed in GET_INFO
 bool slot_switch_mode = false;
 uint8_t selected_slot = 0;
 
-// Button states
-bool btn_states[3] = {false, false, false};
-bool btn_last[3] = {false, false, false};
-uint32_t btn_press_time[3] = {0, 0, 0};
-
 // Encoder state
-uint8_t enc_state = 0;
-uint8_t enc_last = 0;
-int8_t enc_position = 0;
 bool enc_btn_pressed = false;
 uint32_t enc_btn_press_time = 0;
 
-// LED buffer (simplified - no WS2812 for now)
-uint8_t led_colors[3] = {0, 0, 0};
+// Color shown under each key (mapped to WS2812 positions by board.h)
+uint8_t led_colors[BOARD_KEY_COUNT];
 
 // USB Feature Report state
 uint8_t usb_response[REPORT_SIZE];
 uint8_t usb_response_ready = 0;  // 0=not ready, 1=ready
 uint8_t transfer_sequence = 0;
+volatile uint8_t usb_feature_pending = 0;  // Set by USB ISR, cleared by TASK_CONFIG
+#define USB_FEATURE_FROM_EP0  1  // usb_feature_pending: SET_REPORT on EP0
+#define USB_FEATURE_FROM_EP2  2  // usb_feature_pending: raw HID config endpoint
+
+// Scheduler state
+uint8_t task_ready = 0;                // TASK_BIT() mask of runnable tasks
+uint16_t task_ready_time[TASK_COUNT];  // millis() when each task became ready
+uint8_t task_misses[TASK_COUNT];       // Deadline misses (saturating)
+uint16_t input_due = 0;
+uint8_t input_sof = 0;            // USB_sofCount of the frame being scanned
+uint16_t input_sof_us = 0;        // micros() when that frame was noticed
+uint16_t input_sof_ms = 0;        // millis() of the same
+bool input_sof_wait = false;      // Scan of the current frame still pending
+uint16_t led_due = 0;
+
+// Host-requested bootloader entry (CMD_ENTER_BOOTLOADER)
+bool bootloader_requested = false;
+uint16_t bootloader_request_time = 0;
+
+#if FAST_KEY
+// Press fast path state (see fastKeyInterrupt)
+uint8_t fast_key_state = 0;            // FAST_KEY_OFF / _ARMED / _FIRED
+volatile bool fast_key_fired = false;  // Set by the edge interrupt
+uint16_t fast_key_time = 0;            // millis() when the firing was noticed
+uint8_t fast_key_control = 0;          // Action the staged report was built from
+uint8_t fast_key_primary = 0;
+#endif
+
+// Diagnostics (GET_DIAG)
+uint32_t diag_loop_passes = 0;     // runNextTask() calls, wraps
+uint16_t diag_flash_commits = 0;   // Completed DataFlash commits, saturating
+uint8_t diag_max_latency = 0;      // Worst ready-to-run delay (ms) since last clear
+
+// Deferred DataFlash commit state
+bool config_dirty = false;
+uint16_t config_dirty_time = 0;
+uint8_t flash_commit_pos = FLASH_IDLE;  // Next DataFlash address being written
+
+// Activations per slot and input since power-up or the last clearing read
+// (RAM only, saturating at 0xFFFF)
+uint16_t press_counts[TOTAL_ACTIONS];
 
 // ============================================================================
 // Forward Declarations
 // ============================================================================
 
 uint8_t calcChecksum(const Configuration* cfg);
+uint16_t configFingerprint();
 void saveConfigToDataFlash();
+void requestConfigSave();
+void enterBootloader();
 void loadDefaultConfig();
+bool loadPreset(uint8_t slot, uint8_t preset);
+Action* activeActions();
+void showSlotColors();
 
 // ============================================================================
 // USB Feature Report Handler
 // ============================================================================
 //
-// NOTE: To fully enable PC configuration, this handler must be called from
-// the USB stack when a SET_REPORT request is received with Report ID 0xF0.
-//
-// Required modification in src/usb/userUsbHidKeyboardMouse/USBhandler.c:
-//   In USB_REQ_TYP_CLASS handler (line 56), add:
-//     case 0x09:  // HID SET_REPORT
-//       if(Ep0Buffer[2] == 0xF0) {  // Report ID 0xF0
-//         handleUSBFeatureReport(Ep0Buffer, REPORT_SIZE);
-//       }
-//       break;
-//
-// For now, this handler is implemented and ready but not wired to USB stack.
+// The USB ISR (USBhandler.c) only accumulates a SET_REPORT into
+// feature_report_buffer and raises usb_feature_pending. TASK_CONFIG runs this
+// handler from the main loop; a GET_REPORT that arrives first is NAKed until
+// the response is ready, then released by USB_EP0_flushDeferredReport().
 // ============================================================================
 
+extern __xdata uint8_t feature_report_buffer[REPORT_SIZE];
+extern void USB_EP0_flushDeferredReport(void);
+extern volatile __data uint8_t USB_sofCount;
+#if CONFIG_ENDPOINT
+extern void USB_EP2_sendResponse(void);
+#endif
+
+// Dual-DPTR block copies (USBcopy.h); interrupts stay off while the data
+// pointers are switched
+void copyXdata(__xdata uint8_t* dst, __xdata const uint8_t* src, uint8_t len) {
+    EA = 0;
+    USB_copyXdata(dst, src, len);
+    EA = 1;
+}
+
+void copyFromCode(__xdata uint8_t* dst, __code const uint8_t* src, uint8_t len) {
+    EA = 0;
+    USB_copyFromCode(dst, src, len);
+    EA = 1;
+}
+
 uint8_t calcReportChecksum(const uint8_t* data, uint8_t len) {
     uint8_t checksum = 0;
     for(uint8_t i = 0; i < len; i++) {
@@ -243,13 +390,14 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
             }
 
             // Copy action data (8 bytes at offset 4)
-            memcpy(&config.slots[slot][input], &report[4], sizeof(Action));
+            copyXdata((__xdata uint8_t*)&config.slots[slot][input],
+                      (__xdata uint8_t*)&report[4], sizeof(Action));
 
             // Recalculate checksum
             config.checksum = calcChecksum(&config);
 
-            // Save to DataFlash
-            saveConfigToDataFlash();
+            // Commit to DataFlash (deferred)
+            requestConfigSave();
 
             // Build success response
             buildResponse(command, ERR_SUCCESS);
@@ -262,26 +410,27 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
             uint8_t sequence = report[2];
             uint8_t total = report[3];
 
-            // Validate sequence matches expected state
-            if(sequence == 0) {
-                // First packet: Actions 0-6 (56 bytes)
-                memcpy(&config.slots[0][0], &report[4], 56);
-                transfer_sequence = 1;
-            }
-            else if(sequence == 1 && transfer_sequence == 1) {
-                // Second packet: Actions 7-13 (56 bytes) - ONLY if we got packet 0
-                uint8_t* dest = (uint8_t*)&config.slots[0][0];
-                memcpy(dest + 56, &report[4], 56);
-                transfer_sequence = 2;
+            // Packets must arrive in order; packet 0 always (re)starts
+            if(sequence != 0 && (sequence != transfer_sequence || sequence >= CONFIG_PACKETS)) {
+                // Invalid sequence (out of order or duplicate)
+                transfer_sequence = 0;  // Reset state
+                buildResponse(command, ERR_INVALID_CMD);
+                finalizeResponse();
+                return;
             }
-            else if(sequence == 2 && transfer_sequence == 2) {
-                // Third packet: Action 14 (8 bytes) + commit - ONLY if we got packets 0 & 1
-                uint8_t* dest = (uint8_t*)&config.slots[0][0];
-                memcpy(dest + 112, &report[4], 8);
 
-                // Get active slot and commit flag
-                uint8_t new_slot = report[12];
-                uint8_t commit = report[13];
+            __xdata uint8_t* dest = (__xdata uint8_t*)&config.slots[0][0];
+            dest += (uint16_t)sequence * CONFIG_PACKET_BYTES;
+            transfer_sequence = sequence + 1;
+
+            if(transfer_sequence < CONFIG_PACKETS) {
+                copyXdata(dest, (__xdata uint8_t*)&report[4], CONFIG_PACKET_BYTES);
+            } else {
+                // Last packet: remaining actions, then active slot + commit flag
+                copyXdata(dest, (__xdata uint8_t*)&report[4], CONFIG_LAST_BYTES);
+
+                uint8_t new_slot = report[4 + CONFIG_LAST_BYTES];
+                uint8_t commit = report[5 + CONFIG_LAST_BYTES];
 
                 if(new_slot < MAX_SLOTS) {
                     config.active_slot = new_slot;
@@ -293,54 +442,78 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
 
                 // Save to DataFlash if commit flag set
                 if(commit) {
-                    saveConfigToDataFlash();
+                    requestConfigSave();
                 }
 
                 transfer_sequence = 0;
             }
-            else {
-                // Invalid sequence (out of order or duplicate)
-                transfer_sequence = 0;  // Reset state
-                buildResponse(command, ERR_INVALID_CMD);
+
+            // Build success response
+            buildResponse(command, ERR_SUCCESS);
+            usb_response[3] = sequence;
+            finalizeResponse();
+            break;
+        }
+
+        case CMD_WRITE_OVERLAY: {
+            // Fill the RAM overlay slot; no DataFlash commit. Larger boards
+            // split the slot over several packets, the last one activates.
+            uint8_t first = report[2];
+            uint8_t count = report[3];
+
+            if(count > OVERLAY_PER_PACKET || first >= MAX_INPUTS ||
+               count > MAX_INPUTS - first) {
+                buildResponse(command, ERR_INVALID_INPUT);
                 finalizeResponse();
                 return;
             }
 
-            // Build success response
+            copyXdata((__xdata uint8_t*)&overlay[first],
+                      (__xdata uint8_t*)&report[OVERLAY_OFFSET], count * sizeof(Action));
+            overlay_tag = report[5];
+            overlay_loaded = true;
+
+            if(report[4] & OVERLAY_ACTIVATE) {
+                current_slot = OVERLAY_SLOT;  // config.active_slot keeps the saved slot
+                showSlotColors();
+            }
+
             buildResponse(command, ERR_SUCCESS);
-            usb_response[3] = sequence;
+            usb_response[3] = current_slot;
             finalizeResponse();
             break;
         }
 
         case CMD_READ_CONFIG: {
-            // Read configuration (multi-packet response)
+            // Read configuration (multi-packet response), [2]=packet index
             // Spec format: [0xF0][cmd][seq][total][data...][checksum]
+            uint8_t sequence = report[2];
+
+            if(sequence >= CONFIG_PACKETS) {
+                buildResponse(command, ERR_INVALID_CMD);
+                finalizeResponse();
+                return;
+            }
+
             memset(usb_response, 0, REPORT_SIZE);
             usb_response[0] = REPORT_ID_CONFIG;
             usb_response[1] = command;
-            usb_response[2] = transfer_sequence;
-            usb_response[3] = 3; // Total packets
+            usb_response[2] = sequence;
+            usb_response[3] = CONFIG_PACKETS;
 
-            if(transfer_sequence == 0) {
-                // Packet 0: Actions 0-6 (56 bytes) + status
-                memcpy(&usb_response[4], &config.slots[0][0], 56);
+            __xdata uint8_t* src = (__xdata uint8_t*)&config.slots[0][0];
+            src += (uint16_t)sequence * CONFIG_PACKET_BYTES;
+
+            if(sequence + 1 < CONFIG_PACKETS) {
+                copyXdata(&usb_response[4], src, CONFIG_PACKET_BYTES);
+            } else {
+                copyXdata(&usb_response[4], src, CONFIG_LAST_BYTES);
+            }
+            if(sequence == 0) {
+                // Packet 0 also carries status after its action bytes
                 usb_response[60] = config.active_slot;
                 usb_response[61] = config.version;
-                usb_response[62] = 0x00; // Device status (placeholder)
-                transfer_sequence = 1;
-            }
-            else if(transfer_sequence == 1) {
-                // Packet 1: Actions 7-13 (56 bytes)
-                uint8_t* src = (uint8_t*)&config.slots[0][0];
-                memcpy(&usb_response[4], src + 56, 56);
-                transfer_sequence = 2;
-            }
-            else if(transfer_sequence == 2) {
-                // Packet 2: Action 14 (8 bytes)
-                uint8_t* src = (uint8_t*)&config.slots[0][0];
-                memcpy(&usb_response[4], src + 112, 8);
-                transfer_sequence = 0;
+                usb_response[62] = config_led_brightness;
             }
 
             finalizeResponse();
@@ -352,6 +525,14 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
             uint8_t new_slot = report[2];
             uint8_t save = report[3];
 
+            if(new_slot == OVERLAY_SLOT && overlay_loaded) {
+                // Back to the overlay loaded earlier (never saved)
+                current_slot = OVERLAY_SLOT;
+                showSlotColors();
+                buildResponse(command, ERR_SUCCESS);
+                finalizeResponse();
+                return;
+            }
             if(new_slot >= MAX_SLOTS) {
                 buildResponse(command, ERR_INVALID_SLOT);
                 finalizeResponse();
@@ -363,7 +544,7 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
 
             if(save) {
                 config.checksum = calcChecksum(&config);
-                saveConfigToDataFlash();
+                requestConfigSave();
             }
 
             buildResponse(command, ERR_SUCCESS);
@@ -383,7 +564,52 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
             }
 
             loadDefaultConfig();
-            saveConfigToDataFlash();
+            requestConfigSave();
+
+            buildResponse(command, ERR_SUCCESS);
+            finalizeResponse();
+            break;
+        }
+
+        case CMD_ENTER_BOOTLOADER: {
+            // Jump to the bootloader for a firmware update, config kept
+            // Magic: 0xB007B007 at bytes 2-5 (little-endian)
+            if(report[2] != 0x07 || report[3] != 0xB0 ||
+               report[4] != 0x07 || report[5] != 0xB0) {
+                buildResponse(command, ERR_INVALID_CMD);
+                finalizeResponse();
+                return;
+            }
+
+            // The jump happens in the input task, after the response is out
+            bootloader_requested = true;
+            bootloader_request_time = (uint16_t)millis();
+
+            buildResponse(command, ERR_SUCCESS);
+            finalizeResponse();
+            break;
+        }
+
+        case CMD_LOAD_PRESET: {
+            // Copy a factory preset into one slot: [2]=slot, [3]=preset, [4]=save
+            uint8_t slot = report[2];
+            uint8_t preset = report[3];
+
+            if(slot >= MAX_SLOTS) {
+                buildResponse(command, ERR_INVALID_SLOT);
+                finalizeResponse();
+                return;
+            }
+            if(!loadPreset(slot, preset)) {
+                buildResponse(command, ERR_INVALID_PRESET);
+                finalizeResponse();
+                return;
+            }
+
+            config.checksum = calcChecksum(&config);
+            if(report[4]) {
+                requestConfigSave();
+            }
 
             buildResponse(command, ERR_SUCCESS);
             finalizeResponse();
@@ -401,14 +627,86 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
             usb_response[5] = 1;   // Config version
             usb_response[6] = 0;   // Build number low
             usb_response[7] = 0;   // Build number high
-            usb_response[8] = 0x00; // Capabilities (none yet)
+            usb_response[8] = DEVICE_CAPS;  // Capabilities
             usb_response[9] = MAX_SLOTS;
             usb_response[10] = MAX_INPUTS;
-            usb_response[11] = TOTAL_ACTIONS; // Max actions (15)
+            usb_response[11] = TOTAL_ACTIONS; // Max actions (15 on CH552)
             // Build date: YYYYMMDD (20250126)
             memcpy(&usb_response[12], "20250126", 8);
             // Git hash: 16 chars (placeholder)
             memcpy(&usb_response[20], "v2_arduino______", 16);
+            usb_response[36] = PRESET_COUNT;
+            // Hosts compare this against their cached READ_CONFIG image
+            uint16_t fingerprint = configFingerprint();
+            usb_response[37] = (uint8_t)fingerprint;
+            usb_response[38] = (uint8_t)(fingerprint >> 8);
+            usb_response[39] = current_slot;  // OVERLAY_SLOT while the overlay is active
+            usb_response[40] = overlay_loaded;
+            usb_response[41] = overlay_tag;
+            usb_response[42] = config.active_slot;  // Saved slot, to leave the overlay
+            finalizeResponse();
+            break;
+        }
+
+        case CMD_GET_COUNTERS: {
+            // Activation counters, paged: [2]=1 clears the returned range,
+            // [3]=first index. The host drains and accumulates them.
+            uint8_t first = report[3];
+            uint8_t count = 0;
+
+            buildResponse(command, ERR_SUCCESS);
+            usb_response[3] = MAX_SLOTS;
+            usb_response[4] = MAX_INPUTS;
+            usb_response[5] = first;
+            uint32_t now = millis();
+            memcpy(&usb_response[7], &now, 4);  // SDCC is little endian
+            for(uint8_t i = first; i < TOTAL_ACTIONS && count < COUNTERS_PER_PACKET; i++, count++) {
+                usb_response[COUNTERS_OFFSET + 2 * count] = (uint8_t)press_counts[i];
+                usb_response[COUNTERS_OFFSET + 2 * count + 1] = (uint8_t)(press_counts[i] >> 8);
+                if(report[2] == 1) {
+                    press_counts[i] = 0;
+                }
+            }
+            usb_response[6] = count;
+            finalizeResponse();
+            break;
+        }
+
+        case CMD_GET_DIAG: {
+            // Everything a monitoring poll needs in one transaction.
+            // [2]=1 clears the latency watermark after reading. The stack
+            // high-water mark covers everything since power-up.
+            uint32_t now = millis();
+            buildResponse(command, ERR_SUCCESS);
+            usb_response[3] = DIAG_VERSION;
+            memcpy(&usb_response[4], &now, 4);  // SDCC is little endian
+            memcpy(&usb_response[8], &diag_loop_passes, 4);
+            memcpy(&usb_response[12], &USB_EP1_drops, 2);
+            memcpy(&usb_response[14], &diag_flash_commits, 2);
+            memcpy(&usb_response[16], &Encoder_errors, 2);
+            usb_response[18] = diag_max_latency;
+            usb_response[19] = TASK_COUNT;
+            memcpy(&usb_response[20], task_misses, TASK_COUNT);
+            memcpy(&usb_response[20 + TASK_COUNT], &Encoder_reversals, 2);
+            usb_response[22 + TASK_COUNT] = Encoder_oversample;
+            usb_response[23 + TASK_COUNT] = Stack_base();
+            usb_response[24 + TASK_COUNT] = Stack_highWater();
+            if(report[2] == 1) {
+                diag_max_latency = 0;
+            }
+            finalizeResponse();
+            break;
+        }
+
+        case CMD_GET_STATS: {
+            // Scheduler deadline misses: [3]=task count, [4..]=per task.
+            // [2]=1 clears the counters after reading.
+            buildResponse(command, ERR_SUCCESS);
+            usb_response[3] = TASK_COUNT;
+            memcpy(&usb_response[4], task_misses, TASK_COUNT);
+            if(report[2] == 1) {
+                memset(task_misses, 0, TASK_COUNT);
+            }
             finalizeResponse();
             break;
         }
@@ -424,6 +722,21 @@ void handleUSBFeatureReport(uint8_t* report, uint8_t len) {
 // Helper Functions
 // ============================================================================
 
+// Actions of the active slot: the RAM overlay or a DataFlash slot
+Action* activeActions() {
+    if(current_slot == OVERLAY_SLOT) {
+        return overlay;
+    }
+    return config.slots[current_slot];
+}
+
+void showSlotColors() {
+    Action* actions = activeActions();
+    for(uint8_t i = 0; i < BOARD_KEY_COUNT; i++) {
+        led_colors[i] = actions[i].color_idle;
+    }
+}
+
 uint8_t getActionType(uint8_t control) {
     return control & 0x07;
 }
@@ -440,15 +753,15 @@ bool getHoldFlag(uint8_t control) {
 // DataFlash (EEPROM) Functions
 // ============================================================================
 
-// CH552 has 128 bytes of DataFlash for persistent storage
-// Addresses: 0-127 (only even addresses are valid)
+// CH552 has 128 bytes of DataFlash for persistent storage (CH559: the first
+// CHIP_CONFIG_BYTES of its 1 KB are used, see board.h)
 // Functions provided by CH55xduino: eeprom_read_byte(), eeprom_write_byte()
 
 uint8_t calcChecksum(const Configuration* cfg) {
     uint8_t checksum = 0;
     const uint8_t* data = (const uint8_t*)cfg;
 
-    // XOR all 128 bytes except the checksum byte itself (offset 4)
+    // XOR all bytes except the checksum byte itself (offset 4)
     for(uint8_t i = 0; i < sizeof(Configuration); i++) {
         if(i != 4) {  // Skip checksum byte at offset 4
             checksum ^= data[i];
@@ -457,33 +770,83 @@ uint8_t calcChecksum(const Configuration* cfg) {
     return checksum;
 }
 
-void saveConfigToDataFlash() {
-    // Calculate checksum
-    config.checksum = calcChecksum(&config);
+// Advance the commit by up to FLASH_BYTES_PER_RUN bytes; true when finished.
+// A config change during a commit restarts it from the new image.
+bool commitConfigStep() {
+    if(config_dirty) {
+        flash_commit_pos = FLASH_IDLE;
+    }
 
-    // ATOMIC WRITE PROTECTION:
-    // 1. Clear write complete marker first (reserved_hdr[0] at offset 5)
-    //    If power is lost during write, marker will remain cleared
-    eeprom_write_byte(5, 0xFF);  // Mark write in progress
-    delay(1);  // Ensure write completes
+    if(flash_commit_pos == FLASH_IDLE) {
+        config_dirty = false;
+        config.checksum = calcChecksum(&config);
+
+        // ATOMIC WRITE PROTECTION:
+        // 1. Clear write complete marker first (reserved_hdr[0] at offset 5)
+        //    If power is lost during write, marker will remain cleared
+        eeprom_write_byte(5, 0xFF);  // Mark write in progress
+        flash_commit_pos = 0;
+    }
 
-    // 2. Write all configuration data (including magic, checksum, etc.)
+    // 2. Write configuration data, skipping bytes that already match
     const uint8_t* data = (const uint8_t*)&config;
-    for(uint8_t addr = 0; addr < sizeof(Configuration) && addr < 128; addr++) {
-        if(addr != 5) {  // Skip write complete marker (written separately)
+    for(uint8_t n = 0; n < FLASH_BYTES_PER_RUN && flash_commit_pos < sizeof(Configuration);
+        n++, flash_commit_pos++) {
+        uint8_t addr = flash_commit_pos;
+        if(addr != 5 && eeprom_read_byte(addr) != data[addr]) {
             eeprom_write_byte(addr, data[addr]);
         }
     }
-    delay(1);  // Ensure all writes complete
+    if(flash_commit_pos < sizeof(Configuration)) {
+        return false;
+    }
 
     // 3. Write complete marker LAST - only written if all data written successfully
     eeprom_write_byte(5, WRITE_COMPLETE_MARKER);  // 0xAA = write complete
+    flash_commit_pos = FLASH_IDLE;
+    if(diag_flash_commits != 0xFFFF) diag_flash_commits++;
+    return true;
+}
+
+// Schedule a commit once writes have been quiet for FLASH_HOLDOFF_MS
+void requestConfigSave() {
+    config_dirty = true;
+    config_dirty_time = (uint16_t)millis();
+}
+
+// Fletcher-16 over the action table, active slot and LED brightness - the
+// READ_CONFIG image. Cheaper than a CRC on the 8051 and enough to tell a
+// host whether its cached copy is still current.
+uint16_t configFingerprint() {
+    const uint8_t* data = (const uint8_t*)&config.slots[0][0];
+    uint8_t b;
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+
+    for(uint16_t i = 0; i < CONFIG_ACTION_BYTES + 2; i++) {
+        if(i < CONFIG_ACTION_BYTES) {
+            b = data[i];
+        } else {
+            b = (i == CONFIG_ACTION_BYTES) ? config.active_slot : config_led_brightness;
+        }
+        sum1 += b;
+        if(sum1 >= 255) sum1 -= 255;
+        sum2 += sum1;
+        if(sum2 >= 255) sum2 -= 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+// Blocking commit (boot time only)
+void saveConfigToDataFlash() {
+    config_dirty = true;
+    while(!commitConfigStep());
 }
 
 bool loadConfigFromDataFlash() {
     // Read configuration from DataFlash
     uint8_t* data = (uint8_t*)&config;
-    for(uint8_t addr = 0; addr < sizeof(Configuration) && addr < 128; addr++) {
+    for(uint8_t addr = 0; addr < sizeof(Configuration); addr++) {
         data[addr] = eeprom_read_byte(addr);
     }
 
@@ -521,96 +884,72 @@ bool loadConfigFromDataFlash() {
 // Configuration Management
 // ============================================================================
 
+// Factory presets live in code flash as packed slot images. The default
+// configuration is the first MAX_SLOTS presets in order. Images describe the
+// original 3 keys + encoder; on larger boards the remaining keys start empty.
+//
+// Preset layout per input: {control, primary, secondary, color_idle, color_active}
+
+// Encoder volume (REVERSED - physical CW increases volume), shared by all presets
+#define PRESET_ENC_VOLUME \
+    {ACTION_MEDIA, 0xE9, 0x00, COLOR_OFF, COLOR_OFF},   /* ENC_CW:  Volume Up */   \
+    {ACTION_MEDIA, 0xEA, 0x00, COLOR_OFF, COLOR_OFF}    /* ENC_CCW: Volume Down */
+
+__code const Action PRESETS[PRESET_COUNT][PRESET_KEYS + 2] = {
+    // PRESET_TEAMS: Microsoft Teams (blue)
+    {
+        {ACTION_KEYBOARD | MOD_CTRL | HOLD_FLAG, ' ', 0, COLOR_BLUE, COLOR_BLUE},   // Ctrl+Space (PTT, hold)
+        {ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT, 'm', 0, COLOR_BLUE, COLOR_BLUE},   // Ctrl+Shift+M (mic)
+        {ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT, 'o', 0, COLOR_BLUE, COLOR_BLUE},   // Ctrl+Shift+O (camera)
+        PRESET_ENC_VOLUME
+    },
+    // PRESET_MEDIA: YouTube / media player (red)
+    {
+        {ACTION_KEYBOARD, 'l', 0, COLOR_RED, COLOR_RED},                            // 'l' seek forward 10s
+        {ACTION_KEYBOARD, 'j', 0, COLOR_RED, COLOR_RED},                            // 'j' seek backward 10s
+        {ACTION_MEDIA, 0xCD, 0x00, COLOR_RED, COLOR_RED},                           // Play/Pause
+        PRESET_ENC_VOLUME
+    },
+    // PRESET_VS2022: Visual Studio 2022 (green)
+    {
+        {ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT, 'f', 0, COLOR_GREEN, COLOR_GREEN}, // Ctrl+Shift+F (find in files)
+        {ACTION_KEYBOARD | MOD_CTRL, 'm', 0, COLOR_GREEN, COLOR_GREEN},             // Ctrl+M (collapse/expand)
+        {ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT, 'b', 0, COLOR_GREEN, COLOR_GREEN}, // Ctrl+Shift+B (build)
+        PRESET_ENC_VOLUME
+    }
+};
+
 void loadDefaultConfig() {
-    // Clear config
+    // Clear config and set header
     memset(&config, 0, sizeof(config));
-
-    // Set header
     config.magic = 0x55AA;
     config.version = 1;
-    config.active_slot = 0;
-    config_led_brightness = DEFAULT_LED_BRIGHTNESS;  // Default LED brightness
-
-    // Slot 0: Microsoft Teams
-    // BTN_1: Ctrl+Space (PTT - Push to Talk, Hold mode)
-    config.slots[0][INPUT_BTN_1].control = ACTION_KEYBOARD | MOD_CTRL | HOLD_FLAG;
-    config.slots[0][INPUT_BTN_1].primary = ' '; // Space (ASCII)
-    config.slots[0][INPUT_BTN_1].color_idle = COLOR_BLUE;
-    config.slots[0][INPUT_BTN_1].color_active = COLOR_BLUE;
-
-    // BTN_2: Ctrl+Shift+M (Mic toggle)
-    config.slots[0][INPUT_BTN_2].control = ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT;
-    config.slots[0][INPUT_BTN_2].primary = 'm'; // M key (ASCII)
-    config.slots[0][INPUT_BTN_2].color_idle = COLOR_BLUE;
-    config.slots[0][INPUT_BTN_2].color_active = COLOR_BLUE;
-
-    // BTN_3: Ctrl+Shift+O (Camera toggle)
-    config.slots[0][INPUT_BTN_3].control = ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT;
-    config.slots[0][INPUT_BTN_3].primary = 'o'; // O key (ASCII)
-    config.slots[0][INPUT_BTN_3].color_idle = COLOR_BLUE;
-    config.slots[0][INPUT_BTN_3].color_active = COLOR_BLUE;
-
-    // ENC_CW: Volume Up (REVERSED - physical CW now increases volume)
-    config.slots[0][INPUT_ENC_CW].control = ACTION_MEDIA;
-    config.slots[0][INPUT_ENC_CW].primary = 0xE9; // Volume Up low byte
-    config.slots[0][INPUT_ENC_CW].secondary = 0x00; // Volume Up high byte
-
-    // ENC_CCW: Volume Down (REVERSED - physical CCW now decreases volume)
-    config.slots[0][INPUT_ENC_CCW].control = ACTION_MEDIA;
-    config.slots[0][INPUT_ENC_CCW].primary = 0xEA; // Volume Down low byte
-    config.slots[0][INPUT_ENC_CCW].secondary = 0x00; // Volume Down high byte
-
-    // Slot 1: Media Control (YouTube/Media Player)
-    // BTN_1: 'l' key (YouTube seek forward 10s)
-    config.slots[1][INPUT_BTN_1].control = ACTION_KEYBOARD;
-    config.slots[1][INPUT_BTN_1].primary = 'l'; // L key (ASCII)
-    config.slots[1][INPUT_BTN_1].color_idle = COLOR_RED;
-    config.slots[1][INPUT_BTN_1].color_active = COLOR_RED;
-
-    // BTN_2: 'j' key (YouTube seek backward 10s)
-    config.slots[1][INPUT_BTN_2].control = ACTION_KEYBOARD;
-    config.slots[1][INPUT_BTN_2].primary = 'j'; // J key (ASCII)
-    config.slots[1][INPUT_BTN_2].color_idle = COLOR_RED;
-    config.slots[1][INPUT_BTN_2].color_active = COLOR_RED;
-
-    // BTN_3: Play/Pause
-    config.slots[1][INPUT_BTN_3].control = ACTION_MEDIA;
-    config.slots[1][INPUT_BTN_3].primary = 0xCD; // Play/Pause
-    config.slots[1][INPUT_BTN_3].secondary = 0x00;
-    config.slots[1][INPUT_BTN_3].color_idle = COLOR_RED;
-    config.slots[1][INPUT_BTN_3].color_active = COLOR_RED;
-
-    // Copy volume controls from slot 0
-    config.slots[1][INPUT_ENC_CW] = config.slots[0][INPUT_ENC_CW];
-    config.slots[1][INPUT_ENC_CCW] = config.slots[0][INPUT_ENC_CCW];
-
-    // Slot 2: Visual Studio 2022
-    // BTN_1: Ctrl+Shift+F (Find in Files)
-    config.slots[2][INPUT_BTN_1].control = ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT;
-    config.slots[2][INPUT_BTN_1].primary = 'f'; // F key (ASCII)
-    config.slots[2][INPUT_BTN_1].color_idle = COLOR_GREEN;
-    config.slots[2][INPUT_BTN_1].color_active = COLOR_GREEN;
-
-    // BTN_2: Ctrl+M (Collapse/Expand - simplified from v1's Ctrl+M,Ctrl+O sequence)
-    config.slots[2][INPUT_BTN_2].control = ACTION_KEYBOARD | MOD_CTRL;
-    config.slots[2][INPUT_BTN_2].primary = 'm'; // M key (ASCII)
-    config.slots[2][INPUT_BTN_2].color_idle = COLOR_GREEN;
-    config.slots[2][INPUT_BTN_2].color_active = COLOR_GREEN;
-
-    // BTN_3: Ctrl+Shift+B (Build Solution)
-    config.slots[2][INPUT_BTN_3].control = ACTION_KEYBOARD | MOD_CTRL | MOD_SHIFT;
-    config.slots[2][INPUT_BTN_3].primary = 'b'; // B key (ASCII)
-    config.slots[2][INPUT_BTN_3].color_idle = COLOR_GREEN;
-    config.slots[2][INPUT_BTN_3].color_active = COLOR_GREEN;
-
-    // Copy volume controls
-    config.slots[2][INPUT_ENC_CW] = config.slots[0][INPUT_ENC_CW];
-    config.slots[2][INPUT_ENC_CCW] = config.slots[0][INPUT_ENC_CCW];
+    config_led_brightness = DEFAULT_LED_BRIGHTNESS;
+
+    // Slot 0: Teams, Slot 1: Media, Slot 2: Visual Studio (further slots empty)
+    for(uint8_t slot = 0; slot < MAX_SLOTS && slot < PRESET_COUNT; slot++) {
+        loadPreset(slot, slot);
+    }
 
     // Set write complete marker (atomic write protection)
     config.reserved_hdr[0] = WRITE_COMPLETE_MARKER;
 }
 
+bool loadPreset(uint8_t slot, uint8_t preset) {
+    if(slot >= MAX_SLOTS || preset >= PRESET_COUNT) {
+        return false;
+    }
+
+    // Images hold 3 keys + encoder; extra keys on larger boards start empty
+    Action* dst = config.slots[slot];
+    memset(dst, 0, sizeof(config.slots[slot]));
+    copyFromCode((__xdata uint8_t*)dst, (__code const uint8_t*)PRESETS[preset],
+                 PRESET_COPY_KEYS * sizeof(Action));
+    copyFromCode((__xdata uint8_t*)&dst[INPUT_ENC_CW], (__code const uint8_t*)&PRESETS[preset][PRESET_KEYS],
+                 2 * sizeof(Action));
+    return true;
+}
+
 // ============================================================================
 // Action Execution
 // ============================================================================
@@ -684,10 +1023,11 @@ void executeAction(const Action* action, bool press) {
                     uint8_t clicks = (action->secondary == 0) ? 1 : action->secondary;
 
                     for(uint8_t c = 0; c < clicks; c++) {
-                        // Press buttons
+                        // Press buttons (all of them in one report)
                         if(action->primary & 0x01) Mouse_press(MOUSE_LEFT);
                         if(action->primary & 0x02) Mouse_press(MOUSE_RIGHT);
                         if(action->primary & 0x04) Mouse_press(MOUSE_MIDDLE);
+                        Mouse_send();
 
                         delay(50);
 
@@ -695,6 +1035,7 @@ void executeAction(const Action* action, bool press) {
                         if(action->primary & 0x01) Mouse_release(MOUSE_LEFT);
                         if(action->primary & 0x02) Mouse_release(MOUSE_RIGHT);
                         if(action->primary & 0x04) Mouse_release(MOUSE_MIDDLE);
+                        Mouse_send();
 
                         // Delay between clicks (not after last click)
                         if(c < clicks - 1) {
@@ -706,6 +1047,8 @@ void executeAction(const Action* action, bool press) {
                     Keyboard_releaseAll();
                 } else {
                     // Hold mode: Press and hold buttons while button is pressed
+                    // (other held buttons and scrolling keep going, TASK_HID
+                    // sends the combined state)
                     if(action->primary & 0x01) Mouse_press(MOUSE_LEFT);
                     if(action->primary & 0x02) Mouse_press(MOUSE_RIGHT);
                     if(action->primary & 0x04) Mouse_press(MOUSE_MIDDLE);
@@ -715,6 +1058,7 @@ void executeAction(const Action* action, bool press) {
                 if(action->primary & 0x01) Mouse_release(MOUSE_LEFT);
                 if(action->primary & 0x02) Mouse_release(MOUSE_RIGHT);
                 if(action->primary & 0x04) Mouse_release(MOUSE_MIDDLE);
+                Mouse_send();  // Buttons up before the modifiers
 
                 // Release modifiers
                 Keyboard_releaseAll();
@@ -737,11 +1081,12 @@ void executeAction(const Action* action, bool press) {
                     if(modifiers & MOD_GUI)   Keyboard_press(KEY_LEFT_GUI);
 
                     if(!hold) {
-                        // Normal mode: Scroll specified number of lines
+                        // Normal mode: Scroll specified number of lines, up
+                        // to 127 per report
                         for(uint8_t i = 0; i < lines; i++) {
                             Mouse_scroll(direction);
-                            delay(10);  // Small delay between scroll events
                         }
+                        Mouse_send();
 
                         // Release modifiers after scroll
                         Keyboard_releaseAll();
@@ -751,10 +1096,36 @@ void executeAction(const Action* action, bool press) {
                     }
                 } else if(hold) {
                     // Hold mode: Release modifiers on button release
+                    Mouse_send();  // Wheel movement still queued goes first
                     Keyboard_releaseAll();
                 }
             }
             break;
+
+        case ACTION_MACRO:
+            // Precompiled usage stream (macro_data.h), played from loop()
+            if(press) {
+                Macro_start(action->primary);
+            }
+            break;
+
+        case ACTION_SCRIPT:
+            // Bytecode VM (script_data.h), run from loop()
+            if(press) {
+                Script_start(action->primary);
+            } else if(hold) {
+                Script_stop();
+            }
+            break;
+
+#if USB_HID_HOST_EVENTS
+        case ACTION_HOST:
+            // The host runs the action: report which input changed. Releases
+            // are only reported with the hold flag, as for the other types.
+            // Actions always come from the active slot (overlay: OVERLAY_SLOT).
+            HostEvent_send(current_slot, (uint8_t)(action - activeActions()), press);
+            break;
+#endif
     }
 }
 
@@ -762,81 +1133,195 @@ void executeAction(const Action* action, bool press) {
 // Input Handling
 // ============================================================================
 
-void readButtons() {
-    // Read button states
-    btn_states[0] = !digitalRead(PIN_BTN_1); // Active low
-    btn_states[1] = !digitalRead(PIN_BTN_2);
-    btn_states[2] = !digitalRead(PIN_BTN_3);
+// Count one activation of an input in the current slot (not the overlay)
+void countPress(uint8_t input) {
+    if(current_slot == OVERLAY_SLOT) return;
+    uint16_t* counter = &press_counts[current_slot * MAX_INPUTS + input];
+    if(*counter != 0xFFFF) (*counter)++;
+}
+
+#if FAST_KEY
+// ============================================================================
+// Press Fast Path
+// ============================================================================
+//
+// Normally a press is sent after four debounce samples, and executeAction()
+// then sends the modifiers and the key as separate reports, one poll
+// interval each. For the T2EX key the main loop instead keeps the complete
+// press report staged (Keyboard_stage). The pin's falling edge loads it into
+// EP1 from the Timer2 interrupt, so it leaves with the next IN poll. The
+// debounced scan later confirms it, or retracts it if no press follows
+// within FAST_KEY_RETRACT_MS (a glitch). Only keyboard actions use it.
+//
+// Timer2 itself stays stopped; with EXEN2 set a T2EX falling edge still
+// raises EXF2 and the Timer2 interrupt.
+
+#define FAST_KEY_OFF        0  // Not armed: key down or action not eligible
+#define FAST_KEY_ARMED      1  // Report staged, edge interrupt enabled
+#define FAST_KEY_FIRED      2  // Report sent ahead of the debounce
 
-    // Process each button
-    for(uint8_t i = 0; i < 3; i++) {
-        if(btn_states[i] && !btn_last[i]) {
-            // Button pressed
-            btn_press_time[i] = millis();
+#define FAST_KEY_RETRACT_MS 8  // Four debounce samples plus margin
 
-            const Action* action = &config.slots[current_slot][i];
-            executeAction(action, true);
+void fastKeyInterrupt(void) __interrupt(INT_NO_TMR2) {
+    EXF2 = 0;
+    ET2 = 0;  // One report per arming, contact bounce is ignored
+    USB_EP1_stage();
+    fast_key_fired = true;
+}
 
-            // Update LED
-            led_colors[i] = action->color_active;
-        }
-        else if(!btn_states[i] && btn_last[i]) {
-            // Button released
-            const Action* action = &config.slots[current_slot][i];
+void fastKeyInit() {
+    EXF2 = 0;
+    EXEN2 = 1;  // T2EX falling edge sets EXF2
+}
 
-            if(getHoldFlag(action->control)) {
-                executeAction(action, false);
-            }
+void fastKeyArm(const Action* action) {
+    uint8_t modifiers = getModifiers(action->control);
+    uint8_t hid = 0;  // Key report modifier byte
+
+    if(modifiers & MOD_CTRL)  hid |= 0x01;
+    if(modifiers & MOD_SHIFT) hid |= 0x02;
+    if(modifiers & MOD_ALT)   hid |= 0x04;
+    if(modifiers & MOD_GUI)   hid |= 0x08;
+
+    Keyboard_stage(hid, action->primary);
+    fast_key_control = action->control;
+    fast_key_primary = action->primary;
+    fast_key_fired = false;
+    EXF2 = 0;  // Forget edges from while it was disarmed
+    fast_key_state = FAST_KEY_ARMED;
+    ET2 = 1;
+}
 
-            // Update LED
-            led_colors[i] = action->color_idle;
+// Once per input scan, before the keys are read
+void fastKeyUpdate() {
+    const Action* action = &activeActions()[BOARD_T2EX_KEY];
+
+    if(fast_key_state == FAST_KEY_ARMED) {
+        if(fast_key_fired) {
+            fast_key_state = FAST_KEY_FIRED;
+            fast_key_time = (uint16_t)millis();
+        } else if(action->control != fast_key_control || action->primary != fast_key_primary) {
+            // Slot switched or action rewritten - stage the new one
+            ET2 = 0;
+            Keyboard_unstage();
+            fast_key_state = FAST_KEY_OFF;
         }
+    } else if(fast_key_state == FAST_KEY_FIRED &&
+              (uint16_t)((uint16_t)millis() - fast_key_time) >= FAST_KEY_RETRACT_MS) {
+        // Edge without a debounced press
+        Keyboard_retract();
+        fast_key_state = FAST_KEY_OFF;
+    }
 
-        btn_last[i] = btn_states[i];
+    if(fast_key_state == FAST_KEY_OFF && !Keyscan_isDown(BOARD_T2EX_KEY) &&
+       getActionType(action->control) == ACTION_KEYBOARD) {
+        fastKeyArm(action);
     }
 }
 
-void readEncoder() {
-    // Read encoder pins
-    bool enc_a = digitalRead(PIN_ENC_A);
-    bool enc_b = digitalRead(PIN_ENC_B);
+// Debounced press of the T2EX key: true if the fast path already sent it,
+// otherwise it is disarmed and the press runs through executeAction()
+bool fastKeyConfirm(const Action* action) {
+    ET2 = 0;
+    uint8_t state = fast_key_state;
+    fast_key_state = FAST_KEY_OFF;  // Re-armed after the release
+
+    if(state == FAST_KEY_OFF || !fast_key_fired) {
+        Keyboard_unstage();
+        return false;
+    }
+
+    Keyboard_confirm();
+    if(!getHoldFlag(action->control)) {
+        // Normal key: release immediately, as executeAction() does
+        delay(1);
+        Keyboard_releaseAll();
+    }
+    return true;
+}
+#endif
+
+void readKeys() {
+    uint8_t changed[BOARD_KEY_ROWS];
+
+#if FAST_KEY
+    fastKeyUpdate();
+#endif
+
+    // Scan and debounce all keys (see keyscan.h)
+    if(!Keyscan_scan(changed)) return;
+
+    led_due = (uint16_t)millis();  // Show the new colors on the next pass
+
+    for(uint8_t r = 0; r < BOARD_KEY_ROWS; r++) {
+        if(!changed[r]) continue;
+
+        for(uint8_t c = 0; c < BOARD_KEY_COLS; c++) {
+            uint8_t mask = 1 << c;
+            if(!(changed[r] & mask)) continue;
+
+            uint8_t key = r * BOARD_KEY_COLS + c;
+            const Action* action = &activeActions()[key];
+
+            if(Keyscan_state[r] & mask) {
+                // Key pressed
+                countPress(key);
+#if FAST_KEY
+                if(key != BOARD_T2EX_KEY || !fastKeyConfirm(action))
+#endif
+                executeAction(action, true);
+                led_colors[key] = action->color_active;
+            } else {
+                // Key released
+                if(getHoldFlag(action->control)) {
+                    executeAction(action, false);
+                }
+                led_colors[key] = action->color_idle;
+            }
+        }
+    }
+}
 
-    // Gray code state
-    uint8_t new_state = (enc_a ? 2 : 0) | (enc_b ? 1 : 0);
+void readEncoders() {
+    int8_t steps[BOARD_ENCODER_COUNT];
+    uint8_t changed;
 
-    // State transition table for quadrature decoding
-    const int8_t enc_table[] = {0,-1,1,0,1,0,0,-1,-1,0,0,1,0,1,-1,0};
-    uint8_t index = (enc_last << 2) | new_state;
-    int8_t direction = enc_table[index];
+    Encoder_scan(steps, &changed);
 
-    enc_position += direction;
+    // Rotation (one event per full detent)
+    for(uint8_t e = 0; e < BOARD_ENCODER_COUNT; e++) {
+        if(!steps[e]) continue;
 
-    // Generate events on full detent (4 transitions)
-    if(enc_position >= 4) {
-        // Clockwise
-        if(slot_switch_mode) {
-            selected_slot = (selected_slot + 1) % MAX_SLOTS;
+        if(e == 0 && slot_switch_mode) {
+            // System encoder scrolls through slots in the slot menu
+            if(steps[e] > 0) {
+                selected_slot = (selected_slot + 1) % MAX_SLOTS;
+            } else {
+                selected_slot = (selected_slot + MAX_SLOTS - 1) % MAX_SLOTS;
+            }
         } else {
-            const Action* action = &config.slots[current_slot][INPUT_ENC_CW];
-            executeAction(action, true);
+            uint8_t input = INPUT_ENC_BASE(e) + (steps[e] > 0 ? 0 : 1);
+            countPress(input);
+            executeAction(&activeActions()[input], true);
         }
-        enc_position = 0;
     }
-    else if(enc_position <= -4) {
-        // Counter-clockwise
-        if(slot_switch_mode) {
-            selected_slot = (selected_slot + MAX_SLOTS - 1) % MAX_SLOTS;
-        } else {
-            const Action* action = &config.slots[current_slot][INPUT_ENC_CCW];
+
+    // Push buttons of the extra encoders run their PRESS action
+    for(uint8_t e = 1; e < BOARD_ENCODER_COUNT; e++) {
+        uint8_t mask = 1 << e;
+        if(!(changed & mask)) continue;
+
+        const Action* action = &activeActions()[INPUT_ENC_BASE(e) + 2];
+        if(Encoder_buttons & mask) {
+            countPress(INPUT_ENC_BASE(e) + 2);
             executeAction(action, true);
+        } else if(getHoldFlag(action->control)) {
+            executeAction(action, false);
         }
-        enc_position = 0;
     }
 
-    enc_last = new_state;
-
-    // Encoder button
-    bool enc_btn = !digitalRead(PIN_ENC_BTN);
+    // System encoder button (slot menu)
+    bool enc_btn = (Encoder_buttons & 1) != 0;
 
     if(enc_btn && !enc_btn_pressed) {
         // Button pressed
@@ -855,12 +1340,10 @@ void readEncoder() {
                 config.active_slot = current_slot;
 
                 // Save slot change to DataFlash
-                saveConfigToDataFlash();
+                requestConfigSave();
 
                 // Update LED colors for new slot
-                for(uint8_t i = 0; i < 3; i++) {
-                    led_colors[i] = config.slots[current_slot][i].color_idle;
-                }
+                showSlotColors();
             }
         }
 
@@ -873,40 +1356,230 @@ void readEncoder() {
         if(press_duration > 500 && !slot_switch_mode) {
             // Enter slot switch mode
             slot_switch_mode = true;
-            selected_slot = current_slot;
+            selected_slot = config.active_slot;  // Overlay: start at the saved slot
         }
     }
 }
 
+#define COMBO_KEYS  (((1 << BOARD_KEY_COLS) - 1) & 0x07)
+
+void enterBootloader() {
+    USB_CTRL = 0;    // Disable USB
+    EA = 0;          // Disable interrupts
+    TMOD = 0;        // Reset timer mode
+    __asm__ ("lcall #" CHIP_BOOTLOADER_ADDR);  // Jump to bootloader (0x3800 on CH552)
+}
+
+// LEDs shown while jumping to the bootloader (config kept)
+void showBootloaderLEDs() {
+    WS2812_setPixel(0, 0, 255, 255);   // Cyan
+    WS2812_setPixel(1, 0, 0, 255);     // Blue
+    WS2812_setPixel(2, 255, 0, 255);   // Magenta
+    WS2812_update();
+}
+
+void checkBootloaderRequest() {
+    // CMD_ENTER_BOOTLOADER: give the host time to read the response, then
+    // finish any pending config commit so nothing is lost, and jump
+    if(!bootloader_requested ||
+       (uint16_t)((uint16_t)millis() - bootloader_request_time) < BOOTLOADER_DELAY_MS) {
+        return;
+    }
+    if(config_dirty || flash_commit_pos != FLASH_IDLE) {
+        saveConfigToDataFlash();
+    }
+    showBootloaderLEDs();
+    enterBootloader();
+}
+
+void checkBootloaderCombo() {
+    // Check for bootloader entry (first three keys + encoder pressed simultaneously)
+    if((Keyscan_state[0] & COMBO_KEYS) == COMBO_KEYS && (Encoder_buttons & 1)) {
+        // All buttons pressed - erase config and enter bootloader mode
+
+        // ERASE CONFIG: Invalidate magic bytes to force defaults on next boot
+        eeprom_write_byte(0, 0x00);  // Clear magic byte low
+        eeprom_write_byte(1, 0x00);  // Clear magic byte high
+        eeprom_write_byte(5, 0xFF);  // Clear write complete marker
+        delay(10);  // Ensure writes complete
+
+        // Visual feedback: Flash all LEDs white to indicate config erased
+        WS2812_setPixel(0, 100, 100, 100);  // White
+        WS2812_setPixel(1, 100, 100, 100);  // White
+        WS2812_setPixel(2, 100, 100, 100);  // White
+        WS2812_update();
+        delay(200);  // Brief flash
+
+        enterBootloader();
+    }
+}
+
 // ============================================================================
 // LED Control - WS2812 Output
 // ============================================================================
 
-void updateLEDs() {
+// Slot menu colors for slots 0..LEDs-1, LEDs..2*LEDs-1, ... (green first)
+__code const uint8_t SLOT_BANK_COLORS[4] = {COLOR_GREEN, COLOR_BLUE, COLOR_MAGENTA, COLOR_YELLOW};
+
+void updateKeyLED(uint8_t i, uint8_t led, bool down, uint8_t brightness) {
     uint8_t r, g, b;
-    uint8_t brightness = config_led_brightness;
 
     if(slot_switch_mode) {
-        // Show slot selection (all green to avoid confusion)
-        led_colors[0] = (selected_slot == 0) ? COLOR_GREEN : COLOR_OFF;
-        led_colors[1] = (selected_slot == 1) ? COLOR_GREEN : COLOR_OFF;
-        led_colors[2] = (selected_slot == 2) ? COLOR_GREEN : COLOR_OFF;
-    } else {
-        // Show configured colors for idle buttons
-        for(uint8_t i = 0; i < 3; i++) {
-            if(!btn_states[i]) {
-                led_colors[i] = config.slots[current_slot][i].color_idle;
-            }
+        // Show slot selection: LED = slot % LED count, color = bank
+        led_colors[i] = (selected_slot % BOARD_LED_COUNT == led) ?
+                        SLOT_BANK_COLORS[selected_slot / BOARD_LED_COUNT] : COLOR_OFF;
+    } else if(!down) {
+        // Show configured color for idle key
+        led_colors[i] = activeActions()[i].color_idle;
+    }
+
+    getColor(led_colors[i], brightness, &r, &g, &b);
+    WS2812_setPixel(led, r, g, b);
+}
+
+void updateLEDs() {
+    uint8_t brightness = config_led_brightness;
+
+    // Unrolled per key that has an LED (board.h)
+#define X(key, led) updateKeyLED(key, led, Keyscan_isDown(key) != 0, brightness);
+    BOARD_KEY_LEDS(X)
+#undef X
+
+    WS2812_update();
+}
+
+// ============================================================================
+// Task Scheduler
+// ============================================================================
+//
+// Run-to-completion: each loop() pass collects ready tasks and runs only the
+// highest-priority one, so input is never more than one task run away.
+// Lateness is measured from when a task became ready (its due time for
+// periodic tasks) and counted against TASK_DEADLINE_MS.
+
+void markTaskReady(uint8_t task, uint16_t since) {
+    if(!(task_ready & TASK_BIT(task))) {
+        task_ready |= TASK_BIT(task);
+        task_ready_time[task] = since;
+    }
+}
+
+void pollTasks(uint16_t now) {
+    // Input scan locked to USB frames: one scan per Start-of-Frame, late
+    // enough in the frame that the scan and report build (~150 us) finish
+    // before the next frame's IN token. The report then leaves with the
+    // freshest debounced state, one frame after the scan at most, as EP1
+    // is polled every frame (KEYBOARD_MOUSE_INTERVAL, usb_descgen fast-poll).
+    uint8_t sof = USB_sofCount;
+    if(sof != input_sof) {
+        input_sof = sof;
+        input_sof_us = (uint16_t)micros();
+        input_sof_ms = now;
+        input_sof_wait = true;
+    }
+    if(input_sof_wait) {
+        if((uint16_t)((uint16_t)micros() - input_sof_us) >= INPUT_SOF_DELAY_US) {
+            input_sof_wait = false;
+            markTaskReady(TASK_INPUT, now);
+            input_due = now + INPUT_PERIOD_MS;
         }
+    } else if((uint16_t)(now - input_sof_ms) >= INPUT_SOF_TIMEOUT_MS &&
+              (int16_t)(now - input_due) >= 0) {
+        // Not enumerated or suspended: no frames, keep the 1 ms scan
+        markTaskReady(TASK_INPUT, input_due);
+        input_due = now + INPUT_PERIOD_MS;
+    }
+    if((Macro_isPlaying() || Mouse_pending() || Script_isReady()) && USB_EP1_ready()) {
+        markTaskReady(TASK_HID, now);
     }
+    if(usb_feature_pending) {
+        markTaskReady(TASK_CONFIG, now);
+    }
+    if((int16_t)(now - led_due) >= 0) {
+        markTaskReady(TASK_LED, led_due);
+        led_due = now + LED_PERIOD_MS;
+    }
+    if(flash_commit_pos != FLASH_IDLE ||
+       (config_dirty && (uint16_t)(now - config_dirty_time) >= FLASH_HOLDOFF_MS)) {
+        markTaskReady(TASK_FLASH, now);
+    }
+}
+
+void runScriptTask() {
+    uint8_t slot = Script_task();
+    if(slot >= MAX_SLOTS) return;
 
-    // Update WS2812 LEDs with actual colors
-    for(uint8_t i = 0; i < 3; i++) {
-        getColor(led_colors[i], brightness, &r, &g, &b);
-        WS2812_setPixel(i, r, g, b);
+    // Slot switch from a script: RAM only, like SET_SLOT without save
+    current_slot = slot;
+    config.active_slot = slot;
+    showSlotColors();
+}
+
+void runConfigTask() {
+    handleUSBFeatureReport(feature_report_buffer, REPORT_SIZE);
+
+    // Release the report buffer and send the response the way the command came
+    IE_USB = 0;
+#if CONFIG_ENDPOINT
+    uint8_t source = usb_feature_pending;
+    if(source == USB_FEATURE_FROM_EP2) {
+        USB_EP2_sendResponse();
+    }
+#endif
+    usb_feature_pending = 0;
+    USB_EP0_flushDeferredReport();  // GET_REPORT parked on this command, if any
+#if CONFIG_ENDPOINT
+    if(source == USB_FEATURE_FROM_EP0) {
+        USB_EP2_resume();  // EP2 was NAKed while this command was queued
     }
+#endif
+    IE_USB = 1;
+}
 
-    WS2812_update();
+void runNextTask() {
+    uint16_t now = (uint16_t)millis();
+    pollTasks(now);
+    diag_loop_passes++;
+
+    for(uint8_t t = 0; t < TASK_COUNT; t++) {
+        if(!(task_ready & TASK_BIT(t))) continue;
+
+        task_ready &= ~TASK_BIT(t);
+        uint16_t late = now - task_ready_time[t];
+        if(late > TASK_DEADLINE_MS[t] && task_misses[t] != 0xFF) {
+            task_misses[t]++;
+        }
+        if(late > diag_max_latency) {
+            diag_max_latency = late > 0xFF ? 0xFF : (uint8_t)late;
+        }
+
+        switch(t) {
+            case TASK_INPUT:
+                readKeys();
+                readEncoders();
+                checkBootloaderCombo();
+                checkBootloaderRequest();
+                break;
+            case TASK_HID:
+                // One report per run: the combined mouse state, else macro,
+                // else script (which only sends while EP1 is still free)
+                if(!Mouse_flush()) {
+                    Macro_task();
+                    runScriptTask();
+                }
+                break;
+            case TASK_CONFIG:
+                runConfigTask();
+                break;
+            case TASK_LED:
+                updateLEDs();
+                break;
+            case TASK_FLASH:
+                commitConfigStep();
+                break;
+        }
+        return;
+    }
 }
 
 // ============================================================================
@@ -914,43 +1587,35 @@ void updateLEDs() {
 // ============================================================================
 
 void setup() {
+    // Paint the free stack first; GET_DIAG reports how far it was used
+    Stack_paint();
+
     // Check for bootloader entry on power-up (BEFORE USB init)
-    pinMode(PIN_ENC_BTN, INPUT_PULLUP);
+    Encoder_init();  // Also latches the initial encoder positions
 
-    if(!digitalRead(PIN_ENC_BTN)) {
-        // Encoder button held down on power-up - enter bootloader mode
+    if(Encoder_readButtons() & 1) {
+        // System encoder button held down on power-up - enter bootloader mode
 
         // Visual feedback: Set LEDs to Cyan/Blue/Magenta
         WS2812_init();
-        WS2812_setPixel(0, 0, 255, 255);   // Cyan
-        WS2812_setPixel(1, 0, 0, 255);     // Blue
-        WS2812_setPixel(2, 255, 0, 255);   // Magenta
-        WS2812_update();
+        showBootloaderLEDs();
         delay(100);  // Brief display
 
-        // Jump to bootloader at 0x3800
-        USB_CTRL = 0;    // Disable USB
-        EA = 0;          // Disable interrupts
-        TMOD = 0;        // Reset timer mode
-        __asm__ ("lcall #0x3800");  // Jump to bootloader
+        enterBootloader();
     }
 
     // Initialize USB
     USBInit();
 
-    // Configure remaining pins (PIN_ENC_BTN already configured above)
-    pinMode(PIN_BTN_1, INPUT_PULLUP);
-    pinMode(PIN_BTN_2, INPUT_PULLUP);
-    pinMode(PIN_BTN_3, INPUT_PULLUP);
-    pinMode(PIN_ENC_A, INPUT_PULLUP);
-    pinMode(PIN_ENC_B, INPUT_PULLUP);
+    // Configure remaining pins (encoder pins already configured above)
+    Keyscan_init();
+#if FAST_KEY
+    fastKeyInit();
+#endif
 
     // Initialize WS2812 LEDs
     WS2812_init();
 
-    // Read initial encoder state
-    enc_last = (digitalRead(PIN_ENC_A) ? 2 : 0) | (digitalRead(PIN_ENC_B) ? 1 : 0);
-
     // Load configuration from DataFlash
     if(!loadConfigFromDataFlash()) {
         // No valid config - load and save defaults
@@ -960,47 +1625,15 @@ void setup() {
     current_slot = config.active_slot;
 
     // Initialize LED colors
-    for(uint8_t i = 0; i < 3; i++) {
-        led_colors[i] = config.slots[current_slot][i].color_idle;
-    }
+    showSlotColors();
 
     // Show initial LED state
     updateLEDs();
 }
 
 void loop() {
-    // Read inputs
-    readButtons();
-    readEncoder();
-
-    // Check for bootloader entry (all 4 buttons pressed simultaneously)
-    bool enc_btn = !digitalRead(PIN_ENC_BTN);
-    if(btn_states[0] && btn_states[1] && btn_states[2] && enc_btn) {
-        // All buttons pressed - erase config and enter bootloader mode
-
-        // ERASE CONFIG: Invalidate magic bytes to force defaults on next boot
-        eeprom_write_byte(0, 0x00);  // Clear magic byte low
-        eeprom_write_byte(1, 0x00);  // Clear magic byte high
-        eeprom_write_byte(5, 0xFF);  // Clear write complete marker
-        delay(10);  // Ensure writes complete
-
-        // Visual feedback: Flash all LEDs white to indicate config erased
-        WS2812_setPixel(0, 100, 100, 100);  // White
-        WS2812_setPixel(1, 100, 100, 100);  // White
-        WS2812_setPixel(2, 100, 100, 100);  // White
-        WS2812_update();
-        delay(200);  // Brief flash
-
-        // Enter bootloader
-        USB_CTRL = 0;    // Disable USB
-        EA = 0;          // Disable interrupts
-        TMOD = 0;        // Reset timer mode
-        __asm__ ("lcall #0x3800");  // Jump to bootloader
+    if(Encoder_oversample) {
+        Encoder_sample();  // Auto-tuned by Encoder_scan() for fast spins
     }
-
-    // Update LEDs
-    updateLEDs();
-
-    // USB polling
-    delay(5); // Simple 5ms loop for now
-}
\ No newline at end of file
+    runNextTask();
+}
@@ -0,0 +1,179 @@
+// ===================================================================================
+// Rotary Encoder Decoder Implementation for CH552G Keyboard v2.0
+// ===================================================================================
+
+#include <Arduino.h>
+#include "encoder.h"
+
+uint8_t Encoder_buttons = 0;
+uint16_t Encoder_errors = 0;
+uint16_t Encoder_reversals = 0;
+uint8_t Encoder_oversample = 0;
+
+static uint8_t encoder_last[BOARD_ENCODER_COUNT];     // Previous A/B state, rest = 3
+static uint8_t encoder_filter[BOARD_ENCODER_COUNT];   // Sequence filter state
+static int8_t encoder_dir[BOARD_ENCODER_COUNT];       // Direction of the last quarter step
+static int8_t encoder_detents[BOARD_ENCODER_COUNT];   // Decoded, not yet reported
+static uint8_t encoder_ct0 = 0xFF;                    // Button debounce counters
+static uint8_t encoder_ct1 = 0xFF;
+
+// Sampling auto-tune
+#define ENCODER_TUNE_ERRORS  2   // Illegal transitions per window that enable oversampling
+#define ENCODER_TUNE_QUIET   16  // Still windows before oversampling stops (~4 s)
+static uint8_t encoder_window = 0;           // Scans in the current window (256 = ~256 ms)
+static uint16_t encoder_window_errors = 0;   // Encoder_errors at the window start
+static uint8_t encoder_moved = 0;            // Any A/B change in the current window
+static uint8_t encoder_quiet = 0;            // Still windows while oversampling
+
+// Quadrature transition table, index = (previous A/B << 2) | current A/B
+static __code const int8_t ENCODER_TABLE[16] = {0,-1,1,0,1,0,0,-1,-1,0,0,1,0,1,-1,0};
+
+// Valid-sequence filter, [filter state][current A/B]. Starting from rest (3),
+// CW runs 1, 0, 2 and back to 3; CCW runs 2, 0, 1, 3. Only the return to rest
+// at the end of a complete sequence emits a detent.
+#define FILTER_START      0
+#define FILTER_CW_BEGIN   1
+#define FILTER_CW_NEXT    2
+#define FILTER_CW_FINAL   3
+#define FILTER_CCW_BEGIN  4
+#define FILTER_CCW_NEXT   5
+#define FILTER_CCW_FINAL  6
+#define FILTER_EMIT_CW    0x10
+#define FILTER_EMIT_CCW   0x20
+static __code const uint8_t ENCODER_FILTER[7][4] = {
+  /* START     */ {FILTER_START,     FILTER_CW_BEGIN,  FILTER_CCW_BEGIN, FILTER_START},
+  /* CW_BEGIN  */ {FILTER_CW_NEXT,   FILTER_CW_BEGIN,  FILTER_START,     FILTER_START},
+  /* CW_NEXT   */ {FILTER_CW_NEXT,   FILTER_CW_BEGIN,  FILTER_CW_FINAL,  FILTER_START},
+  /* CW_FINAL  */ {FILTER_CW_NEXT,   FILTER_START,     FILTER_CW_FINAL,  FILTER_START | FILTER_EMIT_CW},
+  /* CCW_BEGIN */ {FILTER_CCW_NEXT,  FILTER_START,     FILTER_CCW_BEGIN, FILTER_START},
+  /* CCW_NEXT  */ {FILTER_CCW_NEXT,  FILTER_CCW_FINAL, FILTER_CCW_BEGIN, FILTER_START},
+  /* CCW_FINAL */ {FILTER_CCW_NEXT,  FILTER_CCW_FINAL, FILTER_START,     FILTER_START | FILTER_EMIT_CCW},
+};
+
+// One read per port; encoder pins are then picked from the snapshot
+#define ENCODER_SNAPSHOT()  uint8_t snap1 = P1; uint8_t snap3 = P3; (void)snap1; (void)snap3;
+#define ENCODER_PIN(port, bit) ((snap##port >> (bit)) & 1)
+
+// A/B state with the board's detent mapped to 3 (XOR 3 keeps the direction)
+#define ENCODER_STATE(ap, ab, bp, bb) \
+  (((ENCODER_PIN(ap, ab) << 1) | ENCODER_PIN(bp, bb)) ^ (BOARD_ENCODER_DETENT ^ 3))
+
+// ===================================================================================
+// Initialize Encoder Pins
+// ===================================================================================
+void Encoder_init(void) {
+#define X(e, ap, ab, bp, bb, sp, sb) \
+  pinMode(BOARD_PIN_(ap, ab), INPUT_PULLUP); \
+  pinMode(BOARD_PIN_(bp, bb), INPUT_PULLUP); \
+  pinMode(BOARD_PIN_(sp, sb), INPUT_PULLUP);
+  BOARD_ENCODERS(X)
+#undef X
+
+  ENCODER_SNAPSHOT();
+#define X(e, ap, ab, bp, bb, sp, sb) \
+  encoder_last[e] = ENCODER_STATE(ap, ab, bp, bb); \
+  encoder_filter[e] = FILTER_START; \
+  encoder_dir[e] = 0; \
+  encoder_detents[e] = 0;
+  BOARD_ENCODERS(X)
+#undef X
+}
+
+uint8_t Encoder_readButtons(void) {
+  uint8_t buttons = 0;
+
+  ENCODER_SNAPSHOT();
+#define X(e, ap, ab, bp, bb, sp, sb) if(!ENCODER_PIN(sp, sb)) buttons |= 1 << (e);
+  BOARD_ENCODERS(X)
+#undef X
+  return buttons;
+}
+
+// ===================================================================================
+// Decode One Encoder Sample
+// ===================================================================================
+static void Encoder_decode(uint8_t e, uint8_t state) {
+  uint8_t last = encoder_last[e];
+  uint8_t next;
+  int8_t quarter;
+
+  if(state == last) return;
+  encoder_last[e] = state;
+  encoder_moved = 1;
+
+  // Quality accounting
+  quarter = ENCODER_TABLE[(last << 2) | state];
+  if(!quarter) {
+    if(Encoder_errors != 0xFFFF) Encoder_errors++;  // A and B changed: a state was missed
+  } else {
+    if(quarter == -encoder_dir[e] && Encoder_reversals != 0xFFFF) Encoder_reversals++;
+    encoder_dir[e] = quarter;
+  }
+
+  next = ENCODER_FILTER[encoder_filter[e]][state];
+  encoder_filter[e] = next & 0x0F;
+  if(next & FILTER_EMIT_CW) encoder_detents[e]++;
+  else if(next & FILTER_EMIT_CCW) encoder_detents[e]--;
+}
+
+void Encoder_sample(void) {
+  ENCODER_SNAPSHOT();
+#define X(e, ap, ab, bp, bb, sp, sb) Encoder_decode(e, ENCODER_STATE(ap, ab, bp, bb));
+  BOARD_ENCODERS(X)
+#undef X
+}
+
+// ===================================================================================
+// Decode All Encoders
+// ===================================================================================
+uint8_t Encoder_scan(int8_t *steps, uint8_t *changed) {
+  uint8_t buttons = 0;
+  uint8_t delta;
+  uint8_t any = 0;
+
+  ENCODER_SNAPSHOT();
+#define X(e, ap, ab, bp, bb, sp, sb) \
+  Encoder_decode(e, ENCODER_STATE(ap, ab, bp, bb)); \
+  if(!ENCODER_PIN(sp, sb)) buttons |= 1 << (e);
+  BOARD_ENCODERS(X)
+#undef X
+
+  // One detent per encoder per scan; oversampled extras follow on the next scans
+  for(uint8_t e = 0; e < BOARD_ENCODER_COUNT; e++) {
+    steps[e] = 0;
+    if(encoder_detents[e] > 0) {
+      steps[e] = 1;
+      encoder_detents[e]--;
+      any = 1;
+    } else if(encoder_detents[e] < 0) {
+      steps[e] = -1;
+      encoder_detents[e]++;
+      any = 1;
+    }
+  }
+
+  // Sampling auto-tune: missed states mean the 1 ms scan is too slow for the
+  // current spin speed, so sample from every loop pass until all is still
+  if(++encoder_window == 0) {
+    if(Encoder_errors - encoder_window_errors >= ENCODER_TUNE_ERRORS) {
+      Encoder_oversample = 1;
+      encoder_quiet = 0;
+    } else if(encoder_moved) {
+      encoder_quiet = 0;
+    } else if(Encoder_oversample && ++encoder_quiet >= ENCODER_TUNE_QUIET) {
+      Encoder_oversample = 0;
+    }
+    encoder_window_errors = Encoder_errors;
+    encoder_moved = 0;
+  }
+
+  // Vertical counter debounce of the push buttons (see keyscan.c)
+  delta = buttons ^ Encoder_buttons;
+  encoder_ct0 = ~(encoder_ct0 & delta);
+  encoder_ct1 = encoder_ct0 ^ (encoder_ct1 & delta);
+  delta &= encoder_ct0 & encoder_ct1;
+  Encoder_buttons ^= delta;
+  *changed = delta;
+
+  return any | delta;
+}
@@ -0,0 +1,40 @@
+// ===================================================================================
+// Rotary Encoder Decoder for CH552G Keyboard v2.0
+// ===================================================================================
+//
+// Decodes all encoders listed in BOARD_ENCODERS (board.h, 1-4 encoders). Each
+// call snapshots the ports once, so every encoder is decoded from the same
+// instant. Each encoder then runs through a valid-sequence filter: a detent is
+// only reported when the encoder returns to its rest state after passing all
+// four quadrature states in one direction, so contact bounce between two
+// neighbouring states and illegal jumps never produce a step. The detent is
+// emitted on the same sample the old quarter-step count would have reached 4,
+// so the filter adds no latency.
+//
+// Quality counters: illegal transitions (A and B changed between two samples,
+// i.e. a state was missed) and reversals (a quarter step against the previous
+// one - bounce, or a real change of direction). When illegal transitions show
+// up the encoder turns faster than the 1 ms scan resolves, and Encoder_scan()
+// switches on oversampling: loop() then calls Encoder_sample() on every pass
+// until the encoders have been still for a few seconds.
+//
+// Encoder push buttons are debounced with the same vertical counters as the
+// keys (4 consecutive samples).
+// ===================================================================================
+
+#pragma once
+#include <stdint.h>
+#include "board.h"
+
+extern uint8_t Encoder_buttons;     // Debounced, bit e = button of encoder e held
+extern uint16_t Encoder_errors;     // Illegal transitions (A and B changed at once), saturating
+extern uint16_t Encoder_reversals;  // Quarter steps against the previous one, saturating
+extern uint8_t Encoder_oversample;  // Set while loop() should call Encoder_sample()
+
+// Public Functions
+void Encoder_init(void);                                // Configure pins, latch positions
+uint8_t Encoder_readButtons(void);                      // Raw button sample, bit e = pressed
+void Encoder_sample(void);                              // Decode rotation only (oversampling)
+uint8_t Encoder_scan(int8_t *steps, uint8_t *changed);  // steps[e] = +1 CW / -1 CCW detent,
+                                                        // *changed = toggled buttons;
+                                                        // returns non-zero on any event
@@ -0,0 +1,98 @@
+// ===================================================================================
+// Key Scanner Implementation for CH552G Keyboard v2.0
+// ===================================================================================
+
+#include <Arduino.h>
+#include "keyscan.h"
+
+uint8_t Keyscan_state[BOARD_KEY_ROWS];
+uint8_t Keyscan_ghosts = 0;
+
+// Vertical debounce counters (bit-sliced, one bit per key)
+static uint8_t keyscan_ct0[BOARD_KEY_ROWS];
+static uint8_t keyscan_ct1[BOARD_KEY_ROWS];
+
+#ifndef BOARD_MATRIX_SETTLE
+// Let the columns follow the newly driven row before they are read
+#define BOARD_MATRIX_SETTLE() { __asm__("nop"); __asm__("nop"); __asm__("nop"); __asm__("nop"); }
+#endif
+
+// ===================================================================================
+// Initialize Key Pins
+// ===================================================================================
+void Keyscan_init(void) {
+#ifdef BOARD_MATRIX_ROWS
+#define X(r, port, bit) pinMode(BOARD_PIN_(port, bit), INPUT_PULLUP); BOARD_SBIT_(port, bit) = 1;
+  BOARD_MATRIX_ROWS(X)
+#undef X
+#define X(c, port, bit) pinMode(BOARD_PIN_(port, bit), INPUT_PULLUP);
+  BOARD_MATRIX_COLS(X)
+#undef X
+#else
+#define X(i, port, bit) pinMode(BOARD_PIN_(port, bit), INPUT_PULLUP);
+  BOARD_BUTTONS(X)
+#undef X
+#endif
+
+  for(uint8_t r = 0; r < BOARD_KEY_ROWS; r++) {
+    Keyscan_state[r] = 0;
+    keyscan_ct0[r] = 0xFF;  // Counters idle
+    keyscan_ct1[r] = 0xFF;
+  }
+}
+
+// ===================================================================================
+// Scan and Debounce
+// ===================================================================================
+uint8_t Keyscan_scan(uint8_t *changed) {
+  uint8_t raw[BOARD_KEY_ROWS];
+  uint8_t delta;
+  uint8_t any = 0;
+
+  // Sample - one expansion per row / button from board.h, so every pin is a
+  // constant SFR bit test (readKeys() then loops over the changed bits)
+#ifdef BOARD_MATRIX_ROWS
+  // Rows are quasi-bidirectional: writing 0 drives low, 1 releases to pull-up
+#define X(r, port, bit) \
+  BOARD_SBIT_(port, bit) = 0; \
+  BOARD_MATRIX_SETTLE(); \
+  raw[r] = BOARD_MATRIX_COLS_READ(); \
+  BOARD_SBIT_(port, bit) = 1;
+  BOARD_MATRIX_ROWS(X)
+#undef X
+#else
+  raw[0] = 0;
+#define X(i, port, bit) if(!BOARD_SBIT_(port, bit)) raw[0] |= (1 << (i));
+  BOARD_BUTTONS(X)
+#undef X
+#endif
+
+#if defined(BOARD_MATRIX_ROWS) && !defined(BOARD_MATRIX_DIODES)
+  // Ghosting: two rows sharing two or more columns cannot be told apart from
+  // a phantom key - keep new presses on those rows out of this sample
+  for(uint8_t i = 0; i < BOARD_KEY_ROWS - 1; i++) {
+    for(uint8_t j = i + 1; j < BOARD_KEY_ROWS; j++) {
+      uint8_t common = raw[i] & raw[j];
+      if(common & (common - 1)) {
+        raw[i] &= Keyscan_state[i];
+        raw[j] &= Keyscan_state[j];
+        if(Keyscan_ghosts != 0xFF) Keyscan_ghosts++;
+      }
+    }
+  }
+#endif
+
+  // Vertical counter debounce: counters of unchanged keys reset to 3, keys
+  // that differ count down and toggle when they wrap (4th sample)
+  for(uint8_t r = 0; r < BOARD_KEY_ROWS; r++) {
+    delta = raw[r] ^ Keyscan_state[r];
+    keyscan_ct0[r] = ~(keyscan_ct0[r] & delta);
+    keyscan_ct1[r] = keyscan_ct0[r] ^ (keyscan_ct1[r] & delta);
+    delta &= keyscan_ct0[r] & keyscan_ct1[r];
+    Keyscan_state[r] ^= delta;
+    changed[r] = delta;
+    any |= delta;
+  }
+
+  return any;
+}
@@ -0,0 +1,36 @@
+// ===================================================================================
+// Key Scanner for CH552G Keyboard v2.0
+// ===================================================================================
+//
+// Samples every key of the board (direct buttons or a row/column matrix, see
+// board.h) once per call and debounces them with vertical counters: each key
+// has a 2-bit counter spread over two bytes per row, so a whole row of 8 keys
+// is debounced with a handful of byte operations. A key changes state after
+// 4 consecutive samples that disagree with its debounced state.
+//
+// Matrix rows are driven low one at a time and all columns are read with one
+// port read, so sampling a 3x4 matrix takes a few microseconds and a whole
+// scan including ghost check and debounce stays in the tens of microseconds.
+//
+// Matrices without diodes ghost: with three keys pressed on the corners of a
+// rectangle the fourth reads as pressed. A scan where two rows share more than
+// one column is ambiguous; new presses on those rows are held back until it
+// resolves (releases still go through) and Keyscan_ghosts is incremented.
+// Define BOARD_MATRIX_DIODES for boards with per-key diodes to skip the check.
+// ===================================================================================
+
+#pragma once
+#include <stdint.h>
+#include "board.h"
+
+// Debounced state: bit c of row r = key r * BOARD_KEY_COLS + c, 1 = pressed
+extern uint8_t Keyscan_state[BOARD_KEY_ROWS];
+extern uint8_t Keyscan_ghosts;  // Ambiguous scans seen (saturating)
+
+#define Keyscan_isDown(k) \
+  (Keyscan_state[(k) / BOARD_KEY_COLS] & (1 << ((k) % BOARD_KEY_COLS)))
+
+// Public Functions
+void Keyscan_init(void);                 // Configure pins, all keys released
+uint8_t Keyscan_scan(uint8_t *changed);  // Scan + debounce; changed[row] = toggled bits,
+                                         // returns non-zero if any key changed
@@ -0,0 +1,150 @@
+// ===================================================================================
+// Precompiled Macro Player Implementation for CH552G Keyboard v2.0
+// ===================================================================================
+
+#include <Arduino.h>
+#include "src/usb/userUsbHidKeyboardMouse/USBHIDKeyboardMouse.h"
+#include "macro.h"
+#include "macro_data.h"   // Generated by tools/macro_compile.py
+
+// Player state
+static __code const uint8_t *macro_ptr = 0;  // Next stored byte (0 = idle)
+static uint8_t macro_key = 0;                // Usage currently held down
+static uint8_t macro_mods = 0;               // Modifier bits the macro set itself
+static uint8_t macro_wait = 0;               // Remaining WAIT duration (ms)
+static uint16_t macro_wait_start = 0;        // millis() when WAIT began
+
+// Phrase stack (innermost phrase on top)
+static __code const uint8_t *macro_phrase[MACRO_PHRASE_DEPTH];
+static uint8_t macro_phrase_len[MACRO_PHRASE_DEPTH];
+static uint8_t macro_depth = 0;
+
+// ===================================================================================
+// Streaming Decoder
+// ===================================================================================
+
+// Next stored byte at the current nesting level (operands are always raw)
+static uint8_t macro_raw(void) {
+  while(macro_depth && !macro_phrase_len[macro_depth - 1]) {
+    macro_depth--;  // Phrase exhausted - resume the enclosing one
+  }
+  if(macro_depth) {
+    macro_phrase_len[macro_depth - 1]--;
+    return *macro_phrase[macro_depth - 1]++;
+  }
+  return *macro_ptr++;
+}
+
+// Next opcode with phrase references expanded (at most MACRO_PHRASE_DEPTH pushes)
+static uint8_t macro_fetch(void) {
+  uint8_t b;
+#if MACRO_PHRASE_COUNT
+  uint16_t start;
+#endif
+
+  for(;;) {
+    b = macro_raw();
+    if(b < MACRO_OP_PHRASE_FIRST || b > MACRO_OP_PHRASE_LAST) return b;
+
+#if MACRO_PHRASE_COUNT
+    b -= MACRO_OP_PHRASE_FIRST;
+    if(b >= MACRO_PHRASE_COUNT || macro_depth >= MACRO_PHRASE_DEPTH) {
+      return 0xFF;  // Corrupt reference - treated as unknown opcode
+    }
+    start = MACRO_DICT_OFFSETS[b];
+    macro_phrase[macro_depth] = MACRO_DICT + start;
+    macro_phrase_len[macro_depth] = (uint8_t)(MACRO_DICT_OFFSETS[b + 1] - start);
+    macro_depth++;
+#else
+    return 0xFF;  // Empty dictionary - every reference is corrupt
+#endif
+  }
+}
+
+// Replace the macro's modifiers. Bits another input already holds are left
+// to that input, so the macro never clears them.
+static void macro_setMods(uint8_t mods) {
+  Keyboard_removeModifiers(macro_mods);
+  macro_mods = mods & ~Keyboard_getModifiers();
+  Keyboard_addModifiers(macro_mods);
+}
+
+// Release only what the macro pressed; keys held by other inputs stay down
+static void macro_stop(void) {
+  Keyboard_removeModifiers(macro_mods);
+  Keyboard_releaseRaw(macro_key);  // Also sends the modifier change
+  macro_mods = 0;
+  macro_key = 0;
+  macro_ptr = 0;
+  macro_depth = 0;
+}
+
+// ===================================================================================
+// Start Macro
+// ===================================================================================
+void Macro_start(uint8_t index) {
+  if(index >= MACRO_COUNT) return;
+
+  if(macro_ptr) macro_stop();  // Restart: drop what the old run held
+  macro_ptr = MACRO_STREAM + MACRO_OFFSETS[index];
+  macro_depth = 0;
+  macro_key = 0;
+  macro_wait = 0;
+}
+
+uint8_t Macro_isPlaying(void) {
+  return macro_ptr != 0;
+}
+
+// ===================================================================================
+// Advance Player
+// ===================================================================================
+// Each call sends at most one keyboard report (a key-down or a key-up), so a
+// long macro never blocks the main loop.
+void Macro_task(void) {
+  uint8_t op;
+
+  if(!macro_ptr) return;
+
+  // Second half of a TAP: release the key, keep the modifiers
+  if(macro_key) {
+    Keyboard_releaseRaw(macro_key);
+    macro_key = 0;
+    return;
+  }
+
+  if(macro_wait) {
+    if((uint16_t)((uint16_t)millis() - macro_wait_start) < macro_wait) return;
+    macro_wait = 0;
+  }
+
+  for(;;) {
+    op = macro_fetch();
+
+    if(op < 0x80) {
+      if(op == MACRO_OP_END) {
+        macro_stop();
+        return;
+      }
+      break;  // TAP
+    }
+
+    if(op == MACRO_OP_MODS) {
+      macro_setMods(macro_raw());  // Sent with the next TAP
+    } else if(op == MACRO_OP_WAIT) {
+      macro_wait = macro_raw();
+      macro_wait_start = (uint16_t)millis();
+      return;
+    } else if(op == MACRO_OP_USAGE) {
+      op = macro_raw();
+      break;  // TAP of an extended usage
+    } else {
+      // Unknown opcode - stream is corrupt, stop safely
+      macro_stop();
+      return;
+    }
+  }
+
+  Keyboard_pressRaw(op);
+  macro_key = op;
+}
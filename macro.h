@@ -0,0 +1,46 @@
+// ===================================================================================
+// Precompiled Macro Player for CH552G Keyboard v2.0
+// ===================================================================================
+//
+// Replays (modifier, usage) streams compiled on the host by
+// tools/macro_compile.py for a chosen OS keyboard layout. The firmware never
+// translates characters itself - it only presses the HID usages it is given.
+//
+// Stream format (one macro, terminated by MACRO_OP_END):
+//   0x00        END    - release everything, macro finished
+//   0x01-0x7F   TAP    - press and release usage with the current modifiers
+//   0x80-0xEF   PHRASE - expand dictionary phrase (byte - 0x80) in place
+//   0xF0 mm     MODS   - set modifier byte for all following taps
+//   0xF1 nn     WAIT   - pause nn milliseconds
+//   0xF2 uu     USAGE  - tap usage uu >= 0x80
+//
+// Modifier state is run-length encoded: consecutive characters that need the
+// same modifiers share one MODS op.
+// The player only sets and clears the modifier bits and keys it pressed
+// itself, so inputs held during playback (e.g. a push-to-talk hold) stay down.
+//
+// Streams are stored compressed: recurring op runs live once in a phrase
+// dictionary (MACRO_DICT) and are referenced by a single PHRASE byte.
+// Phrases contain whole ops and may nest up to MACRO_PHRASE_DEPTH levels, so
+// the decoder only needs a source pointer plus a small phrase stack and does
+// a bounded amount of work per byte.
+//
+// Action usage: type ACTION_MACRO, primary = macro index.
+// ===================================================================================
+
+#pragma once
+#include <stdint.h>
+
+#define MACRO_OP_END          0x00
+#define MACRO_OP_PHRASE_FIRST 0x80
+#define MACRO_OP_PHRASE_LAST  0xEF
+#define MACRO_OP_MODS         0xF0
+#define MACRO_OP_WAIT         0xF1
+#define MACRO_OP_USAGE        0xF2
+
+#define MACRO_PHRASE_DEPTH    3     // Must match MAX_PHRASE_DEPTH in the compiler
+
+// Public Functions
+void Macro_start(uint8_t index);     // Start playing macro (ignored if out of range)
+void Macro_task(void);               // Emit at most one report; call every loop
+uint8_t Macro_isPlaying(void);       // Non-zero while a macro is running
@@ -0,0 +1,27 @@
+// Generated by tools/macro_compile.py from macros.txt (layout: us) - do not edit
+//
+//   0: signature         20 ->  20 bytes  Best regards,{ENTER}{ENTER}
+
+#pragma once
+#include <stdint.h>
+
+#define MACRO_COUNT         1
+#define MACRO_PHRASE_COUNT  0
+
+static __code const uint16_t MACRO_OFFSETS[1] = {
+    0
+};
+
+static __code const uint8_t MACRO_STREAM[20] = {
+    0xF0, 0x02, 0x05, 0xF0, 0x00, 0x08, 0x16, 0x17, 0x2C, 0x15, 0x08, 0x0A,
+    0x04, 0x15, 0x07, 0x16, 0x36, 0x28, 0x28, 0x00,
+};
+
+// Phrase n = MACRO_DICT[MACRO_DICT_OFFSETS[n] .. MACRO_DICT_OFFSETS[n + 1])
+static __code const uint16_t MACRO_DICT_OFFSETS[1] = {
+    0
+};
+
+static __code const uint8_t MACRO_DICT[1] = {
+    0x00,
+};
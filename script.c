@@ -0,0 +1,153 @@
+// ===================================================================================
+// Bytecode Script VM Implementation for CH552G Keyboard v2.0
+// ===================================================================================
+
+#include <Arduino.h>
+#include "src/usb/userUsbHidKeyboardMouse/USBHIDKeyboardMouse.h"
+#include "script.h"
+#include "script_data.h"  // Generated by tools/script_compile.py
+
+// VM state
+static __code const uint8_t *script_ip = 0;  // Next instruction (0 = idle)
+static uint8_t script_key = 0;               // TAP usage to release next step
+static uint8_t script_mods = 0;              // Modifier bits the script set itself
+static uint8_t script_keys[SCRIPT_KEYS];     // Usage held in each key slot (0 = free)
+static uint16_t script_wait = 0;             // Remaining WAIT duration (ms)
+static uint16_t script_wait_start = 0;       // millis() when WAIT began
+
+// REPEAT stack (innermost loop on top)
+static __code const uint8_t *script_loop[SCRIPT_REPEAT_DEPTH];
+static uint8_t script_count[SCRIPT_REPEAT_DEPTH];
+static uint8_t script_depth = 0;
+
+// Replace the script's modifiers. Bits another input already holds are left
+// to that input, as for macros.
+static void script_setMods(uint8_t mods) {
+  Keyboard_removeModifiers(script_mods);
+  script_mods = mods & ~Keyboard_getModifiers();
+  Keyboard_addModifiers(script_mods);
+}
+
+// Release only what the script pressed, in one report
+static void script_release(void) {
+  uint8_t i;
+  Keyboard_removeModifiers(script_mods);
+  for(i = 0; i < SCRIPT_KEYS; i++) {
+    if(script_keys[i]) Keyboard_removeRaw(script_keys[i]);
+    script_keys[i] = 0;
+  }
+  Keyboard_releaseRaw(script_key);  // Also sends the changes above
+  script_mods = 0;
+  script_key = 0;
+}
+
+// ===================================================================================
+// Start / Stop
+// ===================================================================================
+void Script_start(uint8_t index) {
+  if(index >= SCRIPT_COUNT) return;
+
+  if(script_ip) script_release();  // Restart: drop what the old run held
+  script_ip = SCRIPT_CODE + SCRIPT_OFFSETS[index];
+  script_wait = 0;
+  script_depth = 0;
+}
+
+void Script_stop(void) {
+  if(!script_ip) return;
+  script_release();
+  script_ip = 0;
+}
+
+uint8_t Script_isReady(void) {
+  if(!script_ip) return 0;
+  return !script_wait ||
+         (uint16_t)((uint16_t)millis() - script_wait_start) >= script_wait;
+}
+
+// ===================================================================================
+// Run One Tick
+// ===================================================================================
+uint8_t Script_task(void) {
+  __code const uint8_t *ip;
+  uint8_t op, a, b;
+  uint8_t steps;
+
+  if(!Script_isReady()) return SCRIPT_NO_SLOT;
+  script_wait = 0;
+
+  // Second half of a TAP
+  if(script_key) {
+    if(!USB_EP1_ready()) return SCRIPT_NO_SLOT;
+    Keyboard_releaseRaw(script_key);
+    script_key = 0;
+    return SCRIPT_NO_SLOT;
+  }
+
+  for(steps = SCRIPT_STEPS_PER_TICK; steps; steps--) {
+    ip = script_ip;
+    op = ip[0];
+    a = ip[1];
+    b = ip[2];
+
+    // Instructions that send a report (END releases the script's keys) run
+    // only when EP1 is free
+    if(op <= SCRIPT_OP_UP && !USB_EP1_ready()) return SCRIPT_NO_SLOT;
+    script_ip = ip + SCRIPT_OP_SIZE;
+
+    switch(op) {
+      case SCRIPT_OP_TAP:
+        Keyboard_pressRaw(a);
+        script_key = a;
+        return SCRIPT_NO_SLOT;
+      case SCRIPT_OP_DOWN:
+        // b = key slot from the compiler
+        if(b < SCRIPT_KEYS && Keyboard_pressRaw(a)) script_keys[b] = a;
+        return SCRIPT_NO_SLOT;
+      case SCRIPT_OP_UP:
+        if(b < SCRIPT_KEYS) script_keys[b] = 0;
+        Keyboard_releaseRaw(a);
+        return SCRIPT_NO_SLOT;
+      case SCRIPT_OP_MODS:
+        script_setMods(a);  // Sent with the next key report
+        break;
+      case SCRIPT_OP_WAIT:
+        script_wait = a | ((uint16_t)b << 8);
+        script_wait_start = (uint16_t)millis();
+        if(script_wait) return SCRIPT_NO_SLOT;
+        break;
+      case SCRIPT_OP_REPEAT:
+        if(script_depth < SCRIPT_REPEAT_DEPTH) {
+          script_loop[script_depth] = script_ip;
+          script_count[script_depth] = a;
+          script_depth++;
+        }
+        break;
+      case SCRIPT_OP_NEXT:
+        if(script_depth) {
+          if(--script_count[script_depth - 1]) {
+            script_ip = script_loop[script_depth - 1];
+          } else {
+            script_depth--;
+          }
+        }
+        break;
+      case SCRIPT_OP_JUMP:
+        script_ip = SCRIPT_CODE + (a | ((uint16_t)b << 8));
+        break;
+      case SCRIPT_OP_SKIPLED:
+        if(((Keyboard_getLEDStatus() & a) != 0) == b) {
+          script_ip += SCRIPT_OP_SIZE;
+        }
+        break;
+      case SCRIPT_OP_SLOT:
+        return a;
+      default:
+        // END, or an unknown opcode - stop safely (sends the release)
+        script_release();
+        script_ip = 0;
+        return SCRIPT_NO_SLOT;
+    }
+  }
+  return SCRIPT_NO_SLOT;
+}
@@ -0,0 +1,65 @@
+// ===================================================================================
+// Bytecode Script VM for CH552G Keyboard v2.0
+// ===================================================================================
+//
+// Runs scripts compiled on the host by tools/script_compile.py (script_data.h,
+// code flash). Scripts add what fixed actions and macros lack: held keys,
+// loops, waits, branches on the host's keyboard LEDs and slot switches.
+//
+// Every instruction is 3 bytes: opcode, a, b.
+//   0x00 END                    release the script's keys, script finished
+//   0x01 TAP      usage         press usage, release it on the next step
+//   0x02 DOWN     usage slot    press usage, held in key slot (< SCRIPT_KEYS)
+//   0x03 UP       usage slot    release usage and free its slot (0xFF: none)
+//   0x04 MODS     mods          modifier byte for the following key reports
+//   0x05 WAIT     lo hi         pause (lo | hi << 8) ms
+//   0x06 REPEAT   count         run up to the matching NEXT count times
+//   0x07 NEXT                   end of the innermost REPEAT body
+//   0x08 JUMP     lo hi         continue at byte offset (lo | hi << 8)
+//   0x09 SKIPLED  mask state    skip the next instruction if any LED in mask
+//                               is on (state 1) / all are off (state 0)
+//   0x0A SLOT     slot          make slot active (RAM only, not saved)
+//
+// Script_task() runs at most SCRIPT_STEPS_PER_TICK instructions and returns
+// after the first one that sends a report, so an endless loop never blocks
+// loop(). Report instructions wait until EP1 is free instead of blocking in
+// USB_EP1_send(). Every instruction does a fixed amount of work: the same
+// 3-byte fetch, a switch on the opcode and no loops. The compiler gives each
+// key held with DOWN a slot, so DOWN and UP index the held keys directly.
+//
+// The VM releases only what it pressed: the modifier bits it set and the
+// usages in its key slots. Keys and modifiers of other inputs stay down.
+// Releasing them (END, Script_stop) goes over all SCRIPT_KEYS slots once and
+// sends one report.
+//
+// Action usage: type ACTION_SCRIPT, primary = script index. With the hold
+// flag, releasing the input stops the script.
+// ===================================================================================
+
+#pragma once
+#include <stdint.h>
+
+#define SCRIPT_OP_END         0x00
+#define SCRIPT_OP_TAP         0x01
+#define SCRIPT_OP_DOWN        0x02
+#define SCRIPT_OP_UP          0x03
+#define SCRIPT_OP_MODS        0x04
+#define SCRIPT_OP_WAIT        0x05
+#define SCRIPT_OP_REPEAT      0x06
+#define SCRIPT_OP_NEXT        0x07
+#define SCRIPT_OP_JUMP        0x08
+#define SCRIPT_OP_SKIPLED     0x09
+#define SCRIPT_OP_SLOT        0x0A
+
+#define SCRIPT_OP_SIZE        3
+#define SCRIPT_REPEAT_DEPTH   2     // Must match REPEAT_DEPTH in the compiler
+#define SCRIPT_STEPS_PER_TICK 8     // Instruction budget per Script_task() call
+#define SCRIPT_KEYS           6     // Key slots for DOWN (HELD_KEYS in the compiler)
+
+#define SCRIPT_NO_SLOT        0xFF  // Script_task(): no slot switch requested
+
+// Public Functions
+void Script_start(uint8_t index);    // Start script (ignored if out of range)
+void Script_stop(void);              // Release its own keys and stop
+uint8_t Script_task(void);           // Run one tick; returns a slot to switch to
+uint8_t Script_isReady(void);        // Non-zero while running and not waiting
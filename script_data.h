@@ -0,0 +1,20 @@
+// Generated by tools/script_compile.py from scripts.txt - do not edit
+//
+//   0: shout              9 instructions
+//   1: pagedown_repeat    4 instructions
+
+#pragma once
+#include <stdint.h>
+
+#define SCRIPT_COUNT  2
+
+static __code const uint16_t SCRIPT_OFFSETS[2] = {
+    0, 27
+};
+
+static __code const uint8_t SCRIPT_CODE[39] = {
+    0x09, 0x02, 0x01, 0x08, 0x09, 0x00, 0x01, 0x39, 0x00, 0x04, 0x02, 0x00,
+    0x06, 0x03, 0x00, 0x01, 0x04, 0x00, 0x07, 0x00, 0x00, 0x04, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x4E, 0x00, 0x05, 0x50, 0x00, 0x08, 0x1B, 0x00,
+    0x00, 0x00, 0x00,
+};
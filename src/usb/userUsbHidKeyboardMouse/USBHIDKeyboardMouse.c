@@ -6,6 +6,7 @@
 #include "include/ch5xx_usb.h"
 #include "USBconstant.h"
 #include "USBhandler.h"
+#include "USBcopy.h"
 // clang-format on
 
 // clang-format off
@@ -15,11 +16,36 @@ extern __xdata __at (EP1_ADDR) uint8_t Ep1Buffer[];
 
 volatile __xdata uint8_t UpPoint1_Busy =
     0; // Flag of whether upload pointer is busy
-
-__xdata uint8_t HIDKey[8] = {0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0};
-__xdata uint8_t HIDMouse[4] = {0x0, 0x0, 0x0, 0x0};
-__xdata uint8_t HIDConsumer[8] = {0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0}; // 4x 16-bit consumer codes (matches REPORT_COUNT=4)
-
+__xdata uint16_t USB_EP1_drops = 0; // Reports given up on (saturating)
+
+// Report buffers, sized by tools/usb_descgen.py for the selected features
+__xdata uint8_t HIDKey[HID_KEYBOARD_INPUT_BYTES];  // Modifiers + 6-key array or NKRO bitmap
+__xdata uint8_t HIDMouse[HID_MOUSE_INPUT_BYTES];
+__xdata uint8_t HIDConsumer[HID_CONSUMER_INPUT_BYTES]; // 4x 16-bit consumer codes
+__xdata uint8_t HIDKeyLEDs = 0; // Last keyboard output report (Num, Caps, Scroll ...)
+
+#if USB_HID_HIRES_SCROLL
+__xdata uint8_t HIDScrollMultiplier = 0; // Resolution Multiplier set by the host
+#endif
+
+#if USB_HID_HOST_EVENTS
+// Slot, input, edge, sequence (the host sees a gap when events were dropped)
+__xdata uint8_t HIDHostEvent[HID_HOST_EVENT_INPUT_BYTES];
+#endif
+
+// Press fast path (FAST_KEY in the sketch): HIDKeyStaged is the current key
+// report plus one prepared key. It is rebuilt whenever HIDKey is sent, so an
+// edge interrupt only has to copy it into EP1.
+__xdata uint8_t HIDKeyStaged[HID_KEYBOARD_INPUT_BYTES];
+__xdata uint8_t HIDKeyStagedMods = 0;  // Modifier bits the prepared key adds
+__xdata uint8_t HIDKeyStagedUsage = 0; // Usage it adds, 0 = modifiers only
+volatile __data uint8_t USB_EP1_stageArmed = 0; // USB_EP1_stage() may send
+volatile __data uint8_t USB_EP1_staged = 0; // Waiting for the report in flight
+volatile __data uint8_t USB_EP1_stageFired = 0; // Sent, not yet confirmed
+
+static void HIDKey_restage(void);
+
+#ifndef KEYBOARD_NO_ASCIIMAP
 #define SHIFT 0x80
 __code uint8_t _asciimap[128] = {
     0x00, // NUL
@@ -152,12 +178,14 @@ __code uint8_t _asciimap[128] = {
     0x35 | SHIFT, // ~
     0             // DEL
 };
+#endif
 
 typedef void (*pTaskFn)(void);
 
 void delayMicroseconds(uint16_t us);
 
 void USBInit() {
+  USB_initSerial();       // Serial string from the chip ID, before enumeration
   USBDeviceCfg();         // Device mode configuration
   USBDeviceEndPointCfg(); // Endpoint configuration
   USBDeviceIntCfg();      // Interrupt configuration
@@ -166,73 +194,172 @@ void USBInit() {
   UEP2_T_LEN = 0;
 }
 
+// Interrupt context only (the USB and pin interrupts share one priority
+// level, so they never run this concurrently)
+#pragma save
+#pragma nooverlay
+static void USB_EP1_loadStaged(void) {
+  Ep1Buffer[64 + 0] = HID_REPORT_ID_KEYBOARD;
+  USB_copyXdata(Ep1Buffer + 64 + 1, HIDKeyStaged, sizeof(HIDKeyStaged));
+  UEP1_T_LEN = 1 + sizeof(HIDKeyStaged);
+  UpPoint1_Busy = 1;
+  UEP1_CTRL = UEP1_CTRL & ~MASK_UEP_T_RES | UEP_T_RES_ACK;
+}
+#pragma restore
+
 void USB_EP1_IN() {
   UEP1_T_LEN = 0;
   UEP1_CTRL = UEP1_CTRL & ~MASK_UEP_T_RES | UEP_T_RES_NAK; // Default NAK
   UpPoint1_Busy = 0;                                       // Clear busy flag
+  if (USB_EP1_staged) { // Fast path report queued behind the one just sent
+    USB_EP1_staged = 0;
+    USB_EP1_loadStaged();
+  }
+}
+
+void USB_EP1_stage(void) {
+  if (!USB_EP1_stageArmed || UsbConfig == 0) {
+    return;
+  }
+  USB_EP1_stageArmed = 0; // One report per Keyboard_stage()
+  USB_EP1_stageFired = 1; // Later key reports keep the key down
+  if (UpPoint1_Busy) {
+    USB_EP1_staged = 1; // USB_EP1_IN() sends it next
+  } else {
+    USB_EP1_loadStaged();
+  }
 }
 
 void USB_EP1_OUT() {
-  if (U_TOG_OK) // Discard unsynchronized packets
-  {
+  // Discard unsynchronized packets. Output reports carry the Report ID first.
+  if (U_TOG_OK && USB_RX_LEN >= 2 && Ep1Buffer[0] == HID_REPORT_ID_KEYBOARD) {
+    HIDKeyLEDs = Ep1Buffer[1];
+  }
+}
+
+uint8_t USB_EP1_ready(void) { return UsbConfig && !UpPoint1_Busy; }
+
+static uint8_t USB_EP1_dropped(void) {
+  if (USB_EP1_drops != 0xFFFF) {
+    USB_EP1_drops++;
   }
+  return 0;
 }
 
 uint8_t USB_EP1_send(__data uint8_t reportID) {
   if (UsbConfig == 0) {
-    return 0;
+    return USB_EP1_dropped();
   }
 
   __data uint16_t waitWriteCount = 0;
 
   waitWriteCount = 0;
-  while (UpPoint1_Busy) { // wait for 250ms or give up
+  for (;;) { // wait for 250ms or give up
+    // Claim EP1 with interrupts off: USB_EP1_stage() may load it from an
+    // interrupt at any time, and otherwise queues behind this report
+    EA = 0;
+    if (!UpPoint1_Busy) {
+      break;
+    }
+    EA = 1;
     waitWriteCount++;
     delayMicroseconds(5);
     if (waitWriteCount >= 50000)
-      return 0;
+      return USB_EP1_dropped();
   }
+  UpPoint1_Busy = 1; // Interrupts stay off while the buffer is filled
 
-  if (reportID == 1) {
-    Ep1Buffer[64 + 0] = 1;
-    for (__data uint8_t i = 0; i < sizeof(HIDKey); i++) { // load data for
-                                                          // upload
-      Ep1Buffer[64 + 1 + i] = HIDKey[i];
-    }
+  if (reportID == HID_REPORT_ID_KEYBOARD) {
+    Ep1Buffer[64 + 0] = HID_REPORT_ID_KEYBOARD;
+    USB_copyXdata(Ep1Buffer + 64 + 1, HIDKey, sizeof(HIDKey));
     UEP1_T_LEN = 1 + sizeof(HIDKey); // data length
-  } else if (reportID == 2) {
-    Ep1Buffer[64 + 0] = 2;
-    for (__data uint8_t i = 0; i < sizeof(HIDMouse);
-         i++) { // load data for upload
-      Ep1Buffer[64 + 1 + i] = ((uint8_t *)HIDMouse)[i];
+    if (USB_EP1_stageFired) {
+      // The fast key is down on the host but not yet in HIDKey: a report
+      // without it would release and press it again
+      Ep1Buffer[64 + 1] |= HIDKeyStagedMods;
+      if (HIDKeyStagedUsage) {
+        HIDReport_add(Ep1Buffer + 64 + 1, HIDKeyStagedUsage);
+      }
+    } else if (USB_EP1_stageArmed) {
+      HIDKey_restage(); // The prepared key now goes on top of this report
     }
+  } else if (reportID == HID_REPORT_ID_MOUSE) {
+    Ep1Buffer[64 + 0] = HID_REPORT_ID_MOUSE;
+    USB_copyXdata(Ep1Buffer + 64 + 1, HIDMouse, sizeof(HIDMouse));
     UEP1_T_LEN = 1 + sizeof(HIDMouse); // data length
-  } else if (reportID == 3) {
-    Ep1Buffer[64 + 0] = 3;
-    for (__data uint8_t i = 0; i < sizeof(HIDConsumer);
-         i++) { // load data for upload
-      Ep1Buffer[64 + 1 + i] = HIDConsumer[i];
-    }
+  } else if (reportID == HID_REPORT_ID_CONSUMER) {
+    Ep1Buffer[64 + 0] = HID_REPORT_ID_CONSUMER;
+    USB_copyXdata(Ep1Buffer + 64 + 1, HIDConsumer, sizeof(HIDConsumer));
     UEP1_T_LEN = 1 + sizeof(HIDConsumer); // data length
+#if USB_HID_HOST_EVENTS
+  } else if (reportID == HID_REPORT_ID_HOST_EVENT) {
+    Ep1Buffer[64 + 0] = HID_REPORT_ID_HOST_EVENT;
+    USB_copyXdata(Ep1Buffer + 64 + 1, HIDHostEvent, sizeof(HIDHostEvent));
+    UEP1_T_LEN = 1 + sizeof(HIDHostEvent); // data length
+#endif
   } else {
     UEP1_T_LEN = 0;
   }
 
-  UpPoint1_Busy = 1;
   UEP1_CTRL = UEP1_CTRL & ~MASK_UEP_T_RES |
               UEP_T_RES_ACK; // upload data and respond ACK
+  EA = 1;
 
   return 1;
 }
 
-uint8_t Keyboard_press(__data uint8_t k) {
+// Add a non-modifier usage to a key report: one of six array slots, or
+// its bit in the NKRO bitmap. Returns 0 if it does not fit.
+static uint8_t HIDReport_add(__xdata uint8_t *report, __data uint8_t k) {
+#if USB_HID_NKRO
+  if (k >= HID_NKRO_USAGES) {
+    return 0;
+  }
+  report[1 + (k >> 3)] |= 1 << (k & 7);
+  return 1;
+#else
   __data uint8_t i;
+  for (i = 2; i < 8; i++) {
+    if (report[i] == k) {
+      return 1; // already present
+    }
+  }
+  for (i = 2; i < 8; i++) {
+    if (report[i] == 0x00) {
+      report[i] = k;
+      return 1;
+    }
+  }
+  return 0;
+#endif
+}
+
+#define HIDKey_add(k) HIDReport_add(HIDKey, (k))
+
+static void HIDKey_remove(__data uint8_t k) {
+#if USB_HID_NKRO
+  if (k < HID_NKRO_USAGES) {
+    HIDKey[1 + (k >> 3)] &= ~(1 << (k & 7));
+  }
+#else
+  // Check all positions in case the key is present more than once (which it
+  // shouldn't be)
+  for (__data uint8_t i = 2; i < 8; i++) {
+    if (HIDKey[i] == k) {
+      HIDKey[i] = 0x00;
+    }
+  }
+#endif
+}
+
+uint8_t Keyboard_press(__data uint8_t k) {
   if (k >= 136) { // it's a non-printing key (not a modifier)
     k = k - 136;
   } else if (k >= 128) { // it's a modifier key
     HIDKey[0] |= (1 << (k - 128));
     k = 0;
   } else { // it's a printing key
+#ifndef KEYBOARD_NO_ASCIIMAP
     k = _asciimap[k];
     if (!k) {
       // setWriteError();
@@ -243,36 +370,31 @@ uint8_t Keyboard_press(__data uint8_t k) {
       HIDKey[0] |= 0x02; // the left shift modifier
       k &= 0x7F;
     }
+#else
+    if (!k) {
+      return 0;
+    }
+#endif
   }
 
   // Add k to the key report only if it's not already present
   // and if there is an empty slot.
-  if (HIDKey[2] != k && HIDKey[3] != k && HIDKey[4] != k && HIDKey[5] != k &&
-      HIDKey[6] != k && HIDKey[7] != k) {
-
-    for (i = 2; i < 8; i++) {
-      if (HIDKey[i] == 0x00) {
-        HIDKey[i] = k;
-        break;
-      }
-    }
-    if (i == 8) {
-      // setWriteError();
-      return 0;
-    }
+  if (k && !HIDKey_add(k)) {
+    // setWriteError();
+    return 0;
   }
-  USB_EP1_send(1);
+  USB_EP1_send(HID_REPORT_ID_KEYBOARD);
   return 1;
 }
 
 uint8_t Keyboard_release(__data uint8_t k) {
-  __data uint8_t i;
   if (k >= 136) { // it's a non-printing key (not a modifier)
     k = k - 136;
   } else if (k >= 128) { // it's a modifier key
     HIDKey[0] &= ~(1 << (k - 128));
     k = 0;
   } else { // it's a printing key
+#ifndef KEYBOARD_NO_ASCIIMAP
     k = _asciimap[k];
     if (!k) {
       return 0;
@@ -282,18 +404,19 @@ uint8_t Keyboard_release(__data uint8_t k) {
       HIDKey[0] &= ~(0x02); // the left shift modifier
       k &= 0x7F;
     }
+#else
+    if (!k) {
+      return 0;
+    }
+#endif
   }
 
   // Test the key report to see if k is present.  Clear it if it exists.
-  // Check all positions in case the key is present more than once (which it
-  // shouldn't be)
-  for (i = 2; i < 8; i++) {
-    if (0 != k && HIDKey[i] == k) {
-      HIDKey[i] = 0x00;
-    }
+  if (k) {
+    HIDKey_remove(k);
   }
 
-  USB_EP1_send(1);
+  USB_EP1_send(HID_REPORT_ID_KEYBOARD);
   return 1;
 }
 
@@ -301,7 +424,7 @@ void Keyboard_releaseAll(void) {
   for (__data uint8_t i = 0; i < sizeof(HIDKey); i++) { // load data for upload
     HIDKey[i] = 0;
   }
-  USB_EP1_send(1);
+  USB_EP1_send(HID_REPORT_ID_KEYBOARD);
 }
 
 uint8_t Keyboard_write(__data uint8_t c) {
@@ -311,43 +434,195 @@ uint8_t Keyboard_write(__data uint8_t c) {
             // returns 1
 }
 
+// Main loop only, with interrupts off so USB_EP1_stage() never sends a
+// half-built report
+static void HIDKey_restage(void) {
+  USB_copyXdata(HIDKeyStaged, HIDKey, sizeof(HIDKey));
+  HIDKeyStaged[0] |= HIDKeyStagedMods;
+  if (HIDKeyStagedUsage) {
+    HIDReport_add(HIDKeyStaged, HIDKeyStagedUsage);
+  }
+}
+
+void Keyboard_unstage(void) {
+  EA = 0;
+  USB_EP1_stageArmed = 0;
+  USB_EP1_staged = 0;
+  USB_EP1_stageFired = 0;
+  EA = 1;
+}
+
+void Keyboard_stage(__data uint8_t modifiers, __data uint8_t k) {
+  Keyboard_unstage();
+  if (k >= 136) { // non-printing key
+    k = k - 136;
+  } else if (k >= 128) { // modifier key
+    modifiers |= 1 << (k - 128);
+    k = 0;
+  } else { // printing key
+#ifndef KEYBOARD_NO_ASCIIMAP
+    k = _asciimap[k];
+    if (k & 0x80) { // reached with shift
+      modifiers |= 0x02;
+      k &= 0x7F;
+    }
+#endif
+  }
+  HIDKeyStagedMods = modifiers;
+  HIDKeyStagedUsage = k;
+  EA = 0;
+  HIDKey_restage();
+  EA = 1;
+  USB_EP1_stageArmed = 1;
+}
+
+void Keyboard_confirm(void) {
+  // Make the staged key part of HIDKey; the report sent repeats the staged
+  // one, so the host sees no change
+  USB_EP1_stageArmed = 0;
+  HIDKey[0] |= HIDKeyStagedMods;
+  if (HIDKeyStagedUsage) {
+    HIDKey_add(HIDKeyStagedUsage);
+  }
+  USB_EP1_stageFired = 0; // HIDKey carries it from now on
+  USB_EP1_send(HID_REPORT_ID_KEYBOARD);
+}
+
+void Keyboard_retract(void) {
+  // Drop the staged report if it is still queued, otherwise take it back by
+  // sending HIDKey, which never contained the staged key (reports sent since
+  // the edge added it; Keyboard_unstage() stops that)
+  Keyboard_unstage();
+  USB_EP1_send(HID_REPORT_ID_KEYBOARD);
+}
+
+// Raw usage interface for precompiled (layout-aware) streams: no ASCII
+// translation, no implicit shift.
+uint8_t Keyboard_pressRaw(__data uint8_t usage) {
+  if (!HIDKey_add(usage)) {
+    return 0;
+  }
+  USB_EP1_send(HID_REPORT_ID_KEYBOARD);
+  return 1;
+}
+
+uint8_t Keyboard_releaseRaw(__data uint8_t usage) {
+  if (usage) { // 0 only sends the report (e.g. after removing modifiers)
+    HIDKey_remove(usage);
+  }
+  USB_EP1_send(HID_REPORT_ID_KEYBOARD);
+  return 1;
+}
+
+void Keyboard_removeRaw(__data uint8_t usage) {
+  HIDKey_remove(usage); // sent with the next report
+}
+
+void Keyboard_addModifiers(__data uint8_t modifiers) {
+  HIDKey[0] |= modifiers; // sent with the next report
+}
+
+void Keyboard_removeModifiers(__data uint8_t modifiers) {
+  HIDKey[0] &= ~modifiers; // sent with the next report
+}
+
+uint8_t Keyboard_getModifiers(void) {
+  return HIDKey[0];
+}
+
 uint8_t Keyboard_getLEDStatus() {
-  return Ep1Buffer[0]; // The only info we gets
+  return HIDKeyLEDs;
 }
 
+// Mouse state: buttons stay held until released, motion and wheel add up
+// until a report takes them. The functions below only change the state; a
+// report carries all of it (at most +-127 per axis, the rest stays queued).
+static __xdata uint8_t mouseButtons = 0;
+static __xdata uint8_t mouseButtonsSent = 0;
+static __xdata int16_t mouseX = 0;
+static __xdata int16_t mouseY = 0;
+static __xdata int16_t mouseWheel = 0;
+
 uint8_t Mouse_press(__data uint8_t k) {
-  memset(HIDMouse, 0, sizeof(HIDMouse));
-  HIDMouse[0] |= k;
-  USB_EP1_send(2);
+  mouseButtons |= k;
   return 1;
 }
 
 uint8_t Mouse_release(__data uint8_t k) {
-  memset(HIDMouse, 0, sizeof(HIDMouse));
-  HIDMouse[0] &= ~k;
-  USB_EP1_send(2);
+  mouseButtons &= ~k;
   return 1;
 }
 
-uint8_t Mouse_click(__data uint8_t k) {
-  Mouse_press(k);
-  delayMicroseconds(10000);
-  Mouse_release(k);
+uint8_t Mouse_move(__data int8_t x, __xdata int8_t y) {
+  mouseX += x;
+  mouseY += y;
   return 1;
 }
 
-uint8_t Mouse_move(__data int8_t x, __xdata int8_t y) {
-  memset(HIDMouse, 0, sizeof(HIDMouse));
-  HIDMouse[1] = x;
-  HIDMouse[2] = y;
-  USB_EP1_send(2);
+uint8_t Mouse_scroll(__data int8_t tilt) {
+#if USB_HID_HIRES_SCROLL
+  // With the multiplier enabled the host counts 1/HID_SCROLL_RESOLUTION
+  // steps; keep one call = one step
+  if (HIDScrollMultiplier) {
+    mouseWheel += (int16_t)tilt * HID_SCROLL_RESOLUTION;
+    return 1;
+  }
+#endif
+  mouseWheel += tilt;
   return 1;
 }
 
-uint8_t Mouse_scroll(__data int8_t tilt) {
-  memset(HIDMouse, 0, sizeof(HIDMouse));
-  HIDMouse[3] = tilt;
-  USB_EP1_send(2);
+uint8_t Mouse_pending(void) {
+  return mouseButtons != mouseButtonsSent || mouseX || mouseY || mouseWheel;
+}
+
+// Up to +-127 of an accumulated axis for the next report
+static int8_t Mouse_take(__xdata int16_t *axis) {
+  __data int16_t v = *axis;
+  if (v > 127) {
+    v = 127;
+  } else if (v < -127) {
+    v = -127;
+  }
+  *axis -= v;
+  return (int8_t)v;
+}
+
+static uint8_t Mouse_report(void) {
+  HIDMouse[0] = mouseButtons;
+  HIDMouse[1] = Mouse_take(&mouseX);
+  HIDMouse[2] = Mouse_take(&mouseY);
+  HIDMouse[3] = Mouse_take(&mouseWheel);
+  if (!USB_EP1_send(HID_REPORT_ID_MOUSE)) {
+    return 0; // Buttons stay pending, the HID task sends them again
+  }
+  mouseButtonsSent = HIDMouse[0];
+  return 1;
+}
+
+uint8_t Mouse_flush(void) {
+  if (!Mouse_pending() || !USB_EP1_ready()) {
+    return 0;
+  }
+  Mouse_report();
+  return 1;
+}
+
+void Mouse_send(void) {
+  while (Mouse_pending()) {
+    if (!Mouse_report()) {
+      mouseX = mouseY = mouseWheel = 0; // Dropped: nobody to send the rest to
+      return;
+    }
+  }
+}
+
+uint8_t Mouse_click(__data uint8_t k) {
+  Mouse_press(k);
+  Mouse_send();
+  delayMicroseconds(10000);
+  Mouse_release(k);
+  Mouse_send();
   return 1;
 }
 
@@ -369,7 +644,7 @@ uint8_t Consumer_press(__data uint16_t key) {
     if((HIDConsumer[i] == 0) && (HIDConsumer[i+1] == 0)) {  // Empty slot?
       HIDConsumer[i]   = key & 0xFF;        // Low byte
       HIDConsumer[i+1] = (key >> 8) & 0xFF; // High byte
-      USB_EP1_send(3);                      // Send report
+      USB_EP1_send(HID_REPORT_ID_CONSUMER); // Send report
       return 1;
     }
   }
@@ -388,7 +663,7 @@ uint8_t Consumer_release(__data uint16_t key) {
       break;
     }
   }
-  USB_EP1_send(3);
+  USB_EP1_send(HID_REPORT_ID_CONSUMER);
   return 1;
 }
 
@@ -399,3 +674,14 @@ uint8_t Consumer_write(__data uint16_t key) {
   Consumer_release(key);
   return 1;
 }
+
+#if USB_HID_HOST_EVENTS
+uint8_t HostEvent_send(__data uint8_t slot, __data uint8_t input,
+                       __data uint8_t edge) {
+  HIDHostEvent[0] = slot;
+  HIDHostEvent[1] = input;
+  HIDHostEvent[2] = edge;
+  HIDHostEvent[3]++; // Counts every event, sent or not
+  return USB_EP1_send(HID_REPORT_ID_HOST_EVENT);
+}
+#endif
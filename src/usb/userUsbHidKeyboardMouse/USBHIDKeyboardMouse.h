@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include "include/ch5xx.h"
 #include "include/ch5xx_usb.h"
+#include "usb_features.h" // USB_HID_* feature switches (tools/usb_descgen.py)
 // clang-format on
 
 #define KEY_LEFT_CTRL 0x80
@@ -66,6 +67,11 @@
 #define MEDIA_STOP 0x00B7
 #define MEDIA_EJECT 0x00B8
 
+// Define to drop the 128-byte US-layout _asciimap from flash. Keyboard_press()
+// and Keyboard_release() then take raw HID usages below 0x80 instead of ASCII,
+// so every stored keyboard action must hold usages (see tools/macro_compile.py).
+// #define KEYBOARD_NO_ASCIIMAP
+
 enum MOUSE_BUTTON {
   MOUSE_LEFT = 1,
   MOUSE_RIGHT = 2,
@@ -77,6 +83,8 @@ extern "C" {
 #endif
 
 void USBInit(void);
+uint8_t USB_EP1_ready(void); // Non-zero when a report can be sent without waiting
+extern __xdata uint16_t USB_EP1_drops; // Reports not sent (unconfigured or timeout)
 
 uint8_t Keyboard_press(__data uint8_t k);
 uint8_t Keyboard_release(__data uint8_t k);
@@ -84,18 +92,54 @@ void Keyboard_releaseAll(void);
 
 uint8_t Keyboard_write(__data uint8_t c);
 
-uint8_t Keyboard_getLEDStatus();
+uint8_t Keyboard_pressRaw(__data uint8_t usage);
+uint8_t Keyboard_releaseRaw(__data uint8_t usage);
+// Players (macros, scripts) change only the modifier bits and usages they
+// own, so keys held by other inputs stay down. Sent with the next report.
+void Keyboard_removeRaw(__data uint8_t usage);
+void Keyboard_addModifiers(__data uint8_t modifiers);
+void Keyboard_removeModifiers(__data uint8_t modifiers);
+uint8_t Keyboard_getModifiers(void);
+
+uint8_t Keyboard_getLEDStatus(); // Host LEDs: 0x01 Num, 0x02 Caps, 0x04 Scroll
+
+// Press fast path: Keyboard_stage() prepares the report for pressing k (as
+// for Keyboard_press, plus the given modifier bits) on top of the current
+// one. USB_EP1_stage(), called from an interrupt, sends it at once or right
+// after the report in flight. The main loop then either confirms it (the key
+// becomes part of the normal report) or retracts it.
+void Keyboard_stage(__data uint8_t modifiers, __data uint8_t k);
+void Keyboard_unstage(void); // Disarm; drop the report if not yet sent
+// Between the edge and Keyboard_confirm()/Keyboard_retract() every key
+// report sent carries the staged key, so it stays down on the host
+void Keyboard_confirm(void);
+void Keyboard_retract(void);
+void USB_EP1_stage(void); // Interrupt context only
 
+// Mouse state persists: buttons stay held until released, motion and wheel
+// accumulate. press/release/move/scroll only update it. Mouse_flush() sends
+// one report with everything pending if EP1 is free (call once per frame);
+// Mouse_send() waits for EP1 and sends until nothing is pending.
 uint8_t Mouse_press(__data uint8_t k);
 uint8_t Mouse_release(__data uint8_t k);
-uint8_t Mouse_click(__data uint8_t k);
+uint8_t Mouse_click(__data uint8_t k); // Sends press and release itself
 uint8_t Mouse_move(__data int8_t x, __xdata int8_t y);
 uint8_t Mouse_scroll(__data int8_t tilt);
+uint8_t Mouse_pending(void);
+uint8_t Mouse_flush(void); // Non-zero if a report went out
+void Mouse_send(void);
 
 uint8_t Consumer_press(__data uint16_t key);
 uint8_t Consumer_release(__data uint16_t key);
 uint8_t Consumer_write(__data uint16_t key);
 
+#if USB_HID_HOST_EVENTS
+// Vendor event report for a host-side executor: input of slot changed to
+// edge (1 = press, 0 = release). Returns 0 if the report was dropped.
+uint8_t HostEvent_send(__data uint8_t slot, __data uint8_t input,
+                       __data uint8_t edge);
+#endif
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -1,5 +1,8 @@
 #include "USBconstant.h"
 
+// Report and string descriptors for the selected feature set
+#include "usb_descriptors.h" // Generated by tools/usb_descgen.py
+
 // Device descriptor
 __code USB_Descriptor_Device_t DeviceDescriptor = {
     .Header = {.Size = sizeof(USB_Descriptor_Device_t), .Type = DTYPE_Device},
@@ -33,7 +36,11 @@ __code USB_Descriptor_Configuration_t ConfigurationDescriptor = {
                           .Type = DTYPE_Configuration},
 
                .TotalConfigurationSize = sizeof(USB_Descriptor_Configuration_t),
+#ifdef USB_CONFIG_ENDPOINT
+               .TotalInterfaces = 2,
+#else
                .TotalInterfaces = 1,
+#endif
 
                .ConfigurationNumber = 1,
                .ConfigurationStrIndex = NO_DESCRIPTOR,
@@ -74,7 +81,7 @@ __code USB_Descriptor_Configuration_t ConfigurationDescriptor = {
                                  (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC |
                                   ENDPOINT_USAGE_DATA),
                              .EndpointSize = KEYBOARD_MOUSE_EPSIZE,
-                             .PollingIntervalMS = 10},
+                             .PollingIntervalMS = KEYBOARD_MOUSE_INTERVAL},
 
     .HID_ReportOUTEndpoint = {.Header = {.Size =
                                              sizeof(USB_Descriptor_Endpoint_t),
@@ -86,135 +93,61 @@ __code USB_Descriptor_Configuration_t ConfigurationDescriptor = {
                                    ENDPOINT_USAGE_DATA),
                               .EndpointSize = KEYBOARD_MOUSE_EPSIZE,
                               .PollingIntervalMS = 10},
-};
 
-__code uint8_t ReportDescriptor[] = {
-    0x05, 0x01,       // USAGE_PAGE (Generic Desktop)
-    0x09, 0x06,       // USAGE (Keyboard)
-    0xa1, 0x01,       // COLLECTION (Application)
-    0x85, 0x01,       //   REPORT_ID (1)
-    0x05, 0x07,       //   USAGE_PAGE (Keyboard)
-    0x19, 0xe0,       //   USAGE_MINIMUM (Keyboard LeftControl)
-    0x29, 0xe7,       //   USAGE_MAXIMUM (Keyboard Right GUI)
-    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
-    0x25, 0x01,       //   LOGICAL_MAXIMUM (1)
-    0x95, 0x08,       //   REPORT_COUNT (8)
-    0x75, 0x01,       //   REPORT_SIZE (1)
-    0x81, 0x02,       //   INPUT (Data,Var,Abs)
-    0x95, 0x01,       //   REPORT_COUNT (1)
-    0x75, 0x08,       //   REPORT_SIZE (8)
-    0x81, 0x03,       //   INPUT (Cnst,Var,Abs)
-    0x95, 0x06,       //   REPORT_COUNT (6)
-    0x75, 0x08,       //   REPORT_SIZE (8)
-    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
-    0x26, 0xff, 0x00, //   LOGICAL_MAXIMUM (255)
-    0x05, 0x07,       //   USAGE_PAGE (Keyboard)
-    0x19, 0x00,       //   USAGE_MINIMUM (Reserved (no event indicated))
-    0x29, 0xe7,       //   USAGE_MAXIMUM (Keyboard Right GUI)
-    0x81, 0x00,       //   INPUT (Data,Ary,Abs)
-    0x05, 0x08,       //   USAGE_PAGE (LEDs)
-    0x19, 0x01,       //   USAGE_MINIMUM (Num Lock)
-    0x29, 0x05,       //   USAGE_MAXIMUM (Kana)
-    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
-    0x25, 0x01,       //   LOGICAL_MAXIMUM (1)
-    0x95, 0x05,       //   REPORT_COUNT (5)
-    0x75, 0x01,       //   REPORT_SIZE (1)
-    0x91, 0x02,       //   OUTPUT (Data,Var,Abs)
-    0x95, 0x01,       //   REPORT_COUNT (1)
-    0x75, 0x03,       //   REPORT_SIZE (3)
-    0x91, 0x03,       //   OUTPUT (Cnst,Var,Abs)
-    0xc0,             // END_COLLECTION
-    0x05, 0x01,       // USAGE_PAGE (Generic Desktop)
-    0x09, 0x02,       // USAGE (Mouse)
-    0xa1, 0x01,       // COLLECTION (Application)
-    0x09, 0x01,       //   USAGE (Pointer)
-    0xa1, 0x00,       //   COLLECTION (Physical)
-    0x85, 0x02,       //   REPORT_ID (2)
-    0x05, 0x09,       //     USAGE_PAGE (Button)
-    0x19, 0x01,       //     USAGE_MINIMUM (Button 1)
-    0x29, 0x03,       //     USAGE_MAXIMUM (Button 3)
-    0x15, 0x00,       //     LOGICAL_MINIMUM (0)
-    0x25, 0x01,       //     LOGICAL_MAXIMUM (1)
-    0x95, 0x03,       //     REPORT_COUNT (3)
-    0x75, 0x01,       //     REPORT_SIZE (1)
-    0x81, 0x02,       //     INPUT (Data,Var,Abs)
-    0x95, 0x01,       //     REPORT_COUNT (1)
-    0x75, 0x05,       //     REPORT_SIZE (5)
-    0x81, 0x03,       //     INPUT (Cnst,Var,Abs)
-    0x05, 0x01,       //     USAGE_PAGE (Generic Desktop)
-    0x09, 0x30,       //     USAGE (X)
-    0x09, 0x31,       //     USAGE (Y)
-    0x09, 0x38,       //     USAGE (Wheel)
-    0x15, 0x81,       //     LOGICAL_MINIMUM (-127)
-    0x25, 0x7f,       //     LOGICAL_MAXIMUM (127)
-    0x75, 0x08,       //     REPORT_SIZE (8)
-    0x95, 0x03,       //     REPORT_COUNT (3)
-    0x81, 0x06,       //     INPUT (Data,Var,Rel)
-    0xc0,             //     END_COLLECTION
-    0xc0,             // END_COLLECTION
-    // Consumer Control (Media Keys) - Report ID 3
-    // Array implementation matching working CH552-Macropad reference
-    0x05, 0x0C,       // USAGE_PAGE (Consumer)
-    0x09, 0x01,       // USAGE (Consumer Control)
-    0xA1, 0x01,       // COLLECTION (Application)
-    0x85, 0x03,       //   REPORT_ID (3)
-    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
-    0x26, 0xFF, 0x03, //   LOGICAL_MAXIMUM (1023)
-    0x19, 0x00,       //   USAGE_MINIMUM (Unassigned)
-    0x2A, 0xFF, 0x03, //   USAGE_MAXIMUM (0x03FF)
-    0x95, 0x04,       //   REPORT_COUNT (4)
-    0x75, 0x10,       //   REPORT_SIZE (16)
-    0x81, 0x00,       //   INPUT (Data,Ary,Abs)
-    0xC0,             // END_COLLECTION
-    // Vendor-Defined Feature Report (Configuration) - Report ID 0xF0
-    0x06, 0x00, 0xFF, // USAGE_PAGE (Vendor Defined 0xFF00)
-    0x09, 0x01,       // USAGE (Vendor Usage 1)
-    0xA1, 0x01,       // COLLECTION (Application)
-    0x85, 0xF0,       //   REPORT_ID (240 / 0xF0)
-    0x09, 0x01,       //   USAGE (Vendor Usage 1)
-    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
-    0x26, 0xFF, 0x00, //   LOGICAL_MAXIMUM (255)
-    0x75, 0x08,       //   REPORT_SIZE (8 bits)
-    0x95, 0x3F,       //   REPORT_COUNT (63 bytes) - Fixed: was 0x40 (64), now 0x3F (63)
-    0xB1, 0x02,       //   FEATURE (Data,Var,Abs)
-    0xC0              // END_COLLECTION
-};
+#ifdef USB_CONFIG_ENDPOINT
+    .Config_Interface = {.Header = {.Size = sizeof(USB_Descriptor_Interface_t),
+                                    .Type = DTYPE_Interface},
 
-// String Descriptors
-__code uint8_t LanguageDescriptor[] = {0x04, 0x03, 0x09,
-                                       0x04}; // Language Descriptor
-__code uint16_t SerialDescriptor[] = {
-    // Serial String Descriptor
-    (((13 + 1) * 2) | (DTYPE_String << 8)),
-    'C',
-    'H',
-    '5',
-    '5',
-    'x',
-    ' ',
-    'k',
-    'b',
-    'd',
-    ' ',
-    'm',
-    'o',
-    's',
-};
-__code uint16_t ProductDescriptor[] = {
-    // Produce String Descriptor
-    (((10 + 1) * 2) | (DTYPE_String << 8)),
-    'C',
-    'H',
-    '5',
-    '5',
-    'x',
-    'd',
-    'u',
-    'i',
-    'n',
-    'o',
-};
-__code uint16_t ManufacturerDescriptor[] = {
-    // SDCC is little endian
-    (((6 + 1) * 2) | (DTYPE_String << 8)), 'D', 'e', 'q', 'i', 'n', 'g',
+                         .InterfaceNumber = 1,
+                         .AlternateSetting = 0x00,
+
+                         .TotalEndpoints = 2,
+
+                         .Class = HID_CSCP_HIDClass,
+                         .SubClass = HID_CSCP_NonBootSubclass,
+                         .Protocol = HID_CSCP_NonBootProtocol,
+
+                         .InterfaceStrIndex = NO_DESCRIPTOR},
+
+    .Config_HID = {.Header = {.Size = sizeof(USB_HID_Descriptor_HID_t),
+                              .Type = HID_DTYPE_HID},
+
+                   .HIDSpec = VERSION_BCD(1, 1, 0),
+                   .CountryCode = 0x00,
+                   .TotalReportDescriptors = 1,
+                   .HIDReportType = HID_DTYPE_Report,
+                   .HIDReportLength = sizeof(ConfigReportDescriptor)},
+
+    .Config_INEndpoint = {.Header = {.Size = sizeof(USB_Descriptor_Endpoint_t),
+                                     .Type = DTYPE_Endpoint},
+
+                          .EndpointAddress = CONFIG_IN_EPADDR,
+                          .Attributes = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC |
+                                         ENDPOINT_USAGE_DATA),
+                          .EndpointSize = CONFIG_EPSIZE,
+                          .PollingIntervalMS = 1},
+
+    .Config_OUTEndpoint = {.Header = {.Size = sizeof(USB_Descriptor_Endpoint_t),
+                                      .Type = DTYPE_Endpoint},
+
+                           .EndpointAddress = CONFIG_OUT_EPADDR,
+                           .Attributes = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC |
+                                          ENDPOINT_USAGE_DATA),
+                           .EndpointSize = CONFIG_EPSIZE,
+                           .PollingIntervalMS = 1},
+#endif
 };
+
+// Serial string from the chip's unique ID, most significant byte first, so
+// every pad enumerates with its own serial (udev ATTRS{serial}, HID_UNIQ)
+void USB_initSerial(void) {
+  __code uint8_t *id = (__code uint8_t *)USB_CHIP_ID_ADDR;
+  uint8_t i, b;
+
+  SerialDescriptor[0] = ((USB_SERIAL_CHARS + 1) * 2) | (DTYPE_String << 8);
+  for (i = 0; i < USB_CHIP_ID_BYTES; i++) {
+    b = id[USB_CHIP_ID_BYTES - 1 - i];
+    SerialDescriptor[1 + 2 * i] = "0123456789ABCDEF"[b >> 4];
+    SerialDescriptor[2 + 2 * i] = "0123456789ABCDEF"[b & 0x0F];
+  }
+}
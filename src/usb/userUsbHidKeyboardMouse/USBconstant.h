@@ -7,6 +7,7 @@
 #include "include/ch5xx_usb.h"
 #include "usbCommonDescriptors/StdDescriptors.h"
 #include "usbCommonDescriptors/HIDClassCommon.h"
+#include "usb_features.h" // Generated by tools/usb_descgen.py
 // clang-format on
 
 #define EP0_ADDR 0
@@ -14,7 +15,27 @@
 
 #define KEYBOARD_EPADDR 0x81
 #define KEYBOARD_LED_EPADDR 0x01
-#define KEYBOARD_MOUSE_EPSIZE 9
+
+// Separate config endpoint (raw HID interface on EP2) on chips with the USB
+// RAM for it. Carries the same 64-byte packets as Feature Report 0xF0.
+#if USB_HID_RAW_HID && defined(CH559)
+#define USB_CONFIG_ENDPOINT
+#define EP2_ADDR (EP1_ADDR + 128)
+#define CONFIG_IN_EPADDR 0x82
+#define CONFIG_OUT_EPADDR 0x02
+#define CONFIG_EPSIZE 64
+#endif
+
+// Serial string = the chip's unique ID in hex, built by USB_initSerial() at
+// boot (ROM_CHIP_ID_* in the WCH headers: 0x3FFA-0x3FFF on CH551-CH554,
+// from 0x20 on CH559)
+#if defined(CH559)
+#define USB_CHIP_ID_ADDR 0x0020
+#else
+#define USB_CHIP_ID_ADDR 0x3FFA
+#endif
+#define USB_CHIP_ID_BYTES 6
+#define USB_SERIAL_CHARS (USB_CHIP_ID_BYTES * 2)
 
 /** Type define for the device configuration descriptor structure. This must be
  * defined in the application code, as the configuration descriptor contains
@@ -29,14 +50,27 @@ typedef struct {
   USB_HID_Descriptor_HID_t HID_KeyboardHID;
   USB_Descriptor_Endpoint_t HID_ReportINEndpoint;
   USB_Descriptor_Endpoint_t HID_ReportOUTEndpoint;
+
+#ifdef USB_CONFIG_ENDPOINT
+  // Raw HID Config Interface
+  USB_Descriptor_Interface_t Config_Interface;
+  USB_HID_Descriptor_HID_t Config_HID;
+  USB_Descriptor_Endpoint_t Config_INEndpoint;
+  USB_Descriptor_Endpoint_t Config_OUTEndpoint;
+#endif
 } USB_Descriptor_Configuration_t;
 
 extern __code USB_Descriptor_Device_t DeviceDescriptor;
 extern __code USB_Descriptor_Configuration_t ConfigurationDescriptor;
 extern __code uint8_t ReportDescriptor[];
+#ifdef USB_CONFIG_ENDPOINT
+extern __code uint8_t ConfigReportDescriptor[];
+#endif
 extern __code uint8_t LanguageDescriptor[];
-extern __code uint16_t SerialDescriptor[];
+extern __xdata uint16_t SerialDescriptor[];
 extern __code uint16_t ProductDescriptor[];
 extern __code uint16_t ManufacturerDescriptor[];
 
+void USB_initSerial(void);
+
 #endif
@@ -0,0 +1,113 @@
+// clang-format off
+#include <stdint.h>
+#include "include/ch5xx.h"
+#include "USBcopy.h"
+// clang-format on
+
+// Per byte, an indexed C loop recomputes both addresses (about 20
+// instructions); these loops spend 5 (xdata) or 7 (code) on it:
+//
+//   xdata:  movx a,@dptr / inc XBUS_AUX / movx @dptr,a / dec XBUS_AUX / djnz
+//   code:   clr a / movc a,@a+dptr / inc dptr / inc XBUS_AUX / movx @dptr,a /
+//           dec XBUS_AUX / djnz
+//
+// INC/DEC XBUS_AUX flip DPS between DPTR0 (source) and DPTR1 (destination);
+// DPS is 0 everywhere else. MOVC does not auto-increment, hence inc dptr.
+//
+// Called from the USB interrupt too, so the parameters must not share
+// overlay space with main-loop locals.
+#pragma save
+#pragma nooverlay
+
+void USB_copyXdata(__xdata uint8_t *dst, __xdata const uint8_t *src,
+                   __data uint8_t len) __naked {
+  dst; // In DPTR
+  src; // In the fixed parameter locations read below
+  len;
+  // clang-format off
+  __asm
+    mov  r2, _USB_copyXdata_PARM_2
+    mov  r3, (_USB_copyXdata_PARM_2 + 1)
+    mov  a, _USB_copyXdata_PARM_3
+
+  usbcopy_xdata:                        ; DPTR = dst, r3:r2 = src, a = len
+    jz   usbcopy_done
+    mov  r7, a
+    lcall usbcopy_setup
+  usbcopy_xdata_loop:
+    movx a, @dptr                       ; DPTR0++
+    inc  _XBUS_AUX
+    movx @dptr, a                       ; DPTR1++
+    dec  _XBUS_AUX
+    djnz r7, usbcopy_xdata_loop
+
+  usbcopy_end:
+    anl  _XBUS_AUX, #0xFB               ; ~bDPTR_AUTO_INC
+  usbcopy_done:
+    ret
+
+  usbcopy_setup:                        ; DPTR1 = DPTR0, DPTR0 = r3:r2
+    mov  r4, dpl
+    mov  r5, dph
+    inc  _XBUS_AUX
+    mov  dpl, r4
+    mov  dph, r5
+    dec  _XBUS_AUX
+    mov  dpl, r2
+    mov  dph, r3
+    orl  _XBUS_AUX, #bDPTR_AUTO_INC
+    ret
+  __endasm;
+  // clang-format on
+}
+
+void USB_copyFromCode(__xdata uint8_t *dst, __code const uint8_t *src,
+                      __data uint8_t len) __naked {
+  dst;
+  src;
+  len;
+  // clang-format off
+  __asm
+    mov  r2, _USB_copyFromCode_PARM_2
+    mov  r3, (_USB_copyFromCode_PARM_2 + 1)
+    mov  a, _USB_copyFromCode_PARM_3
+
+  usbcopy_code:                         ; DPTR = dst, r3:r2 = src, a = len
+    jnz  00001$
+    ret
+  00001$:
+    mov  r7, a
+    lcall usbcopy_setup
+  usbcopy_code_loop:
+    clr  a
+    movc a, @a+dptr
+    inc  dptr
+    inc  _XBUS_AUX
+    movx @dptr, a                       ; DPTR1++
+    dec  _XBUS_AUX
+    djnz r7, usbcopy_code_loop
+    ljmp usbcopy_end
+  __endasm;
+  // clang-format on
+}
+
+void USB_copyGeneric(__xdata uint8_t *dst, const uint8_t *src,
+                     __data uint8_t len) __naked {
+  dst;
+  src;
+  len;
+  // clang-format off
+  __asm
+    mov  r2, _USB_copyGeneric_PARM_2
+    mov  r3, (_USB_copyGeneric_PARM_2 + 1)
+    mov  a, (_USB_copyGeneric_PARM_2 + 2) ; Pointer tag: 0x80 code, 0x00 xdata
+    mov  c, acc.7
+    mov  a, _USB_copyGeneric_PARM_3
+    jnc  00001$
+    ljmp usbcopy_code
+  00001$:
+    ljmp usbcopy_xdata
+  __endasm;
+  // clang-format on
+}
+#pragma restore
@@ -0,0 +1,36 @@
+#ifndef __USB_COPY_H__
+#define __USB_COPY_H__
+
+// clang-format off
+#include <stdint.h>
+#include "include/ch5xx.h"
+// clang-format on
+
+// Block copies for endpoint buffers and the config image, using the CH55x
+// dual data pointer: DPTR0 walks the source, DPTR1 the destination, and
+// bDPTR_AUTO_INC advances a pointer after each MOVX. An xdata byte costs 5
+// instructions instead of about 20 for an indexed C loop.
+//
+// Not reentrant (the parameters after the first live at fixed addresses), and
+// the copy runs with DPS switched and auto-increment on. Call from an
+// interrupt, or from the main loop with interrupts off (EA = 0).
+// len 0 copies nothing.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void USB_copyXdata(__xdata uint8_t *dst, __xdata const uint8_t *src,
+                   __data uint8_t len);
+void USB_copyFromCode(__xdata uint8_t *dst, __code const uint8_t *src,
+                      __data uint8_t len);
+// Source in code flash or xdata RAM, picked from the generic pointer tag
+// (descriptors: tables in code, the serial string in xdata)
+void USB_copyGeneric(__xdata uint8_t *dst, const uint8_t *src,
+                     __data uint8_t len);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
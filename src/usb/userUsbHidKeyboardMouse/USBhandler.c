@@ -5,20 +5,27 @@
 #include "USBhandler.h"
 
 #include "USBconstant.h"
+#include "USBcopy.h"
 
 // Keyboard functions:
 
 void USB_EP2_IN();
 void USB_EP2_OUT();
 
-// External handlers from main .ino file
-extern void handleUSBFeatureReport(uint8_t* report, uint8_t len);
+// External state from main .ino file
 extern __xdata uint8_t usb_response[64];
 extern uint8_t usb_response_ready;
+extern volatile uint8_t usb_feature_pending;  // Report queued for the config task
+                                              // (1 = from EP0, 2 = from EP2)
 
 // Feature Report state tracking
-static uint8_t pending_feature_report = 0;  // 0=none, 1=SET_REPORT, 2=GET_REPORT
-static __xdata uint8_t feature_report_buffer[64];  // Accumulation buffer for SET_REPORT
+static uint8_t pending_feature_report = 0;  // 0=none, 1=SET_REPORT, 2=GET_REPORT, 3=GET_REPORT parked
+                                            // 4=SET_REPORT Resolution Multiplier
+#if USB_HID_HIRES_SCROLL
+extern __xdata uint8_t HIDScrollMultiplier;
+#endif
+__xdata uint8_t feature_report_buffer[64];  // Accumulation buffer for SET_REPORT
+volatile __data uint8_t USB_sofCount = 0;   // Start-of-Frame tokens seen (wraps)
 static uint8_t feature_report_offset = 0;  // Current offset in accumulation buffer
 
 // clang-format off
@@ -30,11 +37,23 @@ __xdata __at (EP1_ADDR) uint8_t Ep1Buffer[128];       //on page 47 of data sheet
 #error "This example needs more USB ram. Increase this setting in menu."
 #endif
 
+#ifdef USB_CONFIG_ENDPOINT
+// clang-format off
+__xdata __at (EP2_ADDR) uint8_t Ep2Buffer[128];       // OUT at +0, IN at +64
+// clang-format on
+
+#if (EP2_ADDR + 128) > USER_USB_RAM
+#error "The config endpoint needs more USB ram. Increase this setting in menu."
+#endif
+
+static uint8_t ep2_parked = 0; // EP2 command waiting in Ep2Buffer for EP0's
+#endif
+
 __data uint16_t SetupLen;
 __data uint8_t SetupReq;
 volatile __xdata uint8_t UsbConfig;
 
-__code uint8_t *__data pDescr;
+const uint8_t *__data pDescr;  // Generic: the serial string is in xdata
 
 volatile uint8_t usbMsgFlags = 0; // uint8_t usbMsgFlags copied from VUSB
 
@@ -66,34 +85,55 @@ void USB_EP0_SETUP() {
       case USB_REQ_TYP_CLASS: {
         switch (SetupReq) {
         case 0x09: // SET_REPORT
-          // Handle Feature Report (Report ID 0xF0)
-          if (UsbSetupBuf->wValueH == 0x03 && UsbSetupBuf->wValueL == 0xF0) {
+          // Handle Feature Report (Report ID 0xF0); refused while the
+          // previous command is still queued in feature_report_buffer
+          if (UsbSetupBuf->wValueH == 0x03 &&
+              UsbSetupBuf->wValueL == HID_REPORT_ID_CONFIG &&
+              !usb_feature_pending) {
             // Feature Report ID 0xF0 - data will arrive in OUT phase
             pending_feature_report = 1;  // SET_REPORT pending
             feature_report_offset = 0;  // Reset accumulation buffer offset
             SetupLen = UsbSetupBuf->wLengthL;  // Expected data length (64 bytes)
             len = 0;  // No data in SETUP phase
+#if USB_HID_HIRES_SCROLL
+          } else if (UsbSetupBuf->wValueH == 0x03 &&
+                     UsbSetupBuf->wValueL == HID_REPORT_ID_MOUSE) {
+            // Resolution Multiplier - one byte after the Report ID
+            pending_feature_report = 4;
+            len = 0;
+#endif
           } else {
             len = 0xFF; // Unsupported report
           }
           break;
         case 0x01: // GET_REPORT
           // Handle Feature Report read (Report ID 0xF0)
-          if (UsbSetupBuf->wValueH == 0x03 && UsbSetupBuf->wValueL == 0xF0) {
+          if (UsbSetupBuf->wValueH == 0x03 &&
+              UsbSetupBuf->wValueL == HID_REPORT_ID_CONFIG) {
             // Feature Report ID 0xF0 - prepare response
             pending_feature_report = 2;  // GET_REPORT pending
             if (usb_response_ready) {
               // Copy response directly from usb_response to Ep0Buffer
               SetupLen = 64;  // Feature report size
               len = (SetupLen >= 8) ? 8 : SetupLen;
-              for (uint8_t i = 0; i < len; i++) {
-                Ep0Buffer[i] = usb_response[i];
-              }
+              USB_copyXdata(Ep0Buffer, usb_response, len);
               SetupLen -= len;
               usb_response_ready = 0;  // Clear flag
+            } else if (usb_feature_pending == 1) {
+              // Command not processed yet - NAK the data stage until the
+              // main loop calls USB_EP0_flushDeferredReport()
+              pending_feature_report = 3;
+              len = 0xFE;
             } else {
               len = 0xFF; // No response ready
             }
+#if USB_HID_HIRES_SCROLL
+          } else if (UsbSetupBuf->wValueH == 0x03 &&
+                     UsbSetupBuf->wValueL == HID_REPORT_ID_MOUSE) {
+            Ep0Buffer[0] = HID_REPORT_ID_MOUSE;
+            Ep0Buffer[1] = HIDScrollMultiplier;
+            len = (SetupLen >= 2) ? 2 : SetupLen;
+#endif
           } else {
             len = 0xFF; // Unsupported report
           }
@@ -132,7 +172,7 @@ void USB_EP0_SETUP() {
           } else if (UsbSetupBuf->wValueL == 2) {
             pDescr = (__code uint8_t *)ProductDescriptor;
           } else if (UsbSetupBuf->wValueL == 3) {
-            pDescr = (__code uint8_t *)SerialDescriptor;
+            pDescr = (const uint8_t *)SerialDescriptor;
           } else {
             len = 0xff;
             break;
@@ -140,6 +180,12 @@ void USB_EP0_SETUP() {
           len = pDescr[0];
           break;
         case 0x22:
+#ifdef USB_CONFIG_ENDPOINT
+          if (UsbSetupBuf->wValueL == 0 && UsbSetupBuf->wIndexL == 1) {
+            pDescr = (__code uint8_t *)ConfigReportDescriptor;
+            len = ConfigurationDescriptor.Config_HID.HIDReportLength;
+          } else
+#endif
           if (UsbSetupBuf->wValueL == 0) {
             pDescr = (__code uint8_t *)ReportDescriptor;
             len = ConfigurationDescriptor.HID_KeyboardHID.HIDReportLength;
@@ -158,9 +204,7 @@ void USB_EP0_SETUP() {
           len = SetupLen >= DEFAULT_ENDP0_SIZE
                     ? DEFAULT_ENDP0_SIZE
                     : SetupLen; // transmit length for this packet
-          for (__data uint8_t i = 0; i < len; i++) {
-            Ep0Buffer[i] = pDescr[i];
-          }
+          USB_copyGeneric(Ep0Buffer, pDescr, len);
           SetupLen -= len;
           pDescr += len;
         }
@@ -329,6 +373,9 @@ void USB_EP0_SETUP() {
     SetupReq = 0xFF;
     UEP0_CTRL =
         bUEP_R_TOG | bUEP_T_TOG | UEP_R_RES_STALL | UEP_T_RES_STALL; // STALL
+  } else if (len == 0xfe) { // Data stage deferred, NAK IN until it is loaded
+    UEP0_T_LEN = 0;
+    UEP0_CTRL = bUEP_R_TOG | bUEP_T_TOG | UEP_R_RES_ACK | UEP_T_RES_NAK;
   } else if (len <=
              DEFAULT_ENDP0_SIZE) // Tx data to host or send 0-length packet
   {
@@ -348,10 +395,7 @@ void USB_EP0_IN() {
     __data uint8_t len = SetupLen >= DEFAULT_ENDP0_SIZE
                              ? DEFAULT_ENDP0_SIZE
                              : SetupLen; // send length
-    for (__data uint8_t i = 0; i < len; i++) {
-      Ep0Buffer[i] = pDescr[i];
-    }
-    // memcpy( Ep0Buffer, pDescr, len );
+    USB_copyGeneric(Ep0Buffer, pDescr, len);
     SetupLen -= len;
     pDescr += len;
     UEP0_T_LEN = len;
@@ -368,9 +412,7 @@ void USB_EP0_IN() {
                                ? DEFAULT_ENDP0_SIZE
                                : SetupLen;
       __data uint8_t offset = 64 - SetupLen;  // Calculate where we are in the buffer
-      for (__data uint8_t i = 0; i < len; i++) {
-        Ep0Buffer[i] = usb_response[offset + i];
-      }
+      USB_copyXdata(Ep0Buffer, usb_response + offset, len);
       SetupLen -= len;
       UEP0_T_LEN = len;
       UEP0_CTRL ^= bUEP_T_TOG;  // Toggle DATA0/DATA1
@@ -398,24 +440,103 @@ void USB_EP0_OUT() {
       __data uint8_t packet_len = USB_RX_LEN;  // Actual bytes received (typically 8)
 
       // Copy packet data to accumulation buffer
-      for (__data uint8_t i = 0; i < packet_len && feature_report_offset < 64; i++) {
-        feature_report_buffer[feature_report_offset++] = Ep0Buffer[i];
+      if (packet_len > 64 - feature_report_offset) {
+        packet_len = 64 - feature_report_offset;
       }
+      USB_copyXdata(feature_report_buffer + feature_report_offset, Ep0Buffer,
+                    packet_len);
+      feature_report_offset += packet_len;
 
       // Check if we've received all 64 bytes
       if (feature_report_offset >= 64) {
-        // Complete 64-byte Feature Report received - process it
-        handleUSBFeatureReport(feature_report_buffer, 64);
+        // Complete 64-byte Feature Report received - hand it to the config
+        // task; processing (and any DataFlash work) stays out of the ISR
+        usb_feature_pending = 1;  // From EP0
         pending_feature_report = 0;  // Clear flag
         feature_report_offset = 0;   // Reset for next transfer
+#ifdef USB_CONFIG_ENDPOINT
+        // The host retries EP2 commands until USB_EP2_resume()
+        UEP2_CTRL = UEP2_CTRL & ~MASK_UEP_R_RES | UEP_R_RES_NAK;
+#endif
       }
     }
+#if USB_HID_HIRES_SCROLL
+    else if (pending_feature_report == 4) {
+      HIDScrollMultiplier = (USB_RX_LEN >= 2) ? (Ep0Buffer[1] & 0x03) : 0;
+      pending_feature_report = 0;
+    }
+#endif
 
     UEP0_T_LEN = 0;
     UEP0_CTRL |= UEP_R_RES_ACK | UEP_T_RES_NAK; // Respond Ack
   }
 }
 
+// Start a GET_REPORT data stage that was parked while its command was queued.
+// Main loop only, with the USB interrupt masked.
+void USB_EP0_flushDeferredReport(void) {
+  if (pending_feature_report != 3 || !usb_response_ready) {
+    return;
+  }
+  EA = 0; // USB_copyXdata() switches DPTRs (USBcopy.h)
+  USB_copyXdata(Ep0Buffer, usb_response, DEFAULT_ENDP0_SIZE);
+  EA = 1;
+  SetupLen = 64 - DEFAULT_ENDP0_SIZE;
+  usb_response_ready = 0;
+  pending_feature_report = 2; // Rest goes out through GET_REPORT continuation
+  UEP0_T_LEN = DEFAULT_ENDP0_SIZE;
+  UEP0_CTRL = UEP0_CTRL & ~MASK_UEP_T_RES | UEP_T_RES_ACK;
+}
+
+#ifdef USB_CONFIG_ENDPOINT
+void USB_EP2_OUT() {
+  if (U_TOG_OK && USB_RX_LEN == 64) {
+    // NAK further packets until the config task has answered this one
+    UEP2_CTRL = UEP2_CTRL & ~MASK_UEP_R_RES | UEP_R_RES_NAK;
+    if (usb_feature_pending) {
+      ep2_parked = 1; // Arrived just before EP0's command NAKed EP2
+      return;
+    }
+    USB_copyXdata(feature_report_buffer, Ep2Buffer, 64);
+    usb_feature_pending = 2; // From EP2
+  }
+}
+
+void USB_EP2_IN() {
+  UEP2_T_LEN = 0;
+  UEP2_CTRL = UEP2_CTRL & ~MASK_UEP_T_RES | UEP_T_RES_NAK;
+}
+
+// Queue usb_response on EP2 IN and accept the next command.
+// Main loop only, with the USB interrupt masked.
+void USB_EP2_sendResponse(void) {
+  if (usb_response_ready) {
+    EA = 0;
+    USB_copyXdata(Ep2Buffer + 64, usb_response, 64);
+    EA = 1;
+    usb_response_ready = 0;
+    UEP2_T_LEN = 64;
+    UEP2_CTRL = UEP2_CTRL & ~MASK_UEP_T_RES | UEP_T_RES_ACK;
+  }
+  UEP2_CTRL = UEP2_CTRL & ~MASK_UEP_R_RES | UEP_R_RES_ACK;
+}
+
+// Accept EP2 commands again after an EP0 command: queue the one parked in
+// Ep2Buffer, or ACK the next packet.
+// Main loop only, with the USB interrupt masked.
+void USB_EP2_resume(void) {
+  if (ep2_parked) {
+    ep2_parked = 0;
+    EA = 0;
+    USB_copyXdata(feature_report_buffer, Ep2Buffer, 64);
+    EA = 1;
+    usb_feature_pending = 2; // Stays NAKed until its response is queued
+    return;
+  }
+  UEP2_CTRL = UEP2_CTRL & ~MASK_UEP_R_RES | UEP_R_RES_ACK;
+}
+#endif
+
 #pragma save
 #pragma nooverlay
 void USBInterrupt(void) { // inline not really working in multiple files in SDCC
@@ -520,6 +641,9 @@ void USBInterrupt(void) { // inline not really working in multiple files in SDCC
   if (UIF_BUS_RST) {
     UEP0_CTRL = UEP_R_RES_ACK | UEP_T_RES_NAK;
     UEP1_CTRL = bUEP_AUTO_TOG | UEP_T_RES_NAK | UEP_R_RES_ACK;
+#ifdef USB_CONFIG_ENDPOINT
+    UEP2_CTRL = bUEP_AUTO_TOG | UEP_T_RES_NAK | UEP_R_RES_ACK;
+#endif
 
     USB_DEV_AD = 0x00;
     UIF_SUSPEND = 0;
@@ -570,7 +694,12 @@ void USBDeviceCfg() {
 #endif
 }
 
+// Frame clock for the input scan (1 ms full-speed frames); kept to one
+// increment so the extra interrupt per frame costs a few cycles
+void USB_SOF() { USB_sofCount++; }
+
 void USBDeviceIntCfg() {
+  USB_INT_EN |= bUIE_DEV_SOF;  // Enable Start-of-Frame interrupt
   USB_INT_EN |= bUIE_SUSPEND;  // Enable device hang interrupt
   USB_INT_EN |= bUIE_TRANSFER; // Enable USB transfer completion interrupt
   USB_INT_EN |= bUIE_BUS_RST;  // Enable device mode USB bus reset interrupt
@@ -586,6 +715,10 @@ void USBDeviceEndPointCfg() {
   UEP0_DMA_L = ((uint16_t)Ep0Buffer >> 0); // Endpoint 0 data transfer address
   UEP1_DMA_H = ((uint16_t)Ep1Buffer >> 8); // Endpoint 1 data transfer address
   UEP1_DMA_L = ((uint16_t)Ep1Buffer >> 0); // Endpoint 1 data transfer address
+#ifdef USB_CONFIG_ENDPOINT
+  UEP2_DMA_H = ((uint16_t)Ep2Buffer >> 8); // Endpoint 2 data transfer address
+  UEP2_DMA_L = ((uint16_t)Ep2Buffer >> 0); // Endpoint 2 data transfer address
+#endif
 #else
   UEP0_DMA = (uint16_t)Ep0Buffer; // Endpoint 0 data transfer address
   UEP1_DMA = (uint16_t)Ep1Buffer; // Endpoint 1 data transfer address
@@ -595,6 +728,10 @@ void USBDeviceEndPointCfg() {
               UEP_R_RES_ACK; // Endpoint 2 automatically flips the sync flag, IN
                              // transaction returns NAK, OUT returns ACK
   UEP4_1_MOD = 0XC0;         // endpoint1 TX RX enable
+#ifdef USB_CONFIG_ENDPOINT
+  UEP2_CTRL = bUEP_AUTO_TOG | UEP_T_RES_NAK | UEP_R_RES_ACK; // Config endpoint
+  UEP2_3_MOD = bUEP2_RX_EN | bUEP2_TX_EN; // endpoint2 single 64-byte RX + TX buffers
+#endif
   UEP0_CTRL =
       UEP_R_RES_ACK | UEP_T_RES_NAK; // Manual flip, OUT transaction returns
                                      // ACK, IN transaction returns NAK
@@ -11,28 +11,36 @@
 // clang-format off
 extern __xdata __at (EP0_ADDR) uint8_t Ep0Buffer[];
 extern __xdata __at (EP1_ADDR) uint8_t Ep1Buffer[];
+#ifdef USB_CONFIG_ENDPOINT
+extern __xdata __at (EP2_ADDR) uint8_t Ep2Buffer[];
+#endif
 // clang-format on
 
 extern __data uint16_t SetupLen;
 extern __data uint8_t SetupReq;
 volatile extern __xdata uint8_t UsbConfig;
 
-extern const __code uint8_t *__data pDescr;
+extern const uint8_t *__data pDescr;
 
 void USB_EP1_IN();
 void USB_EP1_OUT();
+void USB_SOF();
 
 #define UsbSetupBuf ((PUSB_SETUP_REQ)Ep0Buffer)
 
 // Out
 #define EP0_OUT_Callback USB_EP0_OUT
 #define EP1_OUT_Callback USB_EP1_OUT
+#ifdef USB_CONFIG_ENDPOINT
+#define EP2_OUT_Callback USB_EP2_OUT
+#else
 #define EP2_OUT_Callback NOP_Process
+#endif
 #define EP3_OUT_Callback NOP_Process
 #define EP4_OUT_Callback NOP_Process
 
 // SOF
-#define EP0_SOF_Callback NOP_Process
+#define EP0_SOF_Callback USB_SOF  // SOF is reported on endpoint 0
 #define EP1_SOF_Callback NOP_Process
 #define EP2_SOF_Callback NOP_Process
 #define EP3_SOF_Callback NOP_Process
@@ -41,7 +49,11 @@ void USB_EP1_OUT();
 // IN
 #define EP0_IN_Callback USB_EP0_IN
 #define EP1_IN_Callback USB_EP1_IN
+#ifdef USB_CONFIG_ENDPOINT
+#define EP2_IN_Callback USB_EP2_IN
+#else
 #define EP2_IN_Callback NOP_Process
+#endif
 #define EP3_IN_Callback NOP_Process
 #define EP4_IN_Callback NOP_Process
 
@@ -53,6 +65,11 @@ void USB_EP1_OUT();
 #define EP4_SETUP_Callback NOP_Process
 
 void USBInterrupt(void);
+void USB_EP0_flushDeferredReport(void);
+#ifdef USB_CONFIG_ENDPOINT
+void USB_EP2_sendResponse(void);
+void USB_EP2_resume(void);
+#endif
 void USBDeviceCfg();
 void USBDeviceIntCfg();
 void USBDeviceEndPointCfg();
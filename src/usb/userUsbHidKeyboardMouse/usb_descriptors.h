@@ -0,0 +1,130 @@
+// Generated by tools/usb_descgen.py (features: raw-hid,fast-poll) - do not edit
+
+#pragma once
+
+// 170 bytes
+__code uint8_t ReportDescriptor[] = {
+    // Keyboard - Report ID 1
+    0x05, 0x01,       // USAGE_PAGE (Generic Desktop)
+    0x09, 0x06,       // USAGE (Keyboard)
+    0xA1, 0x01,       // COLLECTION (Application)
+    0x85, 0x01,       //   REPORT_ID (1)
+    0x05, 0x07,       //   USAGE_PAGE (Keyboard)
+    0x19, 0xE0,       //   USAGE_MINIMUM (Keyboard LeftControl)
+    0x29, 0xE7,       //   USAGE_MAXIMUM (Keyboard Right GUI)
+    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
+    0x25, 0x01,       //   LOGICAL_MAXIMUM (1)
+    0x75, 0x01,       //   REPORT_SIZE (1)
+    0x95, 0x08,       //   REPORT_COUNT (8)
+    0x81, 0x02,       //   INPUT (Data,Var,Abs)
+    0x75, 0x08,       //   REPORT_SIZE (8)
+    0x95, 0x01,       //   REPORT_COUNT (1)
+    0x81, 0x03,       //   INPUT (Cnst,Var,Abs)
+    0x75, 0x08,       //   REPORT_SIZE (8)
+    0x95, 0x06,       //   REPORT_COUNT (6)
+    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
+    0x26, 0xFF, 0x00, //   LOGICAL_MAXIMUM (255)
+    0x19, 0x00,       //   USAGE_MINIMUM (Reserved (no event indicated))
+    0x29, 0xE7,       //   USAGE_MAXIMUM (Keyboard Right GUI)
+    0x81, 0x00,       //   INPUT (Data,Ary,Abs)
+    0x05, 0x08,       //   USAGE_PAGE (LEDs)
+    0x19, 0x01,       //   USAGE_MINIMUM (Num Lock)
+    0x29, 0x05,       //   USAGE_MAXIMUM (Kana)
+    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
+    0x25, 0x01,       //   LOGICAL_MAXIMUM (1)
+    0x75, 0x01,       //   REPORT_SIZE (1)
+    0x95, 0x05,       //   REPORT_COUNT (5)
+    0x91, 0x02,       //   OUTPUT (Data,Var,Abs)
+    0x75, 0x03,       //   REPORT_SIZE (3)
+    0x95, 0x01,       //   REPORT_COUNT (1)
+    0x91, 0x03,       //   OUTPUT (Cnst,Var,Abs)
+    0xC0,             // END_COLLECTION
+    // Mouse - Report ID 2
+    0x05, 0x01,       // USAGE_PAGE (Generic Desktop)
+    0x09, 0x02,       // USAGE (Mouse)
+    0xA1, 0x01,       // COLLECTION (Application)
+    0x09, 0x01,       //   USAGE (Pointer)
+    0xA1, 0x00,       //   COLLECTION (Physical)
+    0x85, 0x02,       //     REPORT_ID (2)
+    0x05, 0x09,       //     USAGE_PAGE (Button)
+    0x19, 0x01,       //     USAGE_MINIMUM (Button 1)
+    0x29, 0x03,       //     USAGE_MAXIMUM (Button 3)
+    0x15, 0x00,       //     LOGICAL_MINIMUM (0)
+    0x25, 0x01,       //     LOGICAL_MAXIMUM (1)
+    0x75, 0x01,       //     REPORT_SIZE (1)
+    0x95, 0x03,       //     REPORT_COUNT (3)
+    0x81, 0x02,       //     INPUT (Data,Var,Abs)
+    0x75, 0x05,       //     REPORT_SIZE (5)
+    0x95, 0x01,       //     REPORT_COUNT (1)
+    0x81, 0x03,       //     INPUT (Cnst,Var,Abs)
+    0x05, 0x01,       //     USAGE_PAGE (Generic Desktop)
+    0x09, 0x30,       //     USAGE (X)
+    0x09, 0x31,       //     USAGE (Y)
+    0x09, 0x38,       //     USAGE (Wheel)
+    0x15, 0x81,       //     LOGICAL_MINIMUM (-127)
+    0x25, 0x7F,       //     LOGICAL_MAXIMUM (127)
+    0x75, 0x08,       //     REPORT_SIZE (8)
+    0x95, 0x03,       //     REPORT_COUNT (3)
+    0x81, 0x06,       //     INPUT (Data,Var,Rel)
+    0xC0,             //   END_COLLECTION
+    0xC0,             // END_COLLECTION
+    // Consumer - Report ID 3
+    0x05, 0x0C,       // USAGE_PAGE (Consumer)
+    0x09, 0x01,       // USAGE (Consumer Control)
+    0xA1, 0x01,       // COLLECTION (Application)
+    0x85, 0x03,       //   REPORT_ID (3)
+    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
+    0x26, 0xFF, 0x03, //   LOGICAL_MAXIMUM (1023)
+    0x19, 0x00,       //   USAGE_MINIMUM (Unassigned)
+    0x2A, 0xFF, 0x03, //   USAGE_MAXIMUM (0x03FF)
+    0x75, 0x10,       //   REPORT_SIZE (16)
+    0x95, 0x04,       //   REPORT_COUNT (4)
+    0x81, 0x00,       //   INPUT (Data,Ary,Abs)
+    0xC0,             // END_COLLECTION
+    // Config - Report ID 240
+    0x06, 0x00, 0xFF, // USAGE_PAGE (Vendor Defined 0xFF00)
+    0x09, 0x01,       // USAGE (Vendor Usage 1)
+    0xA1, 0x01,       // COLLECTION (Application)
+    0x85, 0xF0,       //   REPORT_ID (240)
+    0x09, 0x01,       //   USAGE (Vendor Usage 1)
+    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
+    0x26, 0xFF, 0x00, //   LOGICAL_MAXIMUM (255)
+    0x75, 0x08,       //   REPORT_SIZE (8)
+    0x95, 0x3F,       //   REPORT_COUNT (63)
+    0xB1, 0x02,       //   FEATURE (Data,Var,Abs)
+    0xC0,             // END_COLLECTION
+};
+
+#ifdef USB_CONFIG_ENDPOINT
+// Raw HID config interface: 64-byte input and output reports, no report
+// ID (byte 0 of the payload is still 0xF0, as in the Feature Report)
+__code uint8_t ConfigReportDescriptor[] = {
+    0x06, 0x00, 0xFF, // USAGE_PAGE (Vendor Defined 0xFF00)
+    0x09, 0x02,       // USAGE (Vendor Usage 2)
+    0xA1, 0x01,       // COLLECTION (Application)
+    0x15, 0x00,       //   LOGICAL_MINIMUM (0)
+    0x26, 0xFF, 0x00, //   LOGICAL_MAXIMUM (255)
+    0x75, 0x08,       //   REPORT_SIZE (8)
+    0x95, 0x40,       //   REPORT_COUNT (64)
+    0x09, 0x02,       //   USAGE (Vendor Usage 2)
+    0x81, 0x02,       //   INPUT (Data,Var,Abs)
+    0x09, 0x02,       //   USAGE (Vendor Usage 2)
+    0x91, 0x02,       //   OUTPUT (Data,Var,Abs)
+    0xC0,             // END_COLLECTION
+};
+#endif
+
+// String Descriptors
+__code uint8_t LanguageDescriptor[] = {0x04, 0x03, 0x09, 0x04};
+// Serial String Descriptor - chip ID in hex, see USB_initSerial()
+__xdata uint16_t SerialDescriptor[1 + USB_SERIAL_CHARS];
+__code uint16_t ProductDescriptor[] = {
+    // Product String Descriptor
+    (((10 + 1) * 2) | (DTYPE_String << 8)),
+    'C', 'H', '5', '5', 'x', 'd', 'u', 'i', 'n', 'o',
+};
+__code uint16_t ManufacturerDescriptor[] = {
+    // Manufacturer String Descriptor
+    (((6 + 1) * 2) | (DTYPE_String << 8)),
+    'D', 'e', 'q', 'i', 'n', 'g',
+};
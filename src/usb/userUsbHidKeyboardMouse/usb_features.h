@@ -0,0 +1,23 @@
+// Generated by tools/usb_descgen.py (features: raw-hid,fast-poll) - do not edit
+
+#pragma once
+
+#define USB_HID_NKRO           0
+#define USB_HID_HIRES_SCROLL   0
+#define USB_HID_RAW_HID        1
+#define USB_HID_HOST_EVENTS    0
+#define USB_HID_FAST_POLL      1
+
+// Report IDs and payload sizes (Report ID byte not included)
+#define HID_REPORT_ID_KEYBOARD   0x01
+#define HID_REPORT_ID_MOUSE      0x02
+#define HID_REPORT_ID_CONSUMER   0x03
+#define HID_REPORT_ID_CONFIG     0xF0
+#define HID_KEYBOARD_INPUT_BYTES 8
+#define HID_KEYBOARD_OUTPUT_BYTES 1
+#define HID_MOUSE_INPUT_BYTES 4
+#define HID_CONSUMER_INPUT_BYTES 8
+#define HID_CONFIG_FEATURE_BYTES 63
+
+#define KEYBOARD_MOUSE_EPSIZE 9  // Largest input report + ID
+#define KEYBOARD_MOUSE_INTERVAL 1  // EP1 IN bInterval, ms
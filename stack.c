@@ -0,0 +1,33 @@
+// ===================================================================================
+// Stack High-Water Mark Implementation for CH552G Keyboard v2.0
+// ===================================================================================
+
+#include <Arduino.h>
+#include "stack.h"
+
+extern __idata uint8_t _start__stack[];  // Linker: first byte of the stack segment
+
+// Everything above SP is free at the time of the call. Bytes an interrupt
+// writes during painting may be painted over; its next run marks them again.
+void Stack_paint(void) {
+  uint8_t addr = SP;
+
+  while(addr != STACK_TOP) {
+    addr++;
+    *(__idata uint8_t *)addr = STACK_PAINT;
+  }
+}
+
+uint8_t Stack_base(void) {
+  return (uint8_t)_start__stack;
+}
+
+uint8_t Stack_highWater(void) {
+  uint8_t addr = STACK_TOP;
+
+  // Never below the live stack: those bytes are in use right now
+  while(addr > SP && *(__idata uint8_t *)addr == STACK_PAINT) {
+    addr--;
+  }
+  return addr;
+}
@@ -0,0 +1,29 @@
+// ===================================================================================
+// Stack High-Water Mark for CH552G Keyboard v2.0
+// ===================================================================================
+//
+// The 8051 stack lives in internal RAM: it starts right after the register
+// banks, data and overlay variables (linker symbol __start__stack) and grows
+// up to 0xFF. Nothing stops it there - an overflow wraps into the register
+// banks and corrupts state silently.
+//
+// Stack_paint() fills everything above the current stack pointer with
+// STACK_PAINT. Stack_highWater() later scans down from the top for the first
+// byte that is no longer painted: the highest address any call chain or
+// interrupt has reached since painting. A pushed byte that happens to equal
+// STACK_PAINT at the very top is not seen, so the mark can be low by a byte.
+//
+// GET_DIAG reports both ends; tools/stack_report.py sets them against the
+// call chains in the linker map and listings.
+// ===================================================================================
+
+#pragma once
+#include <stdint.h>
+
+#define STACK_PAINT  0xA5
+#define STACK_TOP    0xFF  // Last internal RAM byte (256 bytes on CH55x)
+
+// Public Functions
+void Stack_paint(void);          // Paint from above SP to STACK_TOP
+uint8_t Stack_base(void);        // First stack byte (SP + 1 at reset)
+uint8_t Stack_highWater(void);   // Highest stack byte written since painting
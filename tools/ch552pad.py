@@ -0,0 +1,338 @@
+#!/usr/bin/env python3
+"""
+Config protocol access to CH552G Mini Keyboards over Linux hidraw.
+
+Shared by the host tools in this directory. Each command is one 64-byte
+Feature Report 0xF0 (SET_REPORT) followed by a GET_REPORT for the response;
+byte 63 is the XOR of bytes 0-62 in both directions. The firmware NAKs the
+GET_REPORT until the command has run, so a transaction is two blocking
+ioctls.
+
+Pads are found through sysfs: VID:PID 1209:C55D, on the hidraw node whose
+report descriptor declares Report ID 0xF0 (the CH559 raw HID interface has
+no report IDs and is skipped). The USB serial is the chip's unique ID; with
+99-ch552pad.rules installed, open_pad() finds a pad by serial through its
+/dev/ch552pad/<serial> link without scanning.
+
+Usage as a script:
+    ch552pad.py            list connected pads with their GET_INFO data
+    ch552pad.py SERIAL     the same for one pad
+"""
+
+import fcntl
+import glob
+import os
+import struct
+import sys
+
+VID = 0x1209
+PID = 0xC55D
+
+UDEV_DIR = "/dev/ch552pad"  # Links by serial from 99-ch552pad.rules
+
+REPORT_ID = 0xF0
+REPORT_SIZE = 64
+
+# Commands (must match ch552g_mini_keyboard.ino)
+CMD_READ_CONFIG = 0x01
+CMD_WRITE_ACTION = 0x02
+CMD_WRITE_ALL = 0x03
+CMD_GET_INFO = 0x04
+CMD_SET_SLOT = 0x05
+CMD_FACTORY_RESET = 0x06
+CMD_LOAD_PRESET = 0x07
+CMD_GET_STATS = 0x08
+CMD_GET_COUNTERS = 0x09
+CMD_GET_DIAG = 0x0A
+CMD_ENTER_BOOTLOADER = 0x0B
+CMD_WRITE_OVERLAY = 0x0C
+
+CAP_HOST_EVENTS = 0x08  # GET_INFO caps: Host actions send report 0xF1
+CAP_OVERLAY_SLOT = 0x10  # GET_INFO caps: WRITE_OVERLAY RAM slot
+
+BOOTLOADER_MAGIC = b"\x07\xb0\x07\xb0"  # 0xB007B007, little endian
+
+ERRORS = {
+    0x00: "success",
+    0x01: "invalid command",
+    0x02: "invalid slot",
+    0x03: "invalid input",
+    0x04: "invalid preset",
+    0x05: "checksum error",
+}
+
+COUNTERS_OFFSET = 11
+
+ACTION_SIZE = 8
+CONFIG_PACKET_BYTES = 56  # READ_CONFIG action bytes per packet
+OVERLAY_PER_PACKET = 7  # WRITE_OVERLAY actions per report
+OVERLAY_ACTIVATE = 0x01
+
+
+class PadError(Exception):
+    pass
+
+
+# ============================================================================
+# hidraw ioctls (linux/hidraw.h)
+# ============================================================================
+
+def _ioc(direction, nr, size):
+    return (direction << 30) | (size << 16) | (ord("H") << 8) | nr
+
+
+_IOC_WRITE_READ = 3
+HIDIOCSFEATURE = _ioc(_IOC_WRITE_READ, 0x06, REPORT_SIZE)
+HIDIOCGFEATURE = _ioc(_IOC_WRITE_READ, 0x07, REPORT_SIZE)
+
+
+def checksum(data):
+    c = 0
+    for b in data:
+        c ^= b
+    return c
+
+
+def fingerprint(actions, active_slot, brightness):
+    """GET_INFO config fingerprint: Fletcher-16 over the READ_CONFIG image."""
+    sum1 = sum2 = 0
+    for b in bytes(actions) + bytes((active_slot, brightness)):
+        sum1 = (sum1 + b) % 255
+        sum2 = (sum2 + sum1) % 255
+    return sum2 << 8 | sum1
+
+
+# ============================================================================
+# Discovery
+# ============================================================================
+
+def _uevent(node):
+    info = {}
+    try:
+        with open("/sys/class/hidraw/%s/device/uevent" % node) as f:
+            for line in f:
+                key, _, value = line.strip().partition("=")
+                info[key] = value
+    except OSError:
+        pass
+    return info
+
+
+def _has_config_report(node):
+    try:
+        with open("/sys/class/hidraw/%s/device/report_descriptor" % node, "rb") as f:
+            desc = f.read()
+    except OSError:
+        return False
+    return b"\x85\xf0" in desc
+
+
+def find_pads():
+    """Return [(device path, serial, sysfs id)] for every connected pad."""
+    want = "0003:%08X:%08X" % (VID, PID)
+    pads = []
+    for path in sorted(glob.glob("/sys/class/hidraw/hidraw*")):
+        node = os.path.basename(path)
+        info = _uevent(node)
+        if info.get("HID_ID", "").upper() != want or not _has_config_report(node):
+            continue
+        # Physical path identifies the USB port on old firmware (fixed serial)
+        pads.append(("/dev/" + node, info.get("HID_UNIQ", ""),
+                     info.get("HID_PHYS", node)))
+    return pads
+
+
+def find_pad(serial):
+    """Device path of the pad with this serial, or None. O(1) through the
+    udev link when the rules are installed, otherwise a sysfs scan."""
+    link = os.path.join(UDEV_DIR, serial)
+    if os.path.exists(link):
+        return os.path.realpath(link)
+    for path, uniq, _ in find_pads():
+        if uniq == serial:
+            return path
+    return None
+
+
+def open_pad(serial):
+    path = find_pad(serial)
+    if path is None:
+        raise PadError("no pad with serial %s" % serial)
+    return Pad(path)
+
+
+def usb_port(path):
+    """USB port of a hidraw node ("1-2.3"): the sysfs name of the parent USB
+    device. It stays the same when the pad re-enumerates as the bootloader."""
+    node = os.path.realpath("/sys/class/hidraw/%s/device" % os.path.basename(path))
+    while node != "/":
+        if os.path.exists(os.path.join(node, "busnum")):
+            return os.path.basename(node)
+        node = os.path.dirname(node)
+    return None
+
+
+def find_usb(vid, pid):
+    """Return {port: (bus, address)} for USB devices with this VID:PID."""
+    found = {}
+    for dev in glob.glob("/sys/bus/usb/devices/*"):
+        try:
+            with open(os.path.join(dev, "idVendor")) as f:
+                v = int(f.read(), 16)
+            with open(os.path.join(dev, "idProduct")) as f:
+                p = int(f.read(), 16)
+            if (v, p) != (vid, pid):
+                continue
+            with open(os.path.join(dev, "busnum")) as f:
+                bus = int(f.read())
+            with open(os.path.join(dev, "devnum")) as f:
+                address = int(f.read())
+        except (OSError, ValueError):
+            continue
+        found[os.path.basename(dev)] = (bus, address)
+    return found
+
+
+# ============================================================================
+# Transactions
+# ============================================================================
+
+class Pad:
+    """One open hidraw handle. Keep it open across requests to avoid the
+    open/descriptor cost per poll."""
+
+    def __init__(self, path):
+        self.path = path
+        self.fd = os.open(path, os.O_RDWR)
+
+    def close(self):
+        if self.fd is not None:
+            os.close(self.fd)
+            self.fd = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def fileno(self):
+        return self.fd
+
+    def request(self, command, payload=b""):
+        """Send one command, return the 64-byte response (status checked)."""
+        packet = bytearray(REPORT_SIZE)
+        packet[0] = REPORT_ID
+        packet[1] = command
+        packet[2:2 + len(payload)] = payload
+        packet[REPORT_SIZE - 1] = checksum(packet[:REPORT_SIZE - 1])
+        try:
+            fcntl.ioctl(self.fd, HIDIOCSFEATURE, bytes(packet))
+            response = bytearray(REPORT_SIZE)
+            response[0] = REPORT_ID
+            fcntl.ioctl(self.fd, HIDIOCGFEATURE, response, True)
+        except OSError as e:
+            raise PadError("%s: %s" % (self.path, e.strerror))
+        if checksum(response[:REPORT_SIZE - 1]) != response[REPORT_SIZE - 1]:
+            raise PadError("%s: response checksum mismatch" % self.path)
+        if response[1] != command and response[1] != 0xFF:
+            raise PadError("%s: response to 0x%02X, expected 0x%02X"
+                           % (self.path, response[1], command))
+        if response[2] and command != CMD_GET_INFO:
+            raise PadError("%s: %s" % (self.path, ERRORS.get(response[2], "error 0x%02X"
+                                                              % response[2])))
+        return bytes(response)
+
+    def info(self):
+        r = self.request(CMD_GET_INFO)
+        return {
+            "version": "%d.%d.%d" % (r[2], r[3], r[4]),
+            "config_version": r[5],
+            "caps": r[8],
+            "slots": r[9],
+            "inputs": r[10],
+            "actions": r[11],
+            "build": r[12:20].decode("ascii", "replace"),
+            "presets": r[36],
+            "fingerprint": struct.unpack_from("<H", r, 37)[0],
+            "slot": r[39],             # == slots while the overlay is active
+            "overlay_loaded": bool(r[40]),
+            "overlay_tag": r[41],
+            "saved_slot": r[42],
+        }
+
+    def read_config(self):
+        """(action table bytes, active slot, LED brightness)."""
+        size = self.info()["actions"] * ACTION_SIZE
+        data = bytearray()
+        r = self.request(CMD_READ_CONFIG, b"\x00")
+        active_slot, brightness = r[60], r[62]
+        for sequence in range(r[3]):
+            if sequence:
+                r = self.request(CMD_READ_CONFIG, bytes((sequence,)))
+            data += r[4:4 + CONFIG_PACKET_BYTES]
+        return bytes(data[:size]), active_slot, brightness
+
+    def write_action(self, slot, input_, action):
+        """Write one action; the pad commits it to DataFlash ~100 ms later,
+        several writes in a row in one commit."""
+        self.request(CMD_WRITE_ACTION, bytes((slot, input_)) + bytes(action))
+
+    def set_slot(self, slot, save=False):
+        """Switch slots. slot == info()["slots"] re-enters a loaded overlay."""
+        self.request(CMD_SET_SLOT, bytes((slot, 1 if save else 0)))
+
+    def write_overlay(self, actions, tag=0, activate=True, first=0):
+        """Load 8-byte actions into the RAM overlay slot from input first on.
+        No DataFlash is written; the last packet switches to it if activate."""
+        data = b"".join(actions)
+        count = len(data) // ACTION_SIZE
+        for start in range(0, count, OVERLAY_PER_PACKET):
+            n = min(OVERLAY_PER_PACKET, count - start)
+            flags = OVERLAY_ACTIVATE if activate and start + n == count else 0
+            self.request(CMD_WRITE_OVERLAY, bytes((first + start, n, flags, tag & 0xFF)) +
+                         data[start * ACTION_SIZE:(start + n) * ACTION_SIZE])
+
+    def enter_bootloader(self):
+        """Jump to the USB bootloader. The config in DataFlash is kept; the
+        pad drops off the bus about 100 ms after the response."""
+        self.request(CMD_ENTER_BOOTLOADER, BOOTLOADER_MAGIC)
+
+    def counters(self, clear=False):
+        """All activation counters as (slots, inputs, millis, [counts])."""
+        counts = []
+        slots = inputs = millis = 0
+        while True:
+            r = self.request(CMD_GET_COUNTERS, bytes((1 if clear else 0, len(counts))))
+            slots, inputs, first, n = r[3], r[4], r[5], r[6]
+            millis = struct.unpack_from("<I", r, 7)[0]
+            if first != len(counts):
+                raise PadError("%s: counter page starts at %d, expected %d"
+                               % (self.path, first, len(counts)))
+            counts.extend(struct.unpack_from("<%dH" % n, r, COUNTERS_OFFSET))
+            if n == 0 or len(counts) >= slots * inputs:
+                return slots, inputs, millis, counts
+
+
+def main():
+    pads = find_pads()
+    if len(sys.argv) > 1:
+        path = find_pad(sys.argv[1])
+        pads = [p for p in pads if p[0] == path]
+    if not pads:
+        print("no pads found (check permissions on /dev/hidraw*)", file=sys.stderr)
+        return 1
+    for path, serial, phys in pads:
+        try:
+            with Pad(path) as pad:
+                i = pad.info()
+            print("%s  serial=%s  fw %s  %d slots x %d inputs  caps 0x%02X  (%s)"
+                  % (path, serial or "-", i["version"], i["slots"], i["inputs"],
+                     i["caps"], phys))
+        except (OSError, PadError) as e:
+            print("%s  error: %s" % (path, e), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,528 @@
+#!/usr/bin/env python3
+"""
+Layout-aware macro compiler for the CH552G Mini Keyboard.
+
+Compiles text and key macros into the (modifier, usage) streams replayed by
+macro.c, for the keyboard layout the host OS is set to. The firmware never
+sees characters, so it needs no ASCII map and types exactly what the host
+layout expects.
+
+Source format (one macro per line, index = order in the file):
+
+    # comment
+    greeting = Hello, World!{ENTER}
+    undo     = {CTRL+z}
+    slow     = a{WAIT 200}b
+    braces   = {{ and }}
+
+Escapes inside the text:
+    {NAME}            tap a named key (ENTER, TAB, F5, UP, ...)
+    {MOD+...+KEY}     chord; KEY may be a named key or a single character
+    {WAIT n}          pause n milliseconds
+    {{ / }}           literal braces
+
+Streams are stored compressed: recurring runs (words, chords, common
+endings) move into a shared phrase dictionary and are replaced by one-byte
+references, which the firmware expands while playing. --no-compress stores
+the plain streams.
+
+Usage:
+    macro_compile.py macros.txt -o macro_data.h --layout de
+    macro_compile.py macros.txt --show
+    macro_compile.py --list-layouts
+"""
+
+import argparse
+import os
+import sys
+
+# Stream opcodes (must match macro.h)
+OP_END = 0x00
+OP_PHRASE_FIRST = 0x80
+OP_PHRASE_LAST = 0xEF
+OP_MODS = 0xF0
+OP_WAIT = 0xF1
+OP_USAGE = 0xF2
+
+MAX_PHRASES = OP_PHRASE_LAST - OP_PHRASE_FIRST + 1
+MAX_PHRASE_UNITS = 12
+MAX_PHRASE_DEPTH = 3  # must match MACRO_PHRASE_DEPTH in macro.h
+
+# HID modifier bits (report byte 0)
+MOD_LCTRL = 0x01
+MOD_LSHIFT = 0x02
+MOD_LALT = 0x04
+MOD_LGUI = 0x08
+MOD_RALT = 0x40  # AltGr
+
+MODIFIER_NAMES = {
+    "CTRL": MOD_LCTRL,
+    "CONTROL": MOD_LCTRL,
+    "SHIFT": MOD_LSHIFT,
+    "ALT": MOD_LALT,
+    "GUI": MOD_LGUI,
+    "WIN": MOD_LGUI,
+    "CMD": MOD_LGUI,
+    "ALTGR": MOD_RALT,
+    "RALT": MOD_RALT,
+}
+
+KEY_NAMES = {
+    "ENTER": 0x28, "RETURN": 0x28, "ESC": 0x29, "ESCAPE": 0x29,
+    "BACKSPACE": 0x2A, "BKSP": 0x2A, "TAB": 0x2B, "SPACE": 0x2C,
+    "CAPSLOCK": 0x39, "PRINTSCREEN": 0x46, "SCROLLLOCK": 0x47,
+    "PAUSE": 0x48, "INSERT": 0x49, "HOME": 0x4A, "PAGEUP": 0x4B,
+    "PGUP": 0x4B, "DELETE": 0x4C, "DEL": 0x4C, "END": 0x4D,
+    "PAGEDOWN": 0x4E, "PGDN": 0x4E, "RIGHT": 0x4F, "LEFT": 0x50,
+    "DOWN": 0x51, "UP": 0x52, "NUMLOCK": 0x53, "MENU": 0x65, "APP": 0x65,
+}
+KEY_NAMES.update({"F%d" % n: 0x3A + n - 1 for n in range(1, 13)})
+KEY_NAMES.update({"F%d" % n: 0x68 + n - 13 for n in range(13, 25)})
+
+# ============================================================================
+# Keyboard Layouts
+# ============================================================================
+#
+# Each layout maps usage -> [normal, shift, altgr] describing what the host
+# produces for that key. (usage, char) pairs in the layout's dead-key set only
+# appear after a following space.
+
+
+def _letters(overrides=None):
+    rows = {}
+    for i, c in enumerate("abcdefghijklmnopqrstuvwxyz"):
+        rows[0x04 + i] = [c, c.upper(), None]
+    for usage, chars in (overrides or {}).items():
+        rows[usage] = list(chars)
+    return rows
+
+
+def _common(rows):
+    rows[0x28] = ["\n", None, None]
+    rows[0x2B] = ["\t", None, None]
+    rows[0x2C] = [" ", None, None]
+    return rows
+
+
+def _digits(rows, normal, shifted, altgr=None):
+    altgr = altgr or {}
+    for i in range(10):
+        rows[0x1E + i] = [normal[i], shifted[i], altgr.get(0x1E + i)]
+    return rows
+
+
+def _punct(rows, table):
+    for usage, chars in table.items():
+        chars = list(chars) + [None] * (3 - len(chars))
+        rows[usage] = chars
+    return rows
+
+
+def _layout_us():
+    rows = _common(_letters())
+    _digits(rows, "1234567890", "!@#$%^&*()")
+    _punct(rows, {
+        0x2D: "-_", 0x2E: "=+", 0x2F: "[{", 0x30: "]}", 0x31: "\\|",
+        0x33: ";:", 0x34: "'\"", 0x35: "`~", 0x36: ",<", 0x37: ".>",
+        0x38: "/?",
+    })
+    return rows, set()
+
+
+def _layout_uk():
+    rows = _common(_letters())
+    _digits(rows, "1234567890", "!\"£$%^&*()", {0x21: "€"})
+    _punct(rows, {
+        0x2D: "-_", 0x2E: "=+", 0x2F: "[{", 0x30: "]}", 0x32: "#~",
+        0x33: ";:", 0x34: "'@", 0x35: "`¬", 0x36: ",<", 0x37: ".>",
+        0x38: "/?", 0x64: "\\|",
+    })
+    return rows, set()
+
+
+def _layout_de():
+    rows = _common(_letters({
+        0x1C: ("z", "Z", None), 0x1D: ("y", "Y", None),
+        0x14: ("q", "Q", "@"), 0x08: ("e", "E", "€"), 0x10: ("m", "M", "µ"),
+    }))
+    _digits(rows, "1234567890", "!\"§$%&/()=",
+            {0x1F: "²", 0x20: "³", 0x24: "{", 0x25: "[", 0x26: "]", 0x27: "}"})
+    _punct(rows, {
+        0x2D: ("ß", "?", "\\"), 0x2E: "´`", 0x2F: "üÜ", 0x30: ("+", "*", "~"),
+        0x32: "#'", 0x33: "öÖ", 0x34: "äÄ", 0x35: "^°", 0x36: ",;",
+        0x37: ".:", 0x38: "-_", 0x64: ("<", ">", "|"),
+    })
+    return rows, {(0x2E, "´"), (0x2E, "`"), (0x35, "^")}
+
+
+def _layout_fr():
+    rows = _common(_letters({
+        0x04: ("q", "Q", None), 0x14: ("a", "A", None),
+        0x1A: ("z", "Z", None), 0x1D: ("w", "W", None),
+        0x33: ("m", "M", None), 0x10: (",", "?", None),
+        0x08: ("e", "E", "€"),
+    }))
+    _digits(rows, "&é\"'(-è_çà", "1234567890",
+            {0x1F: "~", 0x20: "#", 0x21: "{", 0x22: "[", 0x23: "|",
+             0x24: "`", 0x25: "\\", 0x26: "^", 0x27: "@"})
+    _punct(rows, {
+        0x2D: (")", "°", "]"), 0x2E: ("=", "+", "}"), 0x2F: "^¨",
+        0x30: ("$", "£", "¤"), 0x32: "*µ", 0x34: "ù%", 0x35: "²",
+        0x36: ";.", 0x37: ":/", 0x38: "!§", 0x64: "<>",
+    })
+    return rows, {(0x1F, "~"), (0x24, "`"), (0x2F, "^"), (0x2F, "¨")}
+
+
+LAYOUTS = {
+    "us": _layout_us,
+    "uk": _layout_uk,
+    "de": _layout_de,
+    "fr": _layout_fr,
+}
+
+
+def build_charmap(name):
+    """Return {char: (mods, usage, dead)} choosing the cheapest key per char."""
+    rows, dead = LAYOUTS[name]()
+    charmap = {}
+    for usage in sorted(rows):
+        for level, mods in enumerate((0, MOD_LSHIFT, MOD_RALT)):
+            c = rows[usage][level]
+            if c is None:
+                continue
+            # Prefer plain keys over dead ones (FR '^' is dead on 0x2F but
+            # plain on AltGr+9), then fewer modifiers
+            entry = (mods, usage, (usage, c) in dead)
+            old = charmap.get(c)
+            if old is None or (old[2], bin(old[0]).count("1")) > \
+                    (entry[2], bin(mods).count("1")):
+                charmap[c] = entry
+    return charmap
+
+
+# ============================================================================
+# Compiler
+# ============================================================================
+
+
+class MacroError(Exception):
+    pass
+
+
+def parse_text(text, charmap):
+    """Turn macro text into a list of events: ('tap', mods, usage) / ('wait', ms)."""
+    events = []
+    i = 0
+    while i < len(text):
+        c = text[i]
+        if c == "{" and text.startswith("{{", i):
+            c, i = "{", i + 1
+        elif c == "}" and text.startswith("}}", i):
+            c, i = "}", i + 1
+        elif c == "{":
+            end = text.find("}", i + 1)
+            if end < 0:
+                raise MacroError("unterminated '{' at column %d" % (i + 1))
+            events.extend(parse_escape(text[i + 1:end], charmap))
+            i = end + 1
+            continue
+        events.extend(char_events(c, charmap))
+        i += 1
+    return events
+
+
+def char_events(c, charmap):
+    if c not in charmap:
+        raise MacroError("character %r is not on this layout" % c)
+    mods, usage, dead = charmap[c]
+    events = [("tap", mods, usage)]
+    if dead:
+        events.append(("tap", 0, KEY_NAMES["SPACE"]))
+    return events
+
+
+def parse_escape(body, charmap):
+    words = body.split()
+    if len(words) == 2 and words[0].upper() == "WAIT":
+        try:
+            ms = int(words[1], 0)
+        except ValueError:
+            raise MacroError("bad WAIT duration %r" % words[1])
+        return [("wait", ms)]
+
+    parts = body.split("+")
+    key = parts[-1]
+    mods = 0
+    for name in parts[:-1]:
+        bit = MODIFIER_NAMES.get(name.strip().upper())
+        if bit is None:
+            raise MacroError("unknown modifier %r" % name)
+        mods |= bit
+
+    if key.strip().upper() in KEY_NAMES:
+        return [("tap", mods, KEY_NAMES[key.strip().upper()])]
+    if len(key) == 1:
+        events = char_events(key, charmap)
+        kind, cmods, usage = events[0]
+        return [("tap", mods | cmods, usage)] + events[1:]
+    if key.upper().startswith("0X"):
+        return [("tap", mods, int(key, 16) & 0xFF)]
+    raise MacroError("unknown key %r" % key)
+
+
+def encode(events):
+    """Encode events as a byte stream with run-length modifier state."""
+    out = bytearray()
+    mods = 0
+    for ev in events:
+        if ev[0] == "wait":
+            ms = ev[1]
+            while ms > 0:
+                out += bytes((OP_WAIT, min(ms, 255)))
+                ms -= 255
+            continue
+        _, emods, usage = ev
+        if emods != mods:
+            out += bytes((OP_MODS, emods))
+            mods = emods
+        if 0 < usage < 0x80:
+            out.append(usage)
+        else:
+            out += bytes((OP_USAGE, usage))
+    out.append(OP_END)
+    return bytes(out)
+
+
+def parse_source(path):
+    macros = []
+    with open(path, encoding="utf-8") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.rstrip("\n")
+            if not line.strip() or line.lstrip().startswith("#"):
+                continue
+            if "=" not in line:
+                raise MacroError("%s:%d: expected 'name = text'" % (path, lineno))
+            name, text = line.split("=", 1)
+            macros.append((lineno, name.strip(), text.lstrip(" ")))
+    return macros
+
+
+def compile_macros(path, layout):
+    charmap = build_charmap(layout)
+    result = []
+    for lineno, name, text in parse_source(path):
+        try:
+            stream = encode(parse_text(text, charmap))
+        except MacroError as e:
+            raise MacroError("%s:%d: %s: %s" % (path, lineno, name, e))
+        result.append((name, text, stream))
+    if len(result) > 255:
+        raise MacroError("at most 255 macros fit the action's primary byte")
+    return result
+
+
+# ============================================================================
+# Compression
+# ============================================================================
+#
+# Dictionary coding over whole ops: a phrase never splits an op from its
+# operand, so operands are always read raw. Phrases may reference earlier
+# phrases up to MAX_PHRASE_DEPTH levels, which the firmware expands with a
+# fixed-size stack of (phrase pointer, bytes left) pairs.
+
+
+def split_units(stream):
+    """Split a plain stream into ops, keeping operands with their opcode."""
+    units = []
+    i = 0
+    while i < len(stream):
+        n = 2 if stream[i] in (OP_MODS, OP_WAIT, OP_USAGE) else 1
+        units.append(bytes(stream[i:i + n]))
+        i += n
+    return units
+
+
+def _token_size(t):
+    return 1 if isinstance(t, int) else len(t)
+
+
+def _candidates(seqs):
+    """Uses of every candidate phrase, counting only the non-overlapping
+    matches _replace() can substitute (left to right)."""
+    counts = {}
+    for seq in seqs:
+        free_at = {}  # Per phrase: first position after its last counted match
+        for i in range(len(seq)):
+            for j in range(i + 1, min(i + MAX_PHRASE_UNITS, len(seq))):
+                key = tuple(seq[i:j + 1])
+                if i >= free_at.get(key, 0):
+                    free_at[key] = j + 1
+                    counts[key] = counts.get(key, 0) + 1
+    return counts
+
+
+def _replace(seq, phrase, index):
+    out = []
+    i = 0
+    n = len(phrase)
+    hits = 0
+    while i < len(seq):
+        if tuple(seq[i:i + n]) == phrase:
+            out.append(index)
+            i += n
+            hits += 1
+        else:
+            out.append(seq[i])
+            i += 1
+    return out, hits
+
+
+def compress(streams, max_phrases=MAX_PHRASES, max_depth=MAX_PHRASE_DEPTH):
+    """Greedy phrase selection. Returns (stored streams, phrase list)."""
+    seqs = [split_units(s) for s in streams]
+    phrases = []
+    depth = []
+    while len(phrases) < max_phrases:
+        best, best_gain, best_depth = None, 0, 0
+        for key, count in _candidates(seqs).items():
+            d = 1 + max([depth[t] for t in key if isinstance(t, int)] + [0])
+            if d > max_depth:
+                continue
+            size = sum(_token_size(t) for t in key)
+            # Each use saves size-1 bytes; the phrase costs its bytes plus
+            # a 2-byte offset entry
+            gain = count * (size - 1) - size - 2
+            if gain > best_gain:
+                best, best_gain, best_depth = key, gain, d
+        if best is None:
+            break
+        trial = [_replace(seq, best, len(phrases)) for seq in seqs]
+        seqs = [t[0] for t in trial]
+        phrases.append(best)
+        depth.append(best_depth)
+
+    def pack(tokens):
+        return b"".join(bytes((OP_PHRASE_FIRST + t,)) if isinstance(t, int) else t
+                        for t in tokens)
+
+    return [pack(seq) for seq in seqs], [pack(ph) for ph in phrases]
+
+
+def expand(stored, phrases):
+    """Reference decoder (mirrors macro.c) used to verify the output."""
+    out = bytearray()
+    i = 0
+    while i < len(stored):
+        b = stored[i]
+        i += 1
+        if OP_PHRASE_FIRST <= b <= OP_PHRASE_LAST:
+            out += expand(phrases[b - OP_PHRASE_FIRST], phrases)
+            continue
+        out.append(b)
+        if b in (OP_MODS, OP_WAIT, OP_USAGE):
+            out.append(stored[i])
+            i += 1
+    return bytes(out)
+
+
+# ============================================================================
+# Output
+# ============================================================================
+
+
+def c_array(data, indent="    ", per_line=12):
+    lines = []
+    for i in range(0, len(data), per_line):
+        lines.append(indent + ", ".join("0x%02X" % b for b in data[i:i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def write_header(f, macros, stored, phrases, source, layout):
+    stream = b"".join(stored) or bytes((OP_END,))
+    offsets = []
+    pos = 0
+    for st in stored:
+        offsets.append(pos)
+        pos += len(st)
+    dict_offsets = [0]
+    for ph in phrases:
+        dict_offsets.append(dict_offsets[-1] + len(ph))
+    dictionary = b"".join(phrases) or bytes((OP_END,))
+
+    f.write("// Generated by tools/macro_compile.py from %s (layout: %s) - do not edit\n"
+            % (os.path.basename(source), layout))
+    f.write("//\n")
+    for i, ((name, text, s), st) in enumerate(zip(macros, stored)):
+        preview = text if len(text) <= 40 else text[:37] + "..."
+        f.write("// %3d: %-16s %3d -> %3d bytes  %s\n" % (i, name, len(s), len(st), preview))
+    f.write("\n#pragma once\n#include <stdint.h>\n\n")
+    f.write("#define MACRO_COUNT         %d\n" % len(macros))
+    f.write("#define MACRO_PHRASE_COUNT  %d\n\n" % len(phrases))
+    f.write("static __code const uint16_t MACRO_OFFSETS[%d] = {\n" % max(1, len(offsets)))
+    f.write("    " + ", ".join("%d" % o for o in (offsets or [0])) + "\n};\n\n")
+    f.write("static __code const uint8_t MACRO_STREAM[%d] = {\n" % len(stream))
+    f.write(c_array(stream) + "\n};\n\n")
+    f.write("// Phrase n = MACRO_DICT[MACRO_DICT_OFFSETS[n] .. MACRO_DICT_OFFSETS[n + 1])\n")
+    f.write("static __code const uint16_t MACRO_DICT_OFFSETS[%d] = {\n" % len(dict_offsets))
+    f.write("    " + ", ".join("%d" % o for o in dict_offsets) + "\n};\n\n")
+    f.write("static __code const uint8_t MACRO_DICT[%d] = {\n" % len(dictionary))
+    f.write(c_array(dictionary) + "\n};\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("source", nargs="?", help="macro source file")
+    ap.add_argument("-o", "--output", help="generated header (e.g. macro_data.h)")
+    ap.add_argument("-l", "--layout", default="us", choices=sorted(LAYOUTS),
+                    help="host OS keyboard layout (default: us)")
+    ap.add_argument("--show", action="store_true", help="print the compiled streams")
+    ap.add_argument("--no-compress", action="store_true",
+                    help="store plain streams without a phrase dictionary")
+    ap.add_argument("--list-layouts", action="store_true")
+    args = ap.parse_args()
+
+    if args.list_layouts:
+        for name in sorted(LAYOUTS):
+            print("%s  (%d characters)" % (name, len(build_charmap(name))))
+        return 0
+    if not args.source:
+        ap.error("source file required")
+
+    try:
+        macros = compile_macros(args.source, args.layout)
+    except (MacroError, OSError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    plain = [m[2] for m in macros]
+    if args.no_compress:
+        stored, phrases = plain, []
+    else:
+        stored, phrases = compress(plain)
+    for p, st in zip(plain, stored):
+        assert expand(st, phrases) == p, "compressor round-trip failed"
+
+    if args.show or not args.output:
+        for i, ((name, text, s), st) in enumerate(zip(macros, stored)):
+            print("%3d %-16s %3d bytes: %s" % (i, name, len(st), st.hex(" ")))
+        for i, ph in enumerate(phrases):
+            print("  phrase 0x%02X: %s" % (OP_PHRASE_FIRST + i, ph.hex(" ")))
+
+    text_len = sum(len(m[1]) for m in macros)
+    plain_len = sum(len(p) for p in plain)
+    stored_len = sum(len(st) for st in stored) + sum(len(p) for p in phrases) + \
+        2 * (len(phrases) + 1 if phrases else 0)
+    print("%d macro(s) (layout %s): %d text chars, %d plain bytes, %d stored bytes "
+          "(%d phrases, %.2fx)" % (len(macros), args.layout, text_len, plain_len,
+                                    stored_len, len(phrases),
+                                    plain_len / stored_len if stored_len else 1.0),
+          file=sys.stderr)
+
+    if args.output:
+        with open(args.output, "w", newline="\n") as f:
+            write_header(f, macros, stored, phrases, args.source, args.layout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
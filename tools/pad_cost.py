@@ -0,0 +1,411 @@
+#!/usr/bin/env python3
+"""
+Static cost analyser for CH552G Mini Keyboard profiles.
+
+Walks every configured action the way executeAction() in
+ch552g_mini_keyboard.ino does and reports, per slot and input:
+
+  reports    HID reports the action sends (press and release together)
+  blocks     longest time one executeAction() call keeps the main loop busy.
+             Every report waits for EP1 to be free (one host poll, 1 ms by
+             the endpoint descriptor, 10 ms in builds without fast-poll)
+             and delay() calls add to that. The input scan does not run
+             during this time.
+  sched      time the action keeps running afterwards from the HID task
+             (hold-mode mouse state, macro playback). It does not block.
+  flash      DataFlash bytes the action changes relative to --against
+
+An action is flagged "late" when it blocks longer than the input task's
+2 ms deadline (GET_STATS counts a miss), and "STARVES" when it blocks longer
+than --starve-ms: a tap on another key that is shorter than that is lost,
+and encoder steps during the block are missed. The exit status is 1 when
+any action starves the scan, so a profile can be checked before it is
+written to a pad.
+
+Scroll actions are counted at one wheel unit per line, 127 lines per report.
+A hires-scroll build whose host has enabled the Resolution Multiplier sends
+8 units per line (HID_SCROLL_RESOLUTION), so only 15 lines fit in a report;
+pass --hires-scroll for that case.
+
+Profiles are read as saved by the PC app (JSON), as a DataFlash image
+(128 bytes, starting with magic 0x55AA), or as a bare action table (the
+READ_CONFIG image, slots x inputs x 8 bytes).
+
+Usage:
+    pad_cost.py profile.json
+    pad_cost.py profile.json --against device.bin      flash impact of a write
+    pad_cost.py image.bin --macros macros.txt --layout de
+    pad_cost.py profile.json --hires-scroll             hires-scroll build
+"""
+
+import argparse
+import json
+import sys
+
+import macro_compile
+
+# Action layout (must match ch552g_mini_keyboard.ino)
+ACTION_SIZE = 8
+ACTION_NONE = 0x0
+ACTION_KEYBOARD = 0x1
+ACTION_MEDIA = 0x2
+ACTION_MOUSE = 0x3
+ACTION_SCROLL = 0x4
+ACTION_MACRO = 0x5
+ACTION_HOST = 0x6
+ACTION_SCRIPT = 0x7
+HOLD_FLAG = 0x08
+MODIFIER_BITS = (0x10, 0x40, 0x20, 0x80)  # Ctrl, Shift, Alt, Gui
+
+TYPE_NAMES = {
+    ACTION_NONE: "None",
+    ACTION_KEYBOARD: "Keyboard",
+    ACTION_MEDIA: "Media",
+    ACTION_MOUSE: "Mouse",
+    ACTION_SCROLL: "Scroll",
+    ACTION_MACRO: "Macro",
+    ACTION_HOST: "Host",
+    ACTION_SCRIPT: "Script",
+}
+MODIFIER_NAMES = {"ctrl": 0x10, "alt": 0x20, "shift": 0x40, "gui": 0x80}
+
+CONFIG_MAGIC = b"\xaa\x55"  # 0x55AA, little endian
+CONFIG_HEADER = 8
+DATAFLASH_SIZE = 128
+FLASH_BYTES_PER_RUN = 8     # TASK_FLASH
+MARKER_WRITES = 2           # Write marker cleared first, set last
+INPUT_DEADLINE_MS = 2       # TASK_INPUT
+WHEEL_PER_REPORT = 127
+SCROLL_RESOLUTION = 8       # Wheel units per line with hires-scroll
+
+INPUT_NAMES = ("BTN 1", "BTN 2", "BTN 3", "ENC CW", "ENC CCW")
+
+
+class CostError(Exception):
+    pass
+
+
+# ============================================================================
+# Profile Loading
+# ============================================================================
+
+def _field(obj, name, default=None):
+    """Case-insensitive property lookup (the app reads JSON that way)."""
+    for key, value in obj.items():
+        if key.lower() == name.lower():
+            return value
+    return default
+
+
+def _action_from_json(data):
+    name = str(_field(data, "Type", "None")).lower()
+    types = {v.lower(): k for k, v in TYPE_NAMES.items()}
+    if name not in types:
+        raise CostError("unknown action type %r" % name)
+    control = types[name]
+    for mod in _field(data, "Modifiers", []) or []:
+        control |= MODIFIER_NAMES.get(str(mod).lower(), 0)
+    if _field(data, "HoldEnabled", False):
+        control |= HOLD_FLAG
+    action = bytearray(ACTION_SIZE)
+    action[0] = control
+    action[1] = int(_field(data, "PrimaryValue", 0)) & 0xFF
+    action[2] = int(_field(data, "SecondaryValue", 0)) & 0xFF
+    action[3] = int(_field(data, "ColorIdle", 0)) & 0xFF
+    action[4] = int(_field(data, "ColorActive", 0)) & 0xFF
+    return bytes(action)
+
+
+def load_profile(path, inputs):
+    """Return (slot names, [[8-byte action per input] per slot])."""
+    with open(path, "rb") as f:
+        raw = f.read()
+
+    if raw.lstrip()[:1] == b"{":
+        try:
+            profile = json.loads(raw.decode("utf-8-sig"))
+        except ValueError as e:
+            raise CostError("%s: %s" % (path, e))
+        names, slots = [], []
+        for slot in _field(profile, "Slots", []):
+            names.append(_field(slot, "Name", "") or "")
+            slots.append([_action_from_json(a) for a in _field(slot, "Actions", [])])
+        return names, slots
+
+    if raw[:2] == CONFIG_MAGIC and len(raw) >= CONFIG_HEADER + inputs * ACTION_SIZE:
+        raw = raw[CONFIG_HEADER:]
+    slot_bytes = inputs * ACTION_SIZE
+    if not raw or len(raw) % slot_bytes:
+        raise CostError("%s: %d bytes is not a DataFlash image or an action table "
+                        "of %d-input slots" % (path, len(raw), inputs))
+    slots = []
+    for s in range(len(raw) // slot_bytes):
+        base = s * slot_bytes
+        slots.append([raw[base + i * ACTION_SIZE:base + (i + 1) * ACTION_SIZE]
+                      for i in range(inputs)])
+    return ["" for _ in slots], slots
+
+
+def load_macros(path, layout):
+    """Plain (uncompressed) stream per macro index."""
+    try:
+        return [m[2] for m in macro_compile.compile_macros(path, layout)]
+    except (macro_compile.MacroError, OSError) as e:
+        raise CostError(str(e))
+
+
+# ============================================================================
+# Cost Model
+# ============================================================================
+#
+# A call is a list of steps, mirroring executeAction():
+#   "send"      USB_EP1_send(): waits until EP1 is free, loads the report
+#   ("delay", n) delay(n)
+#   "task"      report left to the HID task (Mouse_flush), non-blocking
+
+
+def _modifier_count(control):
+    return sum(1 for bit in MODIFIER_BITS if control & bit)
+
+
+def action_calls(action, wheel_units=1):
+    """Return (press steps, release steps or None) for one action;
+    wheel_units is what one scrolled line adds to the wheel axis."""
+    control, primary, secondary = action[0], action[1], action[2]
+    kind = control & 0x07
+    hold = bool(control & HOLD_FLAG)
+    mods = ["send"] * _modifier_count(control)
+
+    if kind == ACTION_KEYBOARD:
+        press = list(mods)
+        if primary:
+            press.append("send")
+        if not hold:
+            press += [("delay", 1), "send"]  # releaseAll
+        return press, (["send"] if hold else None)
+
+    if kind == ACTION_MEDIA:
+        if hold:
+            return mods + ["send"], ["send", "send"]
+        return mods + ["send", ("delay", 10), "send", "send"], None
+
+    if kind == ACTION_MOUSE:
+        if hold:
+            return mods + ["task"], ["send", "send"]
+        press = list(mods)
+        clicks = secondary or 1
+        for c in range(clicks):
+            press += ["send", ("delay", 50), "send"]
+            if c < clicks - 1:
+                press.append(("delay", 100))
+        return press + ["send"], None
+
+    if kind == ACTION_SCROLL:
+        if hold:
+            return mods + ["task"], ["send"]
+        lines = secondary or 1
+        wheel = -(-lines * wheel_units // WHEEL_PER_REPORT)
+        return mods + ["send"] * wheel + ["send"], None
+
+    if kind == ACTION_HOST:
+        return ["send"], (["send"] if hold else None)
+
+    if kind == ACTION_SCRIPT:
+        return [], (["send"] if hold else None)  # Script_stop() releases
+
+    return [], None  # None, and Macro only starts the player
+
+
+def run_call(steps, poll_ms):
+    """(blocking ms, reports sent, reports left to the HID task).
+    Worst case: a loaded report leaves with the poll one interval later."""
+    t = 0
+    free_at = 0
+    sent = deferred = 0
+    for step in steps:
+        if step == "send":
+            t = max(t, free_at)
+            free_at = t + poll_ms
+            sent += 1
+        elif step == "task":
+            deferred += 1
+        else:
+            t += step[1]
+    return t, sent, deferred
+
+
+def macro_cost(stream, poll_ms):
+    """(reports, playback ms) of a plain macro stream. Macro_task sends one
+    report per EP1 poll: key down and key up per TAP, one release at the end."""
+    taps = wait = 0
+    i = 0
+    while i < len(stream):
+        op = stream[i]
+        if op == macro_compile.OP_END:
+            break
+        if op in (macro_compile.OP_MODS, macro_compile.OP_WAIT, macro_compile.OP_USAGE):
+            if op == macro_compile.OP_WAIT:
+                wait += stream[i + 1]
+            elif op == macro_compile.OP_USAGE:
+                taps += 1
+            i += 2
+            continue
+        taps += 1
+        i += 1
+    reports = 2 * taps + 1
+    return reports, reports * poll_ms + wait
+
+
+def describe(action):
+    control, primary, secondary = action[0], action[1], action[2]
+    kind = control & 0x07
+    name = TYPE_NAMES.get(kind, "Type %d" % kind)
+    if kind == ACTION_NONE:
+        return name
+    mods = [n.capitalize() for n, bit in sorted(MODIFIER_NAMES.items(),
+                                                key=lambda m: m[1]) if control & bit]
+    if kind == ACTION_KEYBOARD:
+        value = "'%s'" % chr(primary) if 32 < primary < 127 else "0x%02X" % primary
+    elif kind == ACTION_MEDIA:
+        value = "0x%04X" % (secondary << 8 | primary)
+    elif kind == ACTION_MOUSE:
+        value = "btn 0x%02X x%d" % (primary, secondary or 1)
+    elif kind == ACTION_SCROLL:
+        value = "%s %d" % ("up" if primary == 0 else "down", secondary or 1)
+    elif kind in (ACTION_MACRO, ACTION_SCRIPT):
+        value = "#%d" % primary
+    else:
+        value = "event"
+    text = "+".join(mods + ["%s %s" % (name, value)])
+    return text + (" (hold)" if control & HOLD_FLAG else "")
+
+
+def analyse(action, args, macros):
+    """Cost of one action as a dict."""
+    wheel_units = SCROLL_RESOLUTION if args.hires_scroll else 1
+    press, release = action_calls(action, wheel_units)
+    block = sched = reports = 0
+    notes = []
+    for steps in (press, release):
+        if steps is None:
+            continue
+        t, sent, deferred = run_call(steps, args.poll_ms)
+        block = max(block, t)
+        reports += sent + deferred
+        sched += deferred * args.poll_ms
+
+    if action[0] & 0x07 == ACTION_MACRO:
+        if macros is None:
+            notes.append("macro cost needs --macros")
+            reports = sched = None
+        elif action[1] >= len(macros):
+            notes.append("macro #%d not compiled in, ignored" % action[1])
+        else:
+            reports, sched = macro_cost(macros[action[1]], args.poll_ms)
+    elif action[0] & 0x07 == ACTION_SCRIPT:
+        notes.append("script runs from the HID task")
+        reports = sched = None
+
+    if block > args.starve_ms:
+        notes.insert(0, "STARVES")
+    elif block > INPUT_DEADLINE_MS:
+        notes.insert(0, "late")
+    return {"reports": reports, "block": block, "sched": sched, "notes": notes}
+
+
+# ============================================================================
+# Report
+# ============================================================================
+
+def flash_changes(old, new):
+    return sum(1 for a, b in zip(old, new) if a != b)
+
+
+def print_report(names, slots, baseline, args, macros):
+    starving = 0
+    changed_actions = changed_bytes = 0
+
+    print("%-4s %-8s %-30s %7s %8s %8s %5s  %s"
+          % ("slot", "input", "action", "reports", "blocks", "sched", "flash", "flags"))
+    for s, actions in enumerate(slots):
+        if s < len(names) and names[s]:
+            print("# slot %d: %s" % (s, names[s]))
+        for i, action in enumerate(actions):
+            cost = analyse(action, args, macros)
+            if "STARVES" in cost["notes"]:
+                starving += 1
+
+            flash = "-"
+            if baseline is not None:
+                old = bytes(ACTION_SIZE)
+                if s < len(baseline) and i < len(baseline[s]):
+                    old = baseline[s][i]
+                n = flash_changes(old, action)
+                flash = str(n)
+                changed_bytes += n
+                changed_actions += 1 if n else 0
+
+            if action[0] & 0x07 == ACTION_NONE and flash in ("-", "0"):
+                continue
+            print("%-4d %-8s %-30s %7s %6d ms %5s ms %5s  %s"
+                  % (s, INPUT_NAMES[i] if i < len(INPUT_NAMES) else "IN %d" % i,
+                     describe(action)[:30],
+                     "?" if cost["reports"] is None else cost["reports"],
+                     cost["block"],
+                     "?" if cost["sched"] is None else cost["sched"],
+                     flash, ", ".join(cost["notes"])))
+
+    print()
+    print("EP1 poll %d ms; 'late' blocks > %d ms (input task deadline), "
+          "'STARVES' blocks > %d ms" % (args.poll_ms, INPUT_DEADLINE_MS, args.starve_ms))
+    if baseline is not None:
+        if changed_bytes:
+            # Checksum byte and the write marker come with every commit
+            written = changed_bytes + 1 + MARKER_WRITES
+            runs = -(-DATAFLASH_SIZE // FLASH_BYTES_PER_RUN)
+            print("write: %d action(s) changed (%d WRITE_ACTION transactions), "
+                  "commit writes up to %d DataFlash bytes in %d flash task runs"
+                  % (changed_actions, changed_actions, written, runs))
+        else:
+            print("write: no action changes, no DataFlash commit")
+    if starving:
+        print("%d action(s) block input scanning for longer than %d ms"
+              % (starving, args.starve_ms), file=sys.stderr)
+    return starving
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("profile", help="profile JSON, DataFlash image or action table")
+    ap.add_argument("--against", metavar="FILE",
+                    help="profile or image on the device, for the flash impact")
+    ap.add_argument("--inputs", type=int, default=len(INPUT_NAMES),
+                    help="inputs per slot in binary images (default: %(default)s)")
+    ap.add_argument("--poll-ms", type=int, default=1,
+                    help="EP1 polling interval (default: %(default)s, the "
+                         "descriptor value; 10 without fast-poll)")
+    ap.add_argument("--hires-scroll", action="store_true",
+                    help="firmware built with hires-scroll and the host enabled "
+                         "the multiplier: one line is %d wheel units" % SCROLL_RESOLUTION)
+    ap.add_argument("--starve-ms", type=int, default=30,
+                    help="blocking time that starves the scan (default: %(default)s)")
+    ap.add_argument("--macros", metavar="FILE", help="macro source compiled into the firmware")
+    ap.add_argument("-l", "--layout", default="us", choices=sorted(macro_compile.LAYOUTS),
+                    help="layout the macros were compiled for (default: us)")
+    args = ap.parse_args()
+
+    try:
+        names, slots = load_profile(args.profile, args.inputs)
+        baseline = None
+        if args.against:
+            baseline = load_profile(args.against, args.inputs)[1]
+        macros = load_macros(args.macros, args.layout) if args.macros else None
+    except (CostError, OSError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 2
+
+    return 1 if print_report(names, slots, baseline, args, macros) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
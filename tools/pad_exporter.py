@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""
+Telemetry exporter for CH552G Mini Keyboards (node_exporter textfile).
+
+Keeps one hidraw handle open per pad and polls GET_DIAG at a low rate: a
+single 64-byte Feature Report transaction per pad per interval returns every
+counter (loop passes, dropped reports, flash commits, encoder errors, task
+latency, deadline misses and the stack high-water mark). The results go to
+a file in the Prometheus text format, written atomically, for the
+node_exporter textfile collector.
+
+Pads are rediscovered through sysfs every --rescan polls or as soon as one
+fails, so hot-plugging needs no restart. Between polls the daemon sleeps;
+the device sees one config command per interval.
+
+Usage:
+    pad_exporter.py [--interval 30] [--output FILE]
+    pad_exporter.py --once --output -       print one scrape and exit
+
+Example systemd service:
+    [Service]
+    ExecStart=/usr/bin/python3 /opt/ch552pad/pad_exporter.py
+    Restart=always
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+from ch552pad import CMD_GET_DIAG, Pad, PadError, find_pads
+
+DEFAULT_OUTPUT = "/var/lib/node_exporter/textfile_collector/ch552pad.prom"
+
+TASK_NAMES = ("input", "hid", "config", "led", "flash")  # ch552g_mini_keyboard.ino
+STACK_TOP = 0xFF  # stack.h
+
+
+# ============================================================================
+# Per-pad State
+# ============================================================================
+
+class Monitor:
+    """Open handle plus what is needed to turn device counters into
+    monotonic host counters (32-bit wrap, resets after a power cycle)."""
+
+    def __init__(self, path, serial, phys):
+        self.pad = Pad(path)
+        self.label = serial or phys
+        try:
+            info = self.pad.info()
+        except PadError:
+            self.pad.close()
+            raise
+        self.firmware = info["version"]
+        self.slots = info["slots"]
+        self.inputs = info["inputs"]
+        self.last = None        # (millis, passes) from the previous poll
+        self.passes_total = 0
+        self.sample = None
+
+    def close(self):
+        self.pad.close()
+
+    def poll(self):
+        r = self.pad.request(CMD_GET_DIAG, b"\x01")  # Read and clear the latency max
+        millis, passes = struct.unpack_from("<II", r, 4)
+        drops, commits, enc_errors = struct.unpack_from("<HHH", r, 12)
+        latency = r[18]
+        tasks = r[19]
+        misses = list(r[20:20 + tasks])
+        reversals = oversample = None
+        if r[3] >= 2:  # DIAG_VERSION 2: encoder filter counters after the misses
+            reversals = struct.unpack_from("<H", r, 20 + tasks)[0]
+            oversample = r[22 + tasks]
+        stack_used = stack_free = None
+        if r[3] >= 3:  # DIAG_VERSION 3: stack base and high-water address
+            stack_used = r[24 + tasks] - r[23 + tasks] + 1
+            stack_free = STACK_TOP - r[24 + tasks]
+
+        period_us = None
+        if self.last is not None and millis >= self.last[0]:
+            d_passes = (passes - self.last[1]) & 0xFFFFFFFF
+            self.passes_total += d_passes
+            if d_passes:
+                period_us = (millis - self.last[0]) * 1000.0 / d_passes
+        elif self.last is not None:
+            self.passes_total += passes  # Pad restarted since the last poll
+        self.last = (millis, passes)
+
+        self.sample = {
+            "uptime": millis / 1000.0,
+            "period_us": period_us,
+            "drops": drops,
+            "commits": commits,
+            "enc_errors": enc_errors,
+            "latency": latency,
+            "misses": misses,
+            "reversals": reversals,
+            "oversample": oversample,
+            "stack_used": stack_used,
+            "stack_free": stack_free,
+        }
+
+
+# ============================================================================
+# Prometheus Text Output
+# ============================================================================
+
+# Counter names carry the _total suffix in TYPE and HELP too: the textfile
+# collector does not map name_total samples to a family called name
+METRICS = (
+    ("ch552pad_up", "gauge", "1 if the last poll succeeded"),
+    ("ch552pad_info", "gauge", "Firmware and config layout"),
+    ("ch552pad_uptime_seconds", "gauge", "Time since the pad powered up"),
+    ("ch552pad_loop_passes_total", "counter", "Main loop passes"),
+    ("ch552pad_loop_period_microseconds", "gauge", "Average main loop pass since the last poll"),
+    ("ch552pad_report_drops_total", "counter", "HID reports the pad gave up sending"),
+    ("ch552pad_flash_commits_total", "counter", "Completed DataFlash config commits"),
+    ("ch552pad_encoder_errors_total", "counter", "Illegal encoder transitions"),
+    ("ch552pad_encoder_reversals_total", "counter", "Encoder quarter steps against the previous one"),
+    ("ch552pad_encoder_oversampling", "gauge", "1 while the encoders are sampled every loop pass"),
+    ("ch552pad_task_latency_max_milliseconds", "gauge", "Worst task start delay since the last poll"),
+    ("ch552pad_task_deadline_misses_total", "counter", "Task runs that started after their deadline"),
+    ("ch552pad_stack_used_bytes", "gauge", "Deepest stack use since power-up"),
+    ("ch552pad_stack_free_bytes", "gauge", "Stack bytes never used since power-up"),
+)
+
+
+def _escape(v):
+    return str(v).replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+
+
+def render(monitors, failed):
+    samples = {name: [] for name, _, _ in METRICS}
+
+    def add(name, labels, value):
+        text = ",".join('%s="%s"' % (k, _escape(v)) for k, v in labels)
+        samples[name].append("%s{%s} %s" % (name, text, value))
+
+    for m in monitors:
+        pad = (("pad", m.label),)
+        s = m.sample
+        add("ch552pad_up", pad, 1 if s else 0)
+        add("ch552pad_info", pad + (("firmware", m.firmware), ("slots", m.slots),
+                                    ("inputs", m.inputs)), 1)
+        if not s:
+            continue
+        add("ch552pad_uptime_seconds", pad, "%.3f" % s["uptime"])
+        add("ch552pad_loop_passes_total", pad, m.passes_total)
+        if s["period_us"] is not None:
+            add("ch552pad_loop_period_microseconds", pad, "%.2f" % s["period_us"])
+        add("ch552pad_report_drops_total", pad, s["drops"])
+        add("ch552pad_flash_commits_total", pad, s["commits"])
+        add("ch552pad_encoder_errors_total", pad, s["enc_errors"])
+        if s["reversals"] is not None:
+            add("ch552pad_encoder_reversals_total", pad, s["reversals"])
+            add("ch552pad_encoder_oversampling", pad, s["oversample"])
+        add("ch552pad_task_latency_max_milliseconds", pad, s["latency"])
+        for t, n in enumerate(s["misses"]):
+            name = TASK_NAMES[t] if t < len(TASK_NAMES) else str(t)
+            add("ch552pad_task_deadline_misses_total", pad + (("task", name),), n)
+        if s["stack_used"] is not None:
+            add("ch552pad_stack_used_bytes", pad, s["stack_used"])
+            add("ch552pad_stack_free_bytes", pad, s["stack_free"])
+    for label in failed:
+        add("ch552pad_up", (("pad", label),), 0)
+
+    out = []
+    for name, kind, help_text in METRICS:
+        if samples[name]:
+            out.append("# HELP %s %s" % (name, help_text))
+            out.append("# TYPE %s %s" % (name, kind))
+            out.extend(samples[name])
+    return "\n".join(out) + "\n"
+
+
+def write_atomic(path, text):
+    if path == "-":
+        sys.stdout.write(text)
+        return
+    tmp = "%s.%d.tmp" % (path, os.getpid())
+    with open(tmp, "w") as f:
+        f.write(text)
+    os.replace(tmp, path)  # node_exporter never sees a partial file
+
+
+# ============================================================================
+# Main Loop
+# ============================================================================
+
+def rescan(monitors):
+    known = set(m.pad.path for m in monitors.values())
+    for path, serial, phys in find_pads():
+        if path in known:
+            continue
+        try:
+            monitors[path] = Monitor(path, serial, phys)
+        except (OSError, PadError) as e:
+            print("%s: %s" % (path, e), file=sys.stderr)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("--interval", type=float, default=30.0, help="seconds between polls")
+    ap.add_argument("--rescan", type=int, default=10,
+                    help="look for new pads every N polls (default 10)")
+    ap.add_argument("-o", "--output", default=DEFAULT_OUTPUT, help="textfile path or -")
+    ap.add_argument("--once", action="store_true", help="poll once and exit")
+    args = ap.parse_args()
+
+    monitors = {}
+    polls = 0
+    next_poll = time.monotonic()
+    while True:
+        if polls % args.rescan == 0:
+            rescan(monitors)
+        polls += 1
+
+        failed = []
+        for path, m in list(monitors.items()):
+            try:
+                m.poll()
+            except (OSError, PadError) as e:
+                # Unplugged or wedged: drop the handle, reopen on the next rescan
+                print("%s: %s" % (path, e), file=sys.stderr)
+                failed.append(m.label)
+                m.close()
+                del monitors[path]
+                polls = 0
+        try:
+            write_atomic(args.output, render(monitors.values(), failed))
+        except OSError as e:
+            print("%s: %s" % (args.output, e), file=sys.stderr)
+
+        if args.once:
+            return 0
+        next_poll += args.interval
+        time.sleep(max(0.0, next_poll - time.monotonic()))
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except KeyboardInterrupt:
+        sys.exit(0)
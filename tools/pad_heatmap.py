@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+Input usage heatmap for CH552G Mini Keyboards.
+
+The firmware counts activations per slot and input in RAM (GET_COUNTERS).
+`collect` drains those counters from every connected pad (read and clear) and
+adds them to a JSON store, so nothing is counted twice and a power cycle only
+loses what was not collected yet. Run it periodically, e.g. from cron or a
+systemd timer on each workstation.
+
+`show` prints the heatmap of one or more stores (copy the stores of many
+workstations together to aggregate a team), `suggest` ranks the key actions
+of each slot by use and proposes which key each should sit on, given a cost
+per key (lower = faster to reach / fewer conflicts).
+
+Usage:
+    pad_heatmap.py collect [--store FILE]
+    pad_heatmap.py show [STORE ...] [--encoders M]
+    pad_heatmap.py suggest [STORE ...] --key-cost 0,1,1
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+from ch552pad import Pad, PadError, find_pads
+
+DEFAULT_STORE = os.path.join(os.path.expanduser("~"), ".local", "share",
+                             "ch552pad", "heatmap.json")
+BAR_WIDTH = 30
+
+
+# ============================================================================
+# Store
+# ============================================================================
+
+def load_store(path):
+    try:
+        with open(path) as f:
+            return json.load(f)
+    except FileNotFoundError:
+        return {"pads": {}}
+
+
+def save_store(path, store):
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    tmp = path + ".tmp"
+    with open(tmp, "w") as f:
+        json.dump(store, f, indent=1, sort_keys=True)
+    os.replace(tmp, path)
+
+
+def collect(store):
+    """Drain all connected pads into the store, return the number read."""
+    host = os.uname().nodename
+    read = 0
+    for path, serial, phys in find_pads():
+        key = "%s/%s" % (host, serial or phys)
+        try:
+            with Pad(path) as pad:
+                slots, inputs, _, counts = pad.counters(clear=True)
+        except (OSError, PadError) as e:
+            print("%s: %s" % (path, e), file=sys.stderr)
+            continue
+        entry = store["pads"].setdefault(key, {"slots": slots, "inputs": inputs,
+                                               "counts": [0] * (slots * inputs)})
+        if entry["slots"] != slots or entry["inputs"] != inputs:
+            # Firmware with a different layout - start a new record
+            entry.update(slots=slots, inputs=inputs, counts=[0] * (slots * inputs))
+        entry["counts"] = [a + b for a, b in zip(entry["counts"], counts)]
+        entry["last_seen"] = int(time.time())
+        read += 1
+    return read
+
+
+def aggregate(stores):
+    """Sum all pads with the same layout: {(slots, inputs): [counts]}."""
+    total = {}
+    for store in stores:
+        for entry in store["pads"].values():
+            layout = (entry["slots"], entry["inputs"])
+            acc = total.setdefault(layout, [0] * (layout[0] * layout[1]))
+            total[layout] = [a + b for a, b in zip(acc, entry["counts"])]
+    return total
+
+
+# ============================================================================
+# Input Names
+# ============================================================================
+
+def input_names(inputs, encoders):
+    """Names in firmware input order: keys, ENC CW/CCW, then CW/CCW/PRESS."""
+    keys = inputs - (3 * encoders - 1)
+    if keys < 0:
+        return ["IN%d" % i for i in range(inputs)], 0
+    names = ["KEY%d" % k for k in range(keys)] + ["ENC CW", "ENC CCW"]
+    for e in range(1, encoders):
+        names += ["ENC%d CW" % e, "ENC%d CCW" % e, "ENC%d PRESS" % e]
+    return names, keys
+
+
+# ============================================================================
+# Output
+# ============================================================================
+
+def show(total, encoders):
+    for (slots, inputs), counts in sorted(total.items()):
+        names, _ = input_names(inputs, encoders)
+        print("Layout: %d slots x %d inputs" % (slots, inputs))
+        peak = max(counts) or 1
+        grand = sum(counts) or 1
+        for s in range(slots):
+            row = counts[s * inputs:(s + 1) * inputs]
+            print("\n  Slot %d  (%d activations)" % (s, sum(row)))
+            for name, n in zip(names, row):
+                bar = "#" * (n * BAR_WIDTH // peak)
+                print("    %-12s %8d %5.1f%%  %s" % (name, n, 100.0 * n / grand, bar))
+        print()
+
+
+def suggest(total, encoders, costs):
+    for (slots, inputs), counts in sorted(total.items()):
+        names, keys = input_names(inputs, encoders)
+        if len(costs) != keys:
+            print("layout %dx%d has %d keys, --key-cost lists %d"
+                  % (slots, inputs, keys, len(costs)), file=sys.stderr)
+            continue
+        by_cost = sorted(range(keys), key=lambda k: (costs[k], k))
+        for s in range(slots):
+            row = counts[s * inputs:s * inputs + keys]
+            by_use = sorted(range(keys), key=lambda k: (-row[k], k))
+            moves = [(src, dst) for src, dst in zip(by_use, by_cost) if src != dst]
+            print("Slot %d:%s" % (s, "" if moves else " keep"))
+            for src, dst in moves:
+                print("  %s action (%d uses) -> %s (cost %s)"
+                      % (names[src], row[src], names[dst], costs[dst]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    c = sub.add_parser("collect", help="drain counters from all pads into the store")
+    c.add_argument("--store", default=DEFAULT_STORE)
+    for name in ("show", "suggest"):
+        p = sub.add_parser(name)
+        p.add_argument("stores", nargs="*", help="stores to aggregate (default: local)")
+        p.add_argument("--encoders", type=int, default=1,
+                       help="encoders on the board, for input names (default 1)")
+        if name == "suggest":
+            p.add_argument("--key-cost", required=True,
+                           help="comma-separated cost per key, lowest = best position")
+    args = ap.parse_args()
+
+    if args.cmd == "collect":
+        store = load_store(args.store)
+        n = collect(store)
+        save_store(args.store, store)
+        print("collected %d pad(s) into %s" % (n, args.store), file=sys.stderr)
+        return 0 if n else 1
+
+    total = aggregate([load_store(p) for p in (args.stores or [DEFAULT_STORE])])
+    if not total:
+        print("no data - run 'pad_heatmap.py collect' first", file=sys.stderr)
+        return 1
+    if args.cmd == "show":
+        show(total, args.encoders)
+    else:
+        suggest(total, args.encoders, [float(x) for x in args.key_cost.split(",")])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,318 @@
+#!/usr/bin/env python3
+"""
+Host executor for CH552G Mini Keyboard Host actions (Linux, uinput).
+
+An input configured as a Host action (type 0x6, firmware built with the
+host-events descriptor feature) sends no keystroke. Instead it sends vendor
+input report 0xF1 with its slot, input, edge and a sequence byte. This daemon
+reads those reports from every connected pad's hidraw node and runs the
+action mapped to (slot, input) on a virtual uinput keyboard. Actions live on
+the host, so there is no limit on their number or length and they cost no
+device flash.
+
+Action map (JSON). Each key is "slot/input" and each value is a list of
+steps run on the press edge, or {"press": [...], "release": [...]}. Release
+edges are only sent for actions with the hold flag set.
+
+    {
+      "0/0": [{"keys": "ctrl+shift+m"}],
+      "0/1": {"press": [{"down": "leftctrl"}], "release": [{"up": "leftctrl"}]},
+      "1/3": [{"run": "firefox"}, {"wait": 500}, {"keys": "ctrl+t"}]
+    }
+
+Actions in the RAM overlay slot (pad_overlay.py) report the pad's slot
+count as their slot, e.g. "3/0" on the original pad.
+
+Steps:
+    {"keys": "ctrl+c"}    press the chord, then release it in reverse order
+    {"down": "shift"}     press and hold keys ...
+    {"up": "shift"}       ... and release them
+    {"wait": ms}          pause; runs the rest of the action in a thread
+    {"run": "command"}    start a command (split as by a shell), do not wait
+
+Key names are evdev names without KEY_ (a, f5, enter, leftctrl, volumeup);
+ctrl, shift, alt and gui/meta/super mean the left-hand keys.
+
+Events are dispatched from one blocking select() over the pads, so an
+action without a wait runs within a fraction of a millisecond of the
+report. Pads are picked up again when they are plugged in (rescan every
+--rescan seconds). /dev/uinput must be writable: install
+99-ch552pad-uinput.rules (opt-in, it lets the user inject input).
+
+Usage:
+    pad_hostd.py actions.json
+    pad_hostd.py actions.json --verbose
+"""
+
+import argparse
+import fcntl
+import json
+import os
+import select
+import shlex
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+from ch552pad import CAP_HOST_EVENTS, Pad, PadError, find_pads
+
+REPORT_ID_HOST_EVENT = 0xF1  # usb_descgen.py ID_HOST_EVENT
+HOST_EVENT_BYTES = 4         # Slot, input, edge, sequence
+
+UINPUT = "/dev/uinput"
+DEVICE_NAME = b"ch552pad host actions"
+
+
+# ============================================================================
+# uinput (linux/uinput.h, linux/input-event-codes.h)
+# ============================================================================
+
+def _ioc(direction, nr, size):
+    return (direction << 30) | (size << 16) | (ord("U") << 8) | nr
+
+
+_IOC_NONE, _IOC_WRITE = 0, 1
+UI_DEV_CREATE = _ioc(_IOC_NONE, 1, 0)
+UI_DEV_DESTROY = _ioc(_IOC_NONE, 2, 0)
+UI_DEV_SETUP = _ioc(_IOC_WRITE, 3, 92)   # struct uinput_setup
+UI_SET_EVBIT = _ioc(_IOC_WRITE, 100, 4)
+UI_SET_KEYBIT = _ioc(_IOC_WRITE, 101, 4)
+
+EV_SYN = 0x00
+EV_KEY = 0x01
+SYN_REPORT = 0
+BUS_USB = 0x03
+
+INPUT_EVENT = struct.Struct("llHHi")  # struct input_event (native timeval)
+
+KEYS = {
+    "esc": 1, "minus": 12, "equal": 13, "backspace": 14, "tab": 15,
+    "leftbrace": 26, "rightbrace": 27, "enter": 28, "leftctrl": 29,
+    "semicolon": 39, "apostrophe": 40, "grave": 41, "leftshift": 42,
+    "backslash": 43, "comma": 51, "dot": 52, "slash": 53, "rightshift": 54,
+    "kpasterisk": 55, "leftalt": 56, "space": 57, "capslock": 58,
+    "numlock": 69, "scrolllock": 70, "f11": 87, "f12": 88, "rightctrl": 97,
+    "sysrq": 99, "rightalt": 100, "home": 102, "up": 103, "pageup": 104,
+    "left": 105, "right": 106, "end": 107, "down": 108, "pagedown": 109,
+    "insert": 110, "delete": 111, "mute": 113, "volumedown": 114,
+    "volumeup": 115, "pause": 119, "leftmeta": 125, "rightmeta": 126,
+    "compose": 127, "calc": 140, "mail": 155, "nextsong": 163,
+    "playpause": 164, "previoussong": 165, "stopcd": 166,
+}
+KEYS.update({c: 16 + i for i, c in enumerate("qwertyuiop")})
+KEYS.update({c: 30 + i for i, c in enumerate("asdfghjkl")})
+KEYS.update({c: 44 + i for i, c in enumerate("zxcvbnm")})
+KEYS.update({str((i + 1) % 10): 2 + i for i in range(10)})
+KEYS.update({"f%d" % (i + 1): 59 + i for i in range(10)})
+KEYS.update({"f%d" % (i + 13): 183 + i for i in range(12)})
+
+ALIASES = {"ctrl": "leftctrl", "control": "leftctrl", "shift": "leftshift",
+           "alt": "leftalt", "altgr": "rightalt", "gui": "leftmeta",
+           "meta": "leftmeta", "super": "leftmeta", "win": "leftmeta",
+           "return": "enter", "escape": "esc", "del": "delete",
+           "pgup": "pageup", "pgdn": "pagedown"}
+
+
+class ActionError(Exception):
+    pass
+
+
+class VirtualKeyboard:
+    def __init__(self):
+        try:
+            self.fd = os.open(UINPUT, os.O_WRONLY | os.O_NONBLOCK)
+        except OSError as e:
+            raise ActionError("%s: %s" % (UINPUT, e.strerror))
+        fcntl.ioctl(self.fd, UI_SET_EVBIT, EV_KEY)
+        for code in set(KEYS.values()):
+            fcntl.ioctl(self.fd, UI_SET_KEYBIT, code)
+        setup = struct.pack("HHHH80sI", BUS_USB, 0x1209, 0xC55E, 1, DEVICE_NAME, 0)
+        fcntl.ioctl(self.fd, UI_DEV_SETUP, setup)
+        fcntl.ioctl(self.fd, UI_DEV_CREATE)
+        self.lock = threading.Lock()
+
+    def close(self):
+        fcntl.ioctl(self.fd, UI_DEV_DESTROY)
+        os.close(self.fd)
+
+    def keys(self, codes, value):
+        """Press (1) or release (0) keys, one EV_KEY each, then one SYN."""
+        with self.lock:
+            data = b"".join(INPUT_EVENT.pack(0, 0, EV_KEY, c, value) for c in codes)
+            os.write(self.fd, data + INPUT_EVENT.pack(0, 0, EV_SYN, SYN_REPORT, 0))
+
+
+# ============================================================================
+# Action Map
+# ============================================================================
+
+def key_codes(text):
+    codes = []
+    for name in text.lower().replace(" ", "").split("+"):
+        name = ALIASES.get(name, name)
+        if name.startswith("key_"):
+            name = name[4:]
+        if name not in KEYS:
+            raise ActionError("unknown key %r" % name)
+        codes.append(KEYS[name])
+    return codes
+
+
+def compile_steps(steps):
+    """Validate one step list, resolving key names up front."""
+    out = []
+    for step in steps:
+        if not isinstance(step, dict) or len(step) != 1:
+            raise ActionError("step must be one {kind: value}: %r" % (step,))
+        (kind, value), = step.items()
+        if kind in ("keys", "down", "up"):
+            out.append((kind, key_codes(str(value))))
+        elif kind == "wait":
+            out.append((kind, float(value) / 1000.0))
+        elif kind == "run":
+            out.append((kind, shlex.split(str(value)) if isinstance(value, str) else value))
+        else:
+            raise ActionError("unknown step %r" % kind)
+    return out
+
+
+def load_actions(path):
+    with open(path) as f:
+        try:
+            data = json.load(f)
+        except ValueError as e:
+            raise ActionError("%s: %s" % (path, e))
+    actions = {}
+    for key, value in data.items():
+        try:
+            slot, _, input_ = key.partition("/")
+            target = (int(slot), int(input_))
+        except ValueError:
+            raise ActionError("%s: key %r is not 'slot/input'" % (path, key))
+        if isinstance(value, list):
+            value = {"press": value}
+        try:
+            actions[target] = {edge: compile_steps(value.get(edge, []))
+                               for edge in ("press", "release")}
+        except ActionError as e:
+            raise ActionError("%s: %s: %s" % (path, key, e))
+    return actions
+
+
+def run_steps(kbd, steps):
+    for i, (kind, value) in enumerate(steps):
+        if kind == "keys":
+            kbd.keys(value, 1)
+            kbd.keys(reversed(value), 0)
+        elif kind == "down":
+            kbd.keys(value, 1)
+        elif kind == "up":
+            kbd.keys(value, 0)
+        elif kind == "run":
+            subprocess.Popen(value, stdin=subprocess.DEVNULL, start_new_session=True)
+        elif kind == "wait":
+            # Keep the dispatcher free: finish this action in a thread
+            rest = steps[i + 1:]
+            threading.Timer(value, run_steps, (kbd, rest)).start()
+            return
+
+
+# ============================================================================
+# Event Loop
+# ============================================================================
+
+class PadReader:
+    def __init__(self, path, serial):
+        self.pad = Pad(path)
+        self.serial = serial or path
+        self.sequence = None
+        try:
+            caps = self.pad.info()["caps"]
+        except PadError:
+            self.pad.close()
+            raise
+        if not caps & CAP_HOST_EVENTS:
+            print("%s: firmware built without host-events, no Host actions"
+                  % self.serial, file=sys.stderr)
+
+    def event(self):
+        """(slot, input, edge, events lost before it) or None. hidraw returns
+        one report per read; keyboard, mouse and media reports arrive too."""
+        data = os.read(self.pad.fileno(), 64)
+        if len(data) < 1 + HOST_EVENT_BYTES or data[0] != REPORT_ID_HOST_EVENT:
+            return None
+        slot, input_, edge, sequence = data[1:1 + HOST_EVENT_BYTES]
+        lost = 0
+        if self.sequence is not None:
+            lost = (sequence - self.sequence - 1) & 0xFF
+        self.sequence = sequence
+        return slot, input_, edge, lost
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("actions", help="action map (JSON)")
+    ap.add_argument("--rescan", type=float, default=5.0,
+                    help="seconds between checks for new pads (default: %(default)s)")
+    ap.add_argument("-v", "--verbose", action="store_true", help="log every event")
+    args = ap.parse_args()
+
+    try:
+        actions = load_actions(args.actions)
+        kbd = VirtualKeyboard()
+    except (ActionError, OSError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    readers = {}
+    next_scan = 0
+    try:
+        while True:
+            now = time.monotonic()
+            if now >= next_scan:
+                next_scan = now + args.rescan
+                for path, serial, _ in find_pads():
+                    if path in readers:
+                        continue
+                    try:
+                        readers[path] = PadReader(path, serial)
+                        print("%s: listening on %s" % (readers[path].serial, path))
+                    except (OSError, PadError) as e:
+                        print("%s: %s" % (path, e), file=sys.stderr)
+
+            ready, _, _ = select.select([r.pad for r in readers.values()], [], [],
+                                        max(0.0, next_scan - time.monotonic()))
+            for pad in ready:
+                reader = readers[pad.path]
+                try:
+                    event = reader.event()
+                except OSError:
+                    print("%s: disconnected" % reader.serial)
+                    reader.pad.close()
+                    del readers[pad.path]
+                    continue
+                if event is None:
+                    continue
+                slot, input_, edge, lost = event
+                if lost:
+                    print("%s: %d event(s) lost" % (reader.serial, lost), file=sys.stderr)
+                action = actions.get((slot, input_))
+                if args.verbose:
+                    print("%s: slot %d input %d %s%s" % (
+                        reader.serial, slot, input_, "press" if edge else "release",
+                        "" if action else " (not mapped)"), flush=True)
+                if action:
+                    run_steps(kbd, action["press" if edge else "release"])
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for reader in readers.values():
+            reader.pad.close()
+        kbd.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+"""
+Page profiles into the CH552G Mini Keyboard RAM overlay slot (Linux).
+
+The firmware has one volatile slot besides the DataFlash slots. WRITE_OVERLAY
+fills it and switches to it in one Feature Report (two on boards with more
+than 7 inputs). DataFlash is never written, so there is no flash wear and no
+commit delay, and the pad is back on its saved slot after a power cycle.
+
+    load      copy one slot of a profile into the overlay and activate it
+    off       leave the overlay, back to the saved slot
+    follow    page profiles in as the focused X11 window changes
+
+The follow map (JSON) maps WM_CLASS names (instance or class, case
+insensitive) to a profile, or to {"profile": ..., "slot": N} to use another
+slot of it than slot 0. Windows without an entry leave the overlay.
+
+    {
+      "firefox": "browser.json",
+      "code": {"profile": "ide.json", "slot": 1}
+    }
+
+Profiles are read like pad_cost.py reads them: PC app JSON, a DataFlash image
+or an action table. Each profile gets a tag (its position in the map) that
+the pad reports in GET_INFO, so switching back to the profile already in the
+overlay is a SET_SLOT only. Focus changes come from "xprop -spy", so follow
+needs xprop and an X11 session (or XWayland windows).
+
+Host actions in the overlay report slot = the pad's DataFlash slot count
+(3 on the original pad) to pad_hostd.py.
+
+Usage:
+    pad_overlay.py load profile.json --slot 2
+    pad_overlay.py off
+    pad_overlay.py follow apps.json
+"""
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+import time
+
+from ch552pad import CAP_OVERLAY_SLOT, Pad, PadError, find_pad, find_pads
+from pad_cost import CostError, load_profile
+
+DEFAULT_INPUTS = 5
+
+
+class OverlayError(Exception):
+    pass
+
+
+# ============================================================================
+# Profiles
+# ============================================================================
+
+def profile_slot(path, slot, inputs):
+    """Actions (8 bytes each) of one slot of a profile."""
+    try:
+        _, slots = load_profile(path, inputs)
+    except (CostError, OSError) as e:
+        raise OverlayError(str(e))
+    if not 0 <= slot < len(slots):
+        raise OverlayError("%s: no slot %d (%d slots)" % (path, slot, len(slots)))
+    return slots[slot]
+
+
+def load_map(path, inputs):
+    """{wm_class: (tag, actions)}; equal (profile, slot) pairs share a tag."""
+    try:
+        with open(path) as f:
+            data = json.load(f)
+    except (OSError, ValueError) as e:
+        raise OverlayError("%s: %s" % (path, e))
+    tags = {}
+    entries = {}
+    for name, value in data.items():
+        if isinstance(value, str):
+            value = {"profile": value}
+        key = (value.get("profile"), int(value.get("slot", 0)))
+        if not key[0]:
+            raise OverlayError("%s: %r has no profile" % (path, name))
+        if key not in tags:
+            if len(tags) >= 255:
+                raise OverlayError("%s: more than 255 profiles" % path)
+            tags[key] = (len(tags) + 1, profile_slot(key[0], key[1], inputs))
+        entries[name.lower()] = tags[key]
+    return entries
+
+
+# ============================================================================
+# Pads
+# ============================================================================
+
+class OverlayPad:
+    def __init__(self, path, serial):
+        self.pad = Pad(path)
+        self.serial = serial or path
+        try:
+            self.info = self.pad.info()
+        except PadError:
+            self.pad.close()
+            raise
+        if not self.info["caps"] & CAP_OVERLAY_SLOT:
+            self.pad.close()
+            raise PadError("%s: firmware has no overlay slot" % self.serial)
+
+    # The slot menu and scripts switch slots too, so the state is read back
+    # on every switch (one more transaction, ~2 ms)
+
+    def show(self, tag, actions, reload=False):
+        """Activate the overlay with actions; skip the copy if already loaded."""
+        info = self.info = self.pad.info()
+        if len(actions) != info["inputs"]:
+            raise PadError("%s: profile has %d inputs, pad has %d"
+                           % (self.serial, len(actions), info["inputs"]))
+        if reload or not info["overlay_loaded"] or info["overlay_tag"] != tag:
+            self.pad.write_overlay(actions, tag)
+        elif info["slot"] != info["slots"]:
+            self.pad.set_slot(info["slots"])
+
+    def leave(self):
+        """Back to the saved slot; returns it."""
+        info = self.info = self.pad.info()
+        if info["slot"] == info["slots"]:
+            self.pad.set_slot(info["saved_slot"])
+        return info["saved_slot"]
+
+
+def open_pads(serial=None, skip=()):
+    pads = []
+    targets = [t for t in find_pads() if t[0] not in skip]
+    if serial:
+        path = find_pad(serial)
+        targets = [t for t in targets if t[0] == path]
+    for path, pad_serial, _ in targets:
+        try:
+            pads.append(OverlayPad(path, pad_serial))
+        except (OSError, PadError) as e:
+            print("%s: %s" % (path, e), file=sys.stderr)
+    return pads
+
+
+# ============================================================================
+# Focus Tracking
+# ============================================================================
+
+WINDOW_RE = re.compile(r"window id # (0x[0-9a-fA-F]+)")
+CLASS_RE = re.compile(r'"([^"]*)"')
+
+
+def window_classes(window):
+    try:
+        out = subprocess.run(["xprop", "-id", window, "WM_CLASS"], capture_output=True,
+                             text=True, timeout=1).stdout
+    except (OSError, subprocess.TimeoutExpired):
+        return []
+    return [c.lower() for c in CLASS_RE.findall(out)]
+
+
+def follow(entries, args):
+    try:
+        spy = subprocess.Popen(["xprop", "-root", "-spy", "_NET_ACTIVE_WINDOW"],
+                               stdout=subprocess.PIPE, text=True)
+    except OSError as e:
+        raise OverlayError("xprop: %s" % e)
+
+    pads = open_pads(args.serial)
+    next_scan = time.monotonic() + args.rescan
+    try:
+        for line in spy.stdout:
+            match = WINDOW_RE.search(line)
+            classes = window_classes(match.group(1)) if match else []
+            entry = next((entries[c] for c in classes if c in entries), None)
+
+            if time.monotonic() >= next_scan or not pads:
+                next_scan = time.monotonic() + args.rescan
+                pads += open_pads(args.serial, {p.pad.path for p in pads})
+
+            for pad in list(pads):
+                try:
+                    if entry:
+                        pad.show(*entry)
+                    else:
+                        pad.leave()
+                except (OSError, PadError) as e:
+                    print("%s: %s" % (pad.serial, e), file=sys.stderr)
+                    pad.pad.close()
+                    pads.remove(pad)
+            if args.verbose:
+                print("%s -> %s" % ("/".join(classes) or "-",
+                                    "overlay tag %d" % entry[0] if entry else "saved slot"),
+                      flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        spy.terminate()
+        for pad in pads:
+            pad.pad.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("--serial", help="only this pad (default: all)")
+    ap.add_argument("--inputs", type=int, default=DEFAULT_INPUTS,
+                    help="inputs per slot of binary profiles (default: %(default)s)")
+    sub = ap.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("load", help="load a profile slot into the overlay")
+    p.add_argument("profile")
+    p.add_argument("--slot", type=int, default=0, help="profile slot (default: 0)")
+    p.add_argument("--tag", type=int, default=0, help="id reported in GET_INFO")
+    sub.add_parser("off", help="leave the overlay")
+    p = sub.add_parser("follow", help="page profiles in by focused window")
+    p.add_argument("map", help="WM_CLASS to profile map (JSON)")
+    p.add_argument("--rescan", type=float, default=5.0,
+                   help="seconds between checks for new pads (default: %(default)s)")
+    p.add_argument("-v", "--verbose", action="store_true", help="log every switch")
+    args = ap.parse_args()
+
+    try:
+        if args.command == "follow":
+            follow(load_map(args.map, args.inputs), args)
+            return 0
+        actions = None
+        if args.command == "load":
+            actions = profile_slot(args.profile, args.slot, args.inputs)
+    except OverlayError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    pads = open_pads(args.serial)
+    if not pads:
+        print("no pads with an overlay slot found", file=sys.stderr)
+        return 1
+    status = 0
+    for pad in pads:
+        try:
+            if actions is not None:
+                start = time.monotonic()
+                pad.show(args.tag & 0xFF, actions, reload=True)
+                print("%s: overlay active (%.1f ms)"
+                      % (pad.serial, (time.monotonic() - start) * 1000))
+            else:
+                print("%s: slot %d" % (pad.serial, pad.leave()))
+        except (OSError, PadError) as e:
+            print("%s: %s" % (pad.serial, e), file=sys.stderr)
+            status = 1
+        finally:
+            pad.pad.close()
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""
+Firmware update for many CH552G Mini Keyboards at once.
+
+Each pad is sent ENTER_BOOTLOADER over the config interface (no button
+combo, config in DataFlash kept). The tool then waits for the WCH bootloader
+(4348:55E0) to appear on the same USB port, runs the flasher on it, waits for
+the pad to come back and checks the firmware version with GET_INFO. Every
+pad runs in its own thread, so a whole hub is updated in roughly the time
+of one.
+
+The flasher is an external command, given as a template:
+    {firmware}        the .hex/.bin file
+    {bus} {address}   USB bus number and device address of the bootloader
+    {port}            sysfs port name, e.g. 1-2.3
+A flasher that cannot select a device (no {bus}/{address}/{port} in the
+template) is run one pad at a time. Since every pad receives the same image,
+whichever bootloader it picks is fine.
+
+Usage:
+    pad_update.py firmware.hex [--expect 2.1.0] [--flasher 'vnproch55x {firmware}']
+    pad_update.py --dry-run firmware.hex     list the pads that would be updated
+"""
+
+import argparse
+import contextlib
+import os
+import shlex
+import subprocess
+import sys
+import threading
+import time
+
+from ch552pad import PID, VID, Pad, PadError, find_pads, find_usb, usb_port
+
+BOOTLOADER_VID = 0x4348
+BOOTLOADER_PID = 0x55E0
+
+DEFAULT_FLASHER = "vnproch55x {firmware}"
+POLL_INTERVAL = 0.1
+
+
+class UpdateError(Exception):
+    pass
+
+
+def wait_for(what, timeout, probe):
+    """Poll probe() until it returns something, or raise after timeout s."""
+    deadline = time.monotonic() + timeout
+    while True:
+        result = probe()
+        if result:
+            return result
+        if time.monotonic() > deadline:
+            raise UpdateError("timed out waiting for %s" % what)
+        time.sleep(POLL_INTERVAL)
+
+
+def pad_on_port(port):
+    for path, _, _ in find_pads():
+        if usb_port(path) == port:
+            return path
+    return None
+
+
+# ============================================================================
+# One Pad
+# ============================================================================
+
+class Update(threading.Thread):
+    def __init__(self, path, serial, args, flash_lock, restart_timeout):
+        super().__init__(daemon=True)
+        self.path = path
+        self.label = serial or path
+        self.port = usb_port(path)
+        self.args = args
+        self.flash_lock = flash_lock
+        self.restart_timeout = restart_timeout
+        self.before = "?"
+        self.after = "?"
+        self.error = None
+        self.times = {}
+
+    def step(self, name, fn):
+        start = time.monotonic()
+        result = fn()
+        self.times[name] = time.monotonic() - start
+        return result
+
+    def run(self):
+        try:
+            if self.port is None:
+                raise UpdateError("no USB port found in sysfs")
+            self.step("enter", self.enter)
+            dev = self.step("detect", lambda: wait_for(
+                "bootloader", self.args.timeout,
+                lambda: find_usb(BOOTLOADER_VID, BOOTLOADER_PID).get(self.port)))
+            self.step("flash", lambda: self.flash(dev))
+            path = self.step("restart", lambda: wait_for(
+                "pad to restart", self.restart_timeout, lambda: pad_on_port(self.port)))
+            self.step("verify", lambda: self.verify(path))
+        except (OSError, PadError, UpdateError, subprocess.SubprocessError) as e:
+            self.error = str(e)
+
+    def enter(self):
+        with Pad(self.path) as pad:
+            self.before = pad.info()["version"]
+            pad.enter_bootloader()
+
+    def flash(self, dev):
+        fields = {"firmware": self.args.firmware, "bus": dev[0], "address": dev[1],
+                  "port": self.port}
+        cmd = [part.format(**fields) for part in shlex.split(self.args.flasher)]
+        with self.flash_lock:
+            result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                    timeout=self.args.timeout * 6)
+        if result.returncode:
+            tail = result.stdout.decode(errors="replace").strip().splitlines()[-1:]
+            raise UpdateError("flasher exit %d%s" % (result.returncode,
+                                                     ": " + tail[0] if tail else ""))
+
+    def verify(self, path):
+        # udev may still be applying permissions right after the node appears
+        info = wait_for("pad to answer", self.args.timeout, lambda: self.try_info(path))
+        self.after = info["version"]
+        if self.args.expect and self.after != self.args.expect:
+            raise UpdateError("running %s, expected %s" % (self.after, self.args.expect))
+
+    @staticmethod
+    def try_info(path):
+        try:
+            with Pad(path) as pad:
+                return pad.info()
+        except (OSError, PadError):
+            return None
+
+
+# ============================================================================
+# Main
+# ============================================================================
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("firmware", help="firmware image for the flasher")
+    ap.add_argument("--flasher", default=DEFAULT_FLASHER,
+                    help="flasher command template (default: %(default)s)")
+    ap.add_argument("--expect", help="firmware version the pads must report afterwards")
+    ap.add_argument("--timeout", type=float, default=10.0,
+                    help="seconds to wait for each re-enumeration (default 10)")
+    ap.add_argument("--dry-run", action="store_true", help="list pads, change nothing")
+    args = ap.parse_args()
+
+    if not os.path.isfile(args.firmware):
+        print("%s: not found" % args.firmware, file=sys.stderr)
+        return 1
+    pads = find_pads()
+    if not pads:
+        print("no pads %04X:%04X found (check permissions on /dev/hidraw*)" % (VID, PID),
+              file=sys.stderr)
+        return 1
+    if args.dry_run:
+        for path, serial, _ in pads:
+            print("%s  serial=%s  port %s" % (path, serial or "-", usb_port(path)))
+        return 0
+
+    # Serialise the flasher unless it is told which device to program
+    selective = any("{%s}" % k in args.flasher for k in ("bus", "address", "port"))
+    flash_lock = contextlib.nullcontext() if selective else threading.Lock()
+    # Serialised, a pad may be programmed by another pad's flasher run, so
+    # its restart can take until the last run is done
+    restart_timeout = args.timeout * (1 if selective else len(pads) + 1)
+
+    start = time.monotonic()
+    updates = [Update(path, serial, args, flash_lock, restart_timeout)
+               for path, serial, _ in pads]
+    for u in updates:
+        u.start()
+    for u in updates:
+        u.join()
+
+    failed = 0
+    for u in updates:
+        steps = " ".join("%s %.1fs" % (k, v) for k, v in u.times.items())
+        if u.error:
+            failed += 1
+            print("FAIL  %-20s %s -> ?  %s  (%s)" % (u.label, u.before, u.error, steps))
+        else:
+            print("ok    %-20s %s -> %s  (%s)" % (u.label, u.before, u.after, steps))
+    print("%d of %d pads updated in %.1f s" % (len(updates) - failed, len(updates),
+                                               time.monotonic() - start), file=sys.stderr)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""
+Live profile reload for CH552G Mini Keyboards (Linux, inotify).
+
+Watches a profile file and pushes it to a pad every time it is saved. Only
+the actions that differ from the pad's current image go out:
+
+  default     one WRITE_ACTION per changed action. The pad uses it at once
+              and commits all of them to DataFlash in one deferred commit
+              (100 ms after the last write).
+  --overlay   one slot of the profile goes to the RAM overlay slot and is
+              activated; nothing is written to DataFlash. Changed inputs go
+              out as one WRITE_OVERLAY packet.
+
+The pad's image is read once (READ_CONFIG) and kept. Before each push the
+tool compares the GET_INFO fingerprint with the kept image and reads it
+again if something else (the PC app, the slot menu) changed the pad.
+
+The directory is watched, not the file, so editors that save by writing a
+temporary file and renaming it are seen too. Events within --settle ms are
+coalesced into one push. A save usually reaches the pad in a few
+milliseconds: one GET_INFO plus one transaction per changed action.
+
+Profiles are read like pad_cost.py reads them: PC app JSON, a DataFlash
+image or an action table. A profile that does not parse (half-written, or
+a typo) is reported and skipped until the next save.
+
+Usage:
+    pad_watch.py profile.json
+    pad_watch.py profile.json --overlay 1      try slot 1 in the RAM slot
+    pad_watch.py profile.json --once           push once and exit
+"""
+
+import argparse
+import ctypes
+import os
+import select
+import struct
+import sys
+import time
+
+from ch552pad import (ACTION_SIZE, CAP_OVERLAY_SLOT, Pad, PadError, find_pad,
+                      find_pads, fingerprint)
+from pad_cost import CostError, load_profile
+
+OVERLAY_TAG = 0xFF  # GET_INFO overlay tag of profiles pushed by this tool
+
+
+class WatchError(Exception):
+    pass
+
+
+# ============================================================================
+# inotify (sys/inotify.h)
+# ============================================================================
+
+IN_CLOSE_WRITE = 0x00000008
+IN_MOVED_TO = 0x00000080
+IN_CLOEXEC = os.O_CLOEXEC
+EVENT_HEADER = struct.Struct("iIII")  # wd, mask, cookie, name length
+
+
+class FileWatch:
+    """Saves of one file, seen through its directory."""
+
+    def __init__(self, path):
+        self.name = os.path.basename(path)
+        libc = ctypes.CDLL(None, use_errno=True)
+        self.fd = libc.inotify_init1(IN_CLOEXEC)
+        if self.fd < 0:
+            raise WatchError("inotify_init1: %s" % os.strerror(ctypes.get_errno()))
+        directory = os.path.dirname(os.path.abspath(path))
+        if libc.inotify_add_watch(self.fd, os.fsencode(directory),
+                                  IN_CLOSE_WRITE | IN_MOVED_TO) < 0:
+            os.close(self.fd)
+            raise WatchError("%s: %s" % (directory, os.strerror(ctypes.get_errno())))
+
+    def close(self):
+        os.close(self.fd)
+
+    def saved(self):
+        """True if pending events include a save of the file (never blocks
+        after select() reported the fd readable)."""
+        data = os.read(self.fd, 4096)
+        found = False
+        pos = 0
+        while pos + EVENT_HEADER.size <= len(data):
+            _, _, _, length = EVENT_HEADER.unpack_from(data, pos)
+            pos += EVENT_HEADER.size
+            name = data[pos:pos + length].rstrip(b"\0")
+            pos += length
+            if os.fsdecode(name) == self.name:
+                found = True
+        return found
+
+    def wait(self, settle):
+        """Block until the file is saved, then let the editor finish."""
+        while not self.saved():
+            pass
+        while select.select([self.fd], [], [], settle)[0]:
+            self.saved()
+
+
+# ============================================================================
+# Pushing
+# ============================================================================
+
+class Target:
+    def __init__(self, pad, serial, overlay):
+        self.pad = pad
+        self.serial = serial
+        self.overlay = overlay
+        self.info = pad.info()
+        self.image = None     # Action table as on the pad (DataFlash mode)
+        self.shown = None     # Overlay actions as last written
+        if overlay is not None and not self.info["caps"] & CAP_OVERLAY_SLOT:
+            raise PadError("%s: firmware has no overlay slot" % serial)
+
+    def refresh(self):
+        """Re-read the pad's image if it is not the one kept here."""
+        info = self.info = self.pad.info()
+        if self.overlay is not None:
+            if not info["overlay_loaded"] or info["overlay_tag"] != OVERLAY_TAG:
+                self.shown = None
+            return
+        if self.image is None or fingerprint(*self.image) != info["fingerprint"]:
+            self.image = self.pad.read_config()
+
+    def push(self, slots):
+        """Send what changed; returns the number of actions sent."""
+        self.refresh()
+        inputs = self.info["inputs"]
+        for s, actions in enumerate(slots):
+            if len(actions) != inputs:
+                raise WatchError("slot %d has %d inputs, pad has %d"
+                                 % (s, len(actions), inputs))
+        if self.overlay is not None:
+            return self.push_overlay(slots)
+
+        table, active_slot, brightness = self.image
+        table = bytearray(table)
+        sent = 0
+        for s, actions in enumerate(slots[:self.info["slots"]]):
+            for i, action in enumerate(actions):
+                pos = (s * inputs + i) * ACTION_SIZE
+                if table[pos:pos + ACTION_SIZE] != action:
+                    self.pad.write_action(s, i, action)
+                    table[pos:pos + ACTION_SIZE] = action
+                    sent += 1
+        self.image = (bytes(table), active_slot, brightness)
+        return sent
+
+    def push_overlay(self, slots):
+        if self.overlay >= len(slots):
+            raise WatchError("no slot %d (%d slots)" % (self.overlay, len(slots)))
+        actions = slots[self.overlay]
+        shown = self.shown
+        if shown is None:
+            changed = list(range(len(actions)))
+        else:
+            changed = [i for i, a in enumerate(actions) if a != shown[i]]
+        if changed:
+            first, last = changed[0], changed[-1] + 1
+            self.pad.write_overlay(actions[first:last], OVERLAY_TAG, first=first)
+        elif self.info["slot"] != self.info["slots"]:
+            self.pad.set_slot(self.info["slots"])  # Unchanged, but left meanwhile
+        self.shown = list(actions)
+        return len(changed)
+
+
+def open_target(serial, overlay):
+    if serial:
+        path = find_pad(serial)
+        if not path:
+            raise WatchError("no pad with serial %s" % serial)
+    else:
+        pads = find_pads()
+        if not pads:
+            raise WatchError("no pads found (check permissions on /dev/hidraw*)")
+        path, serial, _ = pads[0]
+    pad = Pad(path)
+    try:
+        return Target(pad, serial or path, overlay)
+    except PadError:
+        pad.close()
+        raise
+
+
+def push_file(target, path, inputs):
+    start = time.monotonic()
+    try:
+        _, slots = load_profile(path, inputs)
+    except (CostError, OSError) as e:
+        print("%s: %s" % (path, e), file=sys.stderr)
+        return False
+    try:
+        sent = target.push(slots)
+    except WatchError as e:
+        print("%s: %s" % (path, e), file=sys.stderr)
+        return False
+    print("%s: %d action(s) sent%s in %.1f ms" % (
+        target.serial, sent, " to the overlay" if target.overlay is not None else "",
+        (time.monotonic() - start) * 1000), flush=True)
+    return True
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("profile", help="profile JSON, DataFlash image or action table")
+    ap.add_argument("--serial", help="pad to push to (default: the first found)")
+    ap.add_argument("--overlay", type=int, metavar="SLOT",
+                    help="push this profile slot to the RAM overlay slot")
+    ap.add_argument("--inputs", type=int, default=5,
+                    help="inputs per slot of binary profiles (default: %(default)s)")
+    ap.add_argument("--settle", type=float, default=10.0,
+                    help="ms to wait for more events after a save (default: %(default)s)")
+    ap.add_argument("--once", action="store_true", help="push once and exit")
+    args = ap.parse_args()
+
+    try:
+        target = open_target(args.serial, args.overlay)
+        watch = None if args.once else FileWatch(args.profile)
+    except (OSError, PadError, WatchError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    try:
+        ok = push_file(target, args.profile, args.inputs)
+        if args.once:
+            return 0 if ok else 1
+        print("watching %s" % args.profile, flush=True)
+        while True:
+            watch.wait(args.settle / 1000)
+            push_file(target, args.profile, args.inputs)
+    except (OSError, PadError) as e:
+        print("%s: %s" % (target.serial, e), file=sys.stderr)
+        return 1
+    except KeyboardInterrupt:
+        return 0
+    finally:
+        target.pad.close()
+        if watch:
+            watch.close()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
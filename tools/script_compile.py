@@ -0,0 +1,347 @@
+#!/usr/bin/env python3
+"""
+Script compiler for the CH552G Mini Keyboard bytecode VM.
+
+Compiles a scripts source file into script_data.h for script.c. Scripts can
+do what fixed actions and text macros cannot: hold keys, loop, wait, branch
+on the host's keyboard LEDs and switch slots. One statement per line:
+
+    script NAME             start a new script (index = order in the file)
+    tap KEY                 press and release KEY
+    down KEY / up KEY       press / release KEY (at most 6 different keys
+                            per script use down)
+    mods MOD+MOD | none     modifiers sent with the following key reports
+    wait MS                 pause (0-65535 ms)
+    repeat N ... next       run the body N times (1-255, nested 2 deep)
+    if [not] led LEDS       run the block if any of LEDS is on (off with not);
+      ... [else ...] endif  LEDS: num, caps, scroll, compose, kana joined by +
+    label NAME / goto NAME  jump anywhere in the same script
+    slot N                  make slot N active (not saved to DataFlash)
+    stop                    release its keys and end (also implied at the end)
+
+KEY is a macro_compile.py key name (ENTER, F5, PGUP ...), a letter or digit
+(US key positions) or a raw usage 0xNN. Lines starting with # are comments.
+
+Every instruction is 3 bytes (opcode and two operand bytes), so the VM
+decodes each step with the same fetch and a jump table, and a jump target
+is a byte offset into SCRIPT_CODE. Each key a script holds with down gets
+a key slot, passed as the second operand of its down and up instructions,
+so the VM records and forgets held keys without searching for them.
+
+Usage:
+    script_compile.py scripts.txt -o script_data.h
+    script_compile.py scripts.txt --show
+"""
+
+import argparse
+import os
+import sys
+
+from macro_compile import KEY_NAMES, MODIFIER_NAMES, c_array
+
+# Opcodes (must match script.h)
+OP_END = 0x00
+OP_TAP = 0x01
+OP_DOWN = 0x02
+OP_UP = 0x03
+OP_MODS = 0x04
+OP_WAIT = 0x05
+OP_REPEAT = 0x06
+OP_NEXT = 0x07
+OP_JUMP = 0x08
+OP_SKIP_LED = 0x09
+OP_SLOT = 0x0A
+
+OP_SIZE = 3
+REPEAT_DEPTH = 2  # must match SCRIPT_REPEAT_DEPTH in script.h
+HELD_KEYS = 6     # must match SCRIPT_KEYS in script.h
+NO_KEY_SLOT = 0xFF  # up of a key no down holds
+MAX_CODE = 0xFFFF
+
+LED_BITS = {"num": 0x01, "caps": 0x02, "scroll": 0x04, "compose": 0x08, "kana": 0x10}
+
+OP_NAMES = {OP_END: "end", OP_TAP: "tap", OP_DOWN: "down", OP_UP: "up",
+            OP_MODS: "mods", OP_WAIT: "wait", OP_REPEAT: "repeat",
+            OP_NEXT: "next", OP_JUMP: "jump", OP_SKIP_LED: "skipled",
+            OP_SLOT: "slot"}
+
+
+class ScriptError(Exception):
+    pass
+
+
+# ============================================================================
+# Operands
+# ============================================================================
+
+def parse_int(text, lo, hi, what):
+    try:
+        value = int(text, 0)
+    except ValueError:
+        raise ScriptError("bad %s %r" % (what, text))
+    if not lo <= value <= hi:
+        raise ScriptError("%s %d out of range %d-%d" % (what, value, lo, hi))
+    return value
+
+
+def parse_key(text):
+    name = text.upper()
+    if name in KEY_NAMES:
+        return KEY_NAMES[name]
+    if len(text) == 1 and text.isalpha():
+        return 0x04 + ord(text.lower()) - ord("a")
+    if len(text) == 1 and text.isdigit():
+        return 0x27 if text == "0" else 0x1E + int(text) - 1
+    if name.startswith("0X"):
+        return parse_int(text, 1, 0xFF, "usage")
+    raise ScriptError("unknown key %r" % text)
+
+
+def parse_mods(text):
+    if text.lower() == "none":
+        return 0
+    mods = 0
+    for name in text.split("+"):
+        bit = MODIFIER_NAMES.get(name.strip().upper())
+        if bit is None:
+            raise ScriptError("unknown modifier %r" % name)
+        mods |= bit
+    return mods
+
+
+def parse_leds(text):
+    mask = 0
+    for name in text.split("+"):
+        bit = LED_BITS.get(name.strip().lower())
+        if bit is None:
+            raise ScriptError("unknown LED %r (one of %s)" % (name, ", ".join(LED_BITS)))
+        mask |= bit
+    return mask
+
+
+# ============================================================================
+# Compiler
+# ============================================================================
+#
+# Instructions are emitted as [opcode, a, b]; jumps hold a label until the
+# script is complete and are then resolved to byte offsets into SCRIPT_CODE.
+
+
+class Script:
+    def __init__(self, name, lineno):
+        self.name = name
+        self.lineno = lineno
+        self.code = []        # [op, a, b] with b/a possibly a ("label", name)
+        self.labels = {}
+        self.blocks = []      # Open repeat / if blocks
+        self.serial = 0
+
+    def emit(self, op, a=0, b=0):
+        self.code.append([op, a, b])
+
+    def new_label(self):
+        self.serial += 1
+        return ".%d" % self.serial
+
+    def place(self, label):
+        if label in self.labels:
+            raise ScriptError("label %r defined twice" % label)
+        self.labels[label] = len(self.code)
+
+    def jump(self, label):
+        self.code.append([OP_JUMP, ("label", label), 0])
+
+    def statement(self, words):
+        cmd, args = words[0].lower(), words[1:]
+
+        def arg():
+            if len(args) != 1:
+                raise ScriptError("%s takes one operand" % cmd)
+            return args[0]
+
+        if cmd in ("tap", "down", "up"):
+            self.emit({"tap": OP_TAP, "down": OP_DOWN, "up": OP_UP}[cmd], parse_key(arg()))
+        elif cmd == "mods":
+            self.emit(OP_MODS, parse_mods(arg()))
+        elif cmd == "wait":
+            ms = parse_int(arg(), 0, 0xFFFF, "wait")
+            self.emit(OP_WAIT, ms & 0xFF, ms >> 8)
+        elif cmd == "repeat":
+            depth = sum(1 for b in self.blocks if b[0] == "repeat")
+            if depth >= REPEAT_DEPTH:
+                raise ScriptError("repeat nested deeper than %d" % REPEAT_DEPTH)
+            self.emit(OP_REPEAT, parse_int(arg(), 1, 255, "repeat count"))
+            self.blocks.append(("repeat",))
+        elif cmd == "next":
+            if args:
+                raise ScriptError("next takes no operands")
+            if not self.blocks or self.blocks[-1][0] != "repeat":
+                raise ScriptError("next without repeat")
+            self.blocks.pop()
+            self.emit(OP_NEXT)
+        elif cmd == "if":
+            want = 1
+            if args and args[0].lower() == "not":
+                want, args = 0, args[1:]
+            if len(args) != 2 or args[0].lower() != "led":
+                raise ScriptError("expected 'if [not] led LEDS'")
+            orelse = self.new_label()
+            # Skip the jump to the else branch when the condition holds
+            self.emit(OP_SKIP_LED, parse_leds(args[1]), want)
+            self.jump(orelse)
+            self.blocks.append(["if", orelse, None])
+        elif cmd == "else":
+            if not self.blocks or self.blocks[-1][0] != "if" or self.blocks[-1][2]:
+                raise ScriptError("else without if")
+            block = self.blocks[-1]
+            block[2] = self.new_label()
+            self.jump(block[2])
+            self.place(block[1])
+        elif cmd == "endif":
+            if not self.blocks or self.blocks[-1][0] != "if":
+                raise ScriptError("endif without if")
+            _, orelse, end = self.blocks.pop()
+            self.place(end or orelse)
+        elif cmd == "label":
+            self.place(arg())
+        elif cmd == "goto":
+            self.jump(arg())
+        elif cmd == "slot":
+            self.emit(OP_SLOT, parse_int(arg(), 0, 254, "slot"))
+        elif cmd == "stop":
+            self.emit(OP_END)
+        else:
+            raise ScriptError("unknown statement %r" % cmd)
+
+    def finish(self):
+        if self.blocks:
+            raise ScriptError("script %s: %s not closed" % (self.name, self.blocks[-1][0]))
+        self.emit(OP_END)
+        # Key slots: one per key used with down, in order of appearance
+        slots = {}
+        for ins in self.code:
+            if ins[0] == OP_DOWN and ins[1] not in slots:
+                if len(slots) == HELD_KEYS:
+                    raise ScriptError("script %s: more than %d keys used with down"
+                                      % (self.name, HELD_KEYS))
+                slots[ins[1]] = len(slots)
+        for ins in self.code:
+            if ins[0] in (OP_DOWN, OP_UP):
+                ins[2] = slots.get(ins[1], NO_KEY_SLOT)
+
+
+def parse_source(path):
+    scripts = []
+    with open(path, encoding="utf-8") as f:
+        for lineno, line in enumerate(f, 1):
+            words = line.split("#", 1)[0].split()
+            if not words:
+                continue
+            try:
+                if words[0].lower() == "script":
+                    if len(words) != 2:
+                        raise ScriptError("expected 'script NAME'")
+                    if scripts:
+                        scripts[-1].finish()
+                    scripts.append(Script(words[1], lineno))
+                elif not scripts:
+                    raise ScriptError("statement before the first 'script'")
+                else:
+                    scripts[-1].statement(words)
+            except ScriptError as e:
+                raise ScriptError("%s:%d: %s" % (path, lineno, e))
+    if scripts:
+        try:
+            scripts[-1].finish()
+        except ScriptError as e:
+            raise ScriptError("%s: %s" % (path, e))
+    if len(scripts) > 255:
+        raise ScriptError("at most 255 scripts fit the action's primary byte")
+    return scripts
+
+
+def link(scripts):
+    """Resolve labels; return (code bytes, byte offset of each script)."""
+    code = bytearray()
+    offsets = []
+    for s in scripts:
+        base = len(code)
+        offsets.append(base)
+        for op, a, b in s.code:
+            if isinstance(a, tuple):
+                if a[1] not in s.labels:
+                    raise ScriptError("script %s: unknown label %r" % (s.name, a[1]))
+                target = base + s.labels[a[1]] * OP_SIZE
+                a, b = target & 0xFF, target >> 8
+            code += bytes((op, a, b))
+    if len(code) > MAX_CODE:
+        raise ScriptError("%d bytes of script code, jumps reach %d" % (len(code), MAX_CODE))
+    return bytes(code), offsets
+
+
+def disassemble(code, start, end):
+    lines = []
+    for pos in range(start, end, OP_SIZE):
+        op, a, b = code[pos:pos + OP_SIZE]
+        name = OP_NAMES.get(op, "0x%02X" % op)
+        if op in (OP_WAIT, OP_JUMP):
+            text = "%s %d" % (name, a | b << 8)
+        elif op == OP_SKIP_LED:
+            text = "%s 0x%02X %s" % (name, a, "on" if b else "off")
+        elif op in (OP_END, OP_NEXT):
+            text = name
+        elif op in (OP_DOWN, OP_UP):
+            text = "%s 0x%02X %s" % (name, a, "-" if b == NO_KEY_SLOT else "#%d" % b)
+        else:
+            text = "%s 0x%02X" % (name, a)
+        lines.append("%5d  %s" % (pos, text))
+    return lines
+
+
+def write_header(f, scripts, code, offsets, source):
+    f.write("// Generated by tools/script_compile.py from %s - do not edit\n"
+            % os.path.basename(source))
+    f.write("//\n")
+    ends = offsets[1:] + [len(code)]
+    for i, s in enumerate(scripts):
+        f.write("// %3d: %-16s %3d instructions\n"
+                % (i, s.name, (ends[i] - offsets[i]) // OP_SIZE))
+    f.write("\n#pragma once\n#include <stdint.h>\n\n")
+    f.write("#define SCRIPT_COUNT  %d\n\n" % len(scripts))
+    f.write("static __code const uint16_t SCRIPT_OFFSETS[%d] = {\n" % max(1, len(offsets)))
+    f.write("    " + ", ".join("%d" % o for o in (offsets or [0])) + "\n};\n\n")
+    code = code or bytes(OP_SIZE)
+    f.write("static __code const uint8_t SCRIPT_CODE[%d] = {\n" % len(code))
+    f.write(c_array(code, per_line=OP_SIZE * 4) + "\n};\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("source", help="script source file")
+    ap.add_argument("-o", "--output", help="generated header (e.g. script_data.h)")
+    ap.add_argument("--show", action="store_true", help="print the compiled code")
+    args = ap.parse_args()
+
+    try:
+        scripts = parse_source(args.source)
+        code, offsets = link(scripts)
+    except (ScriptError, OSError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    if args.show or not args.output:
+        ends = offsets[1:] + [len(code)]
+        for i, s in enumerate(scripts):
+            print("%3d %s" % (i, s.name))
+            print("\n".join(disassemble(code, offsets[i], ends[i])))
+    print("%d script(s), %d instructions, %d bytes"
+          % (len(scripts), len(code) // OP_SIZE, len(code)), file=sys.stderr)
+
+    if args.output:
+        with open(args.output, "w", newline="\n") as f:
+            write_header(f, scripts, code, offsets, args.source)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,359 @@
+#!/usr/bin/env python3
+"""
+Stack headroom report for CH552G Mini Keyboard firmware builds.
+
+The 8051 stack is the internal RAM left over above the register banks, data
+and overlay variables, and it overflows silently. This tool works out the
+worst stack depth of each call chain from the SDCC build output and sets it
+against the space the linker left, and optionally against the high-water
+mark a running pad measured (GET_DIAG layout 3, stack painted at boot).
+
+  linker map   __start__stack from the .map (or the .mem summary): the
+               first stack byte, so the stack holds 0x100 - start bytes
+  listings     every .asm file (.rst if there are none) in the build
+               directory. Per function: bytes pushed at each call site, the
+               calls themselves (2 bytes return address) and tail jumps.
+               Interrupt handlers are the functions ending in reti; the
+               hardware pushes 2 more bytes on entry.
+
+The depth of a chain is the deepest path from main() through it. The
+worst case adds the deepest interrupt handler on top of the deepest main
+chain: ch55xduino leaves all interrupts at one priority, so handlers never
+nest (--nested adds all of them, for builds that raise priorities). The
+headroom of a main chain leaves room for the deepest interrupt; the headroom
+of an interrupt handler or a chain inside one counts the deepest main chain
+under it, as the interrupt can arrive at that point.
+Function pointer calls (__sdcc_call_dptr) and functions without a listing
+(SDCC library helpers) are listed, counted as leaves; a measured mark above
+the static worst case points at one of those.
+
+Default chains: executeAction > Keyboard_press > USB_EP1_send (a key press
+that sends a report) and USBInterrupt (USB ISR body, nooverlay). --chain
+adds more, as function names separated by commas.
+
+Usage:
+    stack_report.py BUILD_DIR
+    stack_report.py BUILD_DIR --pad                       with the measured mark
+    stack_report.py BUILD_DIR --chain loop,runConfigTask,handleUSBFeatureReport
+"""
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+RAM_TOP = 0x100          # Internal RAM size (CH55x)
+RETURN_BYTES = 2         # lcall / acall and interrupt entry push the PC
+INDIRECT = "(function pointer)"
+
+DEFAULT_CHAINS = ("executeAction,Keyboard_press,USB_EP1_send", "USBInterrupt")
+
+DIAG_MIN_VERSION = 3     # GET_DIAG layout with the stack fields
+
+
+class StackError(Exception):
+    pass
+
+
+# ============================================================================
+# Build Output
+# ============================================================================
+
+MEM_RE = re.compile(r"Stack starts at:\s*0x([0-9a-fA-F]+)")
+MAP_RE = re.compile(r"\b([0-9A-Fa-f]{4,8})\s+__start__stack\b")
+
+
+def stack_start(build, map_path=None):
+    """First stack byte from the .mem summary or the linker map."""
+    paths = [map_path] if map_path else (
+        glob.glob(os.path.join(build, "**", "*.mem"), recursive=True) +
+        glob.glob(os.path.join(build, "**", "*.map"), recursive=True))
+    for path in paths:
+        with open(path, errors="replace") as f:
+            text = f.read()
+        match = MEM_RE.search(text) or MAP_RE.search(text)
+        if match:
+            return int(match.group(1), 16), path
+    raise StackError("no __start__stack in %s (link map or .mem)" % (map_path or build))
+
+
+FUNC_RE = re.compile(r";\s+function\s+(\w+)")
+CALL_RE = re.compile(r"\b[la]call\s+(\w+)")
+JUMP_RE = re.compile(r"\b[las]jmp\s+(_\w+)\s*$")
+PUSH_RE = re.compile(r"\bpush\s+\S+")
+POP_RE = re.compile(r"\bpop\s+\S+")
+MOV_SP_RE = re.compile(r"\bmov\s+a,\s*sp\b")
+SP_ADD_RE = re.compile(r"\badd\s+a,\s*#(0x[0-9a-fA-F]+|\d+)")
+RETI_RE = re.compile(r"\breti\b")
+
+
+def c_name(symbol):
+    """SDCC prefixes C names with an underscore."""
+    return symbol[1:] if symbol.startswith("_") else symbol
+
+
+class Function:
+    def __init__(self, name, source):
+        self.name = name
+        self.source = source
+        self.local = 0        # Deepest push depth in the body
+        self.calls = []       # (callee, depth at the call, pushes a return address)
+        self.isr = False
+
+
+def parse_listing(path, functions):
+    current = None
+    depth = 0
+    sp_arith = False          # mov a,sp seen: the next add moves SP
+    with open(path, errors="replace") as f:
+        for line in f:
+            code = line.split(";", 1)[0]
+            match = FUNC_RE.search(line)
+            if match and not code.strip():
+                current = functions.setdefault(match.group(1), Function(match.group(1), path))
+                depth = 0
+                continue
+            if current is None or not code.strip():
+                continue
+            if PUSH_RE.search(code):
+                depth += 1
+            elif POP_RE.search(code):
+                depth = max(0, depth - 1)
+            elif MOV_SP_RE.search(code):
+                sp_arith = True
+                continue
+            elif sp_arith and SP_ADD_RE.search(code):
+                # Reentrant frame: mov a,sp / add a,#n / mov sp,a
+                n = int(SP_ADD_RE.search(code).group(1), 0)
+                depth = max(0, depth + (n if n < 0x80 else n - 0x100))
+            elif RETI_RE.search(code):
+                current.isr = True
+            match = CALL_RE.search(code)
+            if match:
+                callee = match.group(1)
+                callee = INDIRECT if callee == "__sdcc_call_dptr" else c_name(callee)
+                current.calls.append((callee, depth, True))
+            match = JUMP_RE.search(code)
+            if match:
+                current.calls.append((c_name(match.group(1)), depth, False))
+            current.local = max(current.local, depth)
+            sp_arith = False
+
+
+def load_functions(build):
+    paths = glob.glob(os.path.join(build, "**", "*.asm"), recursive=True)
+    if not paths:
+        paths = glob.glob(os.path.join(build, "**", "*.rst"), recursive=True)
+    if not paths:
+        raise StackError("no .asm or .rst listings in %s" % build)
+    functions = {}
+    for path in paths:
+        parse_listing(path, functions)
+    # Tail jumps to local labels that happen to start with _ are not calls
+    for fn in functions.values():
+        fn.calls = [c for c in fn.calls if c[2] or c[0] in functions]
+    return functions
+
+
+# ============================================================================
+# Call Graph
+# ============================================================================
+
+class Graph:
+    def __init__(self, functions):
+        self.functions = functions
+        self.memo = {}
+        self.missing = set()
+        self.indirect = set()
+        self.recursive = set()
+
+    def depth(self, name, stack=()):
+        """(worst bytes from entry, deepest path below name)."""
+        if name in self.memo:
+            return self.memo[name]
+        fn = self.functions.get(name)
+        if fn is None:
+            if name == INDIRECT:
+                self.indirect.update(stack[-1:])
+            else:
+                self.missing.add(name)
+            return 0, [name]
+        if name in stack:
+            self.recursive.add(name)
+            return 0, [name + " (recursion)"]
+        best = (fn.local, [name])
+        for callee, at, ret in fn.calls:
+            sub, path = self.depth(callee, stack + (name,))
+            total = at + (RETURN_BYTES if ret else 0) + sub
+            if total > best[0]:
+                best = (total, [name] + path)
+        self.memo[name] = best
+        return best
+
+    def entry(self, root, root_depth):
+        """Worst stack depth at which each function is entered from root."""
+        entry = {root: root_depth}
+        order = [root]
+        # Longest path, relaxed until stable (the graph is small)
+        for _ in range(len(self.functions) + 1):
+            changed = False
+            for name in list(order):
+                fn = self.functions.get(name)
+                if fn is None:
+                    continue
+                for callee, at, ret in fn.calls:
+                    if callee in self.recursive:
+                        continue
+                    d = entry[name] + at + (RETURN_BYTES if ret else 0)
+                    if d > entry.get(callee, -1):
+                        entry[callee] = d
+                        if callee not in order:
+                            order.append(callee)
+                        changed = True
+            if not changed:
+                break
+        return entry
+
+    def chain(self, names, entry):
+        """Bytes used when the chain's last function reaches its deepest
+        point, entered the deepest way (None if a link is not a call)."""
+        if names[0] not in entry:
+            return None
+        total = entry[names[0]]
+        for caller, callee in zip(names, names[1:]):
+            fn = self.functions.get(caller)
+            sites = [at + (RETURN_BYTES if ret else 0)
+                     for c, at, ret in (fn.calls if fn else []) if c == callee]
+            if not sites:
+                return None
+            total += max(sites)
+        sub, path = self.depth(names[-1])
+        return total + sub, names[:-1] + path
+
+
+# ============================================================================
+# Measured Mark
+# ============================================================================
+
+def read_pad(serial):
+    from ch552pad import CMD_GET_DIAG, Pad, PadError, find_pad, find_pads
+    path = find_pad(serial) if serial else next((p[0] for p in find_pads()), None)
+    if not path:
+        raise StackError("no pad found")
+    try:
+        with Pad(path) as pad:
+            r = pad.request(CMD_GET_DIAG)
+    except PadError as e:
+        raise StackError(str(e))
+    if r[3] < DIAG_MIN_VERSION:
+        raise StackError("%s: GET_DIAG layout %d has no stack fields" % (path, r[3]))
+    tasks = r[19]
+    return r[23 + tasks], r[24 + tasks]
+
+
+# ============================================================================
+# Report
+# ============================================================================
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("build", help="SDCC build directory (listings and link map)")
+    ap.add_argument("--map", help="linker map or .mem file (default: found in BUILD)")
+    ap.add_argument("--chain", action="append", default=[],
+                    help="call chain to report, e.g. loop,readKeys,executeAction")
+    ap.add_argument("--nested", action="store_true",
+                    help="interrupts may nest: add every handler to the worst case")
+    ap.add_argument("--pad", nargs="?", const="", metavar="SERIAL",
+                    help="read the measured high-water mark from a pad")
+    args = ap.parse_args()
+
+    try:
+        start, map_path = stack_start(args.build, args.map)
+        functions = load_functions(args.build)
+        measured = read_pad(args.pad) if args.pad is not None else None
+    except (OSError, StackError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    size = RAM_TOP - start
+    graph = Graph(functions)
+    if "main" not in functions:
+        # Core not in the build directory: main() calls setup() and loop()
+        functions["main"] = Function("main", "(assumed)")
+        functions["main"].calls = [(f, 0, True) for f in ("setup", "loop") if f in functions]
+
+    # main() is called by the startup code, handlers are entered by hardware.
+    # Depths first: they find the recursive functions entry() has to skip.
+    main_depth, main_path = graph.depth("main")
+    main_depth += RETURN_BYTES
+    isrs = []
+    for fn in functions.values():
+        if fn.isr:
+            d, path = graph.depth(fn.name)
+            isrs.append((RETURN_BYTES + d, path))
+    isrs.sort(reverse=True)
+    isr_sum = sum(d for d, _ in isrs)
+    isr_worst = isr_sum if args.nested else max([d for d, _ in isrs] or [0])
+
+    # An interrupt arrives on top of the deepest main chain (and, with
+    # --nested, of the other handlers)
+    def below_isr(d):
+        return main_depth + (isr_sum - d if args.nested else 0)
+
+    main_entry = graph.entry("main", RETURN_BYTES)
+    isr_entries = [(d, graph.entry(path[0], RETURN_BYTES)) for d, path in isrs]
+    # (label, bytes, deepest path, bytes the rest of the worst case adds)
+    rows = [("main", main_depth, main_path, isr_worst)]
+    rows += [("%s (interrupt)" % path[0], d, path, below_isr(d)) for d, path in isrs]
+    for text in list(DEFAULT_CHAINS) + args.chain:
+        names = [n.strip() for n in text.split(",") if n.strip()]
+        result = graph.chain(names, main_entry)
+        if result is not None:
+            rows.append((" > ".join(names), result[0], result[1], isr_worst))
+            continue
+        in_isr = [(graph.chain(names, entry), d) for d, entry in isr_entries]
+        in_isr = [(res[0] + below_isr(d), res, d) for res, d in in_isr if res is not None]
+        if not in_isr:
+            print("chain %s: not a call chain in this build" % text, file=sys.stderr)
+            continue
+        _, result, d = max(in_isr)
+        rows.append((" > ".join(names), result[0], result[1], below_isr(d)))
+
+    print("Stack 0x%02X-0x%02X: %d bytes (%s)" % (start, RAM_TOP - 1, size, map_path))
+    print()
+    print("%-44s %6s %9s" % ("Chain", "bytes", "headroom"))
+    for label, used, path, rest in rows:
+        headroom = size - used - rest
+        print("%-44s %6d %9d" % (label, used, headroom))
+        print("    " + " > ".join(path))
+
+    worst = main_depth + isr_worst
+    print()
+    print("Worst case (main + %s): %d of %d bytes, %d free"
+          % ("all interrupts" if args.nested else "deepest interrupt", worst, size,
+             size - worst))
+
+    if measured is not None:
+        base, high = measured
+        used = high - base + 1
+        print("Measured since power-up: high water 0x%02X, %d bytes used, %d free"
+              % (high, used, RAM_TOP - 1 - high))
+        if base != start:
+            print("warning: pad's stack starts at 0x%02X, this build at 0x%02X "
+                  "(different firmware?)" % (base, start))
+        elif used > worst:
+            print("warning: measured more than the static worst case - check the "
+                  "function pointer calls and functions without a listing below")
+
+    if graph.indirect:
+        print("Function pointer calls in: %s" % ", ".join(sorted(graph.indirect)))
+    if graph.missing:
+        print("No listing (counted as leaves): %s" % ", ".join(sorted(graph.missing)))
+    if graph.recursive:
+        print("Recursive (depth unbounded): %s" % ", ".join(sorted(graph.recursive)))
+    return 1 if worst > size else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,479 @@
+#!/usr/bin/env python3
+"""
+USB descriptor generator for the CH552G Mini Keyboard.
+
+Builds the HID report descriptors, the string descriptors and the matching
+report sizes from one declarative table (REPORTS below) for a chosen feature
+set, and writes two headers into the USB library:
+
+    usb_features.h     feature switches, report IDs and report sizes
+                       (included everywhere through USBconstant.h)
+    usb_descriptors.h  the descriptor arrays (included by USBconstant.c only)
+
+Features (all off by default except raw-hid and fast-poll):
+    nkro          keyboard report is a modifier byte + usage bitmap instead of
+                  the 6-key array, so any number of keys can be held
+    hires-scroll  mouse wheel gets a Resolution Multiplier; once the host
+                  enables it, one wheel step is sent as RESOLUTION units
+    raw-hid       second HID interface with 64-byte input/output reports for
+                  the config protocol (only built on chips with the USB RAM
+                  for EP2, i.e. CH559)
+    host-events   vendor input report (slot, input, edge, sequence) that
+                  Host actions send instead of a keystroke, for a host-side
+                  executor such as tools/pad_hostd.py
+    fast-poll     EP1 bInterval of 1 ms instead of 10 ms, so the report staged
+                  by the SOF-locked input scan leaves with the next frame
+
+Before writing, the generated descriptor bytes are parsed back and every
+report is checked against the declared sizes: byte-aligned reports, unique
+report IDs, balanced collections, the endpoint size and the 64-byte config
+packet (Report ID + 63 bytes). A build therefore only carries descriptor
+bytes and report buffers for the features it enables.
+
+Usage:
+    usb_descgen.py                          default feature set
+    usb_descgen.py --features nkro,hires-scroll
+    usb_descgen.py --check                  fail if the headers are stale
+    usb_descgen.py --show                   print the descriptor, write nothing
+"""
+
+import argparse
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_OUT = os.path.join(HERE, "..", "src", "usb", "userUsbHidKeyboardMouse")
+
+FEATURES = ("nkro", "hires-scroll", "raw-hid", "host-events", "fast-poll")
+DEFAULT_FEATURES = ("raw-hid", "fast-poll")
+
+# Strings (device descriptor indices 1-2; the serial, index 3, is the chip
+# ID and is filled in at boot by USB_initSerial() in USBconstant.c)
+MANUFACTURER = "Deqing"
+PRODUCT = "CH55xduino"
+
+# Report IDs
+ID_KEYBOARD = 0x01
+ID_MOUSE = 0x02
+ID_CONSUMER = 0x03
+ID_CONFIG = 0xF0
+ID_HOST_EVENT = 0xF1
+
+CONFIG_PACKET = 64      # Config protocol packet, Report ID included
+EP1_BUFFER = 64         # Half of Ep1Buffer holds the IN report
+NKRO_BYTES = 16         # Usage bitmap 0x00-0x7F
+SCROLL_RESOLUTION = 8   # Wheel units per step with the multiplier enabled
+HOST_EVENT_BYTES = 4    # Slot, input, edge, sequence
+
+
+class DescError(Exception):
+    pass
+
+
+# ============================================================================
+# HID Items
+# ============================================================================
+# Each item is (encoded bytes, listing comment). Values pick the shortest
+# encoding (1 or 2 data bytes), signed where HID treats them as signed.
+
+def _item(prefix, value, comment, signed=False):
+    if value is None:
+        return (bytes((prefix,)), comment)
+    if signed and -128 <= value <= 127 or not signed and 0 <= value <= 0xFF:
+        return (bytes((prefix | 1, value & 0xFF)), comment)
+    return (bytes((prefix | 2, value & 0xFF, (value >> 8) & 0xFF)), comment)
+
+
+def usage_page(page, name):
+    return _item(0x04, page, "USAGE_PAGE (%s)" % name)
+
+
+def usage(u, name):
+    return _item(0x08, u, "USAGE (%s)" % name)
+
+
+def usage_min(u, name):
+    return _item(0x18, u, "USAGE_MINIMUM (%s)" % name)
+
+
+def usage_max(u, name):
+    return _item(0x28, u, "USAGE_MAXIMUM (%s)" % name)
+
+
+def logical(lo, hi):
+    return [_item(0x14, lo, "LOGICAL_MINIMUM (%d)" % lo, signed=True),
+            _item(0x24, hi, "LOGICAL_MAXIMUM (%d)" % hi, signed=True)]
+
+
+def physical(lo, hi):
+    return [_item(0x34, lo, "PHYSICAL_MINIMUM (%d)" % lo, signed=True),
+            _item(0x44, hi, "PHYSICAL_MAXIMUM (%d)" % hi, signed=True)]
+
+
+def report(size, count):
+    return [_item(0x74, size, "REPORT_SIZE (%d)" % size),
+            _item(0x94, count, "REPORT_COUNT (%d)" % count)]
+
+
+def report_id(rid):
+    return _item(0x84, rid, "REPORT_ID (%d)" % rid)
+
+
+MAIN_FLAGS = {0x00: "Data,Ary,Abs", 0x01: "Cnst,Ary,Abs", 0x02: "Data,Var,Abs",
+              0x03: "Cnst,Var,Abs", 0x06: "Data,Var,Rel"}
+
+
+def main_item(kind, flags):
+    prefix = {"INPUT": 0x80, "OUTPUT": 0x90, "FEATURE": 0xB0}[kind]
+    return _item(prefix, flags, "%s (%s)" % (kind, MAIN_FLAGS[flags]))
+
+
+def collection(kind, name):
+    return _item(0xA0, kind, "COLLECTION (%s)" % name)
+
+
+def end_collection():
+    return _item(0xC0, None, "END_COLLECTION")
+
+
+def flat(*parts):
+    out = []
+    for p in parts:
+        if isinstance(p, list):
+            out.extend(flat(*p))
+        else:
+            out.append(p)
+    return out
+
+
+# ============================================================================
+# Report Table
+# ============================================================================
+# One entry per top-level collection: (name, report id, builder). Builders
+# take the feature set and return (items, {report kind: payload bytes}); the
+# payload sizes are what the firmware's report buffers are declared with and
+# are verified against the parsed descriptor. A builder returns None when its
+# collection is not part of the feature set.
+
+def keyboard(features):
+    items = [usage_page(0x01, "Generic Desktop"), usage(0x06, "Keyboard"),
+             collection(0x01, "Application"), report_id(ID_KEYBOARD),
+             usage_page(0x07, "Keyboard"),
+             usage_min(0xE0, "Keyboard LeftControl"),
+             usage_max(0xE7, "Keyboard Right GUI"),
+             logical(0, 1), report(1, 8), main_item("INPUT", 0x02)]
+    if "nkro" in features:
+        last = NKRO_BYTES * 8 - 1
+        items += [usage_min(0x00, "Reserved (no event indicated)"),
+                  usage_max(last, "0x%02X" % last),
+                  report(1, NKRO_BYTES * 8), main_item("INPUT", 0x02)]
+        size = 1 + NKRO_BYTES
+    else:
+        items += [report(8, 1), main_item("INPUT", 0x03),
+                  report(8, 6), logical(0, 255),
+                  usage_min(0x00, "Reserved (no event indicated)"),
+                  usage_max(0xE7, "Keyboard Right GUI"),
+                  main_item("INPUT", 0x00)]
+        size = 8
+    items += [usage_page(0x08, "LEDs"), usage_min(0x01, "Num Lock"),
+              usage_max(0x05, "Kana"), logical(0, 1), report(1, 5),
+              main_item("OUTPUT", 0x02), report(3, 1), main_item("OUTPUT", 0x03),
+              end_collection()]
+    return flat(items), {"INPUT": size, "OUTPUT": 1}
+
+
+def mouse(features):
+    items = [usage_page(0x01, "Generic Desktop"), usage(0x02, "Mouse"),
+             collection(0x01, "Application"), usage(0x01, "Pointer"),
+             collection(0x00, "Physical"), report_id(ID_MOUSE),
+             usage_page(0x09, "Button"), usage_min(0x01, "Button 1"),
+             usage_max(0x03, "Button 3"), logical(0, 1), report(1, 3),
+             main_item("INPUT", 0x02), report(5, 1), main_item("INPUT", 0x03),
+             usage_page(0x01, "Generic Desktop"), usage(0x30, "X"), usage(0x31, "Y")]
+    sizes = {"INPUT": 4}
+    if "hires-scroll" in features:
+        items += [logical(-127, 127), report(8, 2), main_item("INPUT", 0x06),
+                  collection(0x02, "Logical"),
+                  usage(0x48, "Resolution Multiplier"), logical(0, 1),
+                  physical(1, SCROLL_RESOLUTION), report(2, 1),
+                  main_item("FEATURE", 0x02), physical(0, 0), report(6, 1),
+                  main_item("FEATURE", 0x03),
+                  usage(0x38, "Wheel"), logical(-127, 127), report(8, 1),
+                  main_item("INPUT", 0x06), end_collection()]
+        sizes["FEATURE"] = 1
+    else:
+        items += [usage(0x38, "Wheel"), logical(-127, 127), report(8, 3),
+                  main_item("INPUT", 0x06)]
+    items += [end_collection(), end_collection()]
+    return flat(items), sizes
+
+
+def consumer(features):
+    items = [usage_page(0x0C, "Consumer"), usage(0x01, "Consumer Control"),
+             collection(0x01, "Application"), report_id(ID_CONSUMER),
+             logical(0, 1023), usage_min(0x00, "Unassigned"),
+             usage_max(0x3FF, "0x03FF"), report(16, 4), main_item("INPUT", 0x00),
+             end_collection()]
+    return flat(items), {"INPUT": 8}
+
+
+def config(features):
+    items = [usage_page(0xFF00, "Vendor Defined 0xFF00"), usage(0x01, "Vendor Usage 1"),
+             collection(0x01, "Application"), report_id(ID_CONFIG),
+             usage(0x01, "Vendor Usage 1"), logical(0, 255),
+             report(8, CONFIG_PACKET - 1), main_item("FEATURE", 0x02),
+             end_collection()]
+    return flat(items), {"FEATURE": CONFIG_PACKET - 1}
+
+
+def host_event(features):
+    if "host-events" not in features:
+        return None
+    items = [usage_page(0xFF00, "Vendor Defined 0xFF00"), usage(0x03, "Vendor Usage 3"),
+             collection(0x01, "Application"), report_id(ID_HOST_EVENT),
+             usage(0x03, "Vendor Usage 3"), logical(0, 255),
+             report(8, HOST_EVENT_BYTES), main_item("INPUT", 0x02),
+             end_collection()]
+    return flat(items), {"INPUT": HOST_EVENT_BYTES}
+
+
+def raw_config(features):
+    items = [usage_page(0xFF00, "Vendor Defined 0xFF00"), usage(0x02, "Vendor Usage 2"),
+             collection(0x01, "Application"), logical(0, 255),
+             report(8, CONFIG_PACKET), usage(0x02, "Vendor Usage 2"),
+             main_item("INPUT", 0x02), usage(0x02, "Vendor Usage 2"),
+             main_item("OUTPUT", 0x02), end_collection()]
+    return flat(items), {"INPUT": CONFIG_PACKET, "OUTPUT": CONFIG_PACKET}
+
+
+REPORTS = (
+    ("KEYBOARD", ID_KEYBOARD, keyboard),
+    ("MOUSE", ID_MOUSE, mouse),
+    ("CONSUMER", ID_CONSUMER, consumer),
+    ("CONFIG", ID_CONFIG, config),
+    ("HOST_EVENT", ID_HOST_EVENT, host_event),
+)
+
+
+# ============================================================================
+# Consistency Checks
+# ============================================================================
+
+def parse_reports(data):
+    """Walk descriptor bytes, return {(kind, report id): bits} and the IDs."""
+    sizes = {}
+    rid, rsize, rcount = 0, 0, 0
+    depth = 0
+    i = 0
+    while i < len(data):
+        prefix = data[i]
+        n = (0, 1, 2, 4)[prefix & 3]
+        if i + 1 + n > len(data):
+            raise DescError("truncated item at offset %d" % i)
+        value = int.from_bytes(data[i + 1:i + 1 + n], "little")
+        tag = prefix & 0xFC
+        if tag == 0x84:
+            if value == 0:
+                raise DescError("report ID 0 is reserved")
+            rid = value
+        elif tag == 0x74:
+            rsize = value
+        elif tag == 0x94:
+            rcount = value
+        elif tag in (0x80, 0x90, 0xB0):
+            kind = {0x80: "INPUT", 0x90: "OUTPUT", 0xB0: "FEATURE"}[tag]
+            sizes[(kind, rid)] = sizes.get((kind, rid), 0) + rsize * rcount
+        elif tag == 0xA0:
+            depth += 1
+        elif tag == 0xC0:
+            depth -= 1
+            if depth < 0:
+                raise DescError("END_COLLECTION without COLLECTION at offset %d" % i)
+        elif tag in (0xA4, 0xB4):
+            raise DescError("PUSH/POP not supported by the checker")
+        i += 1 + n
+    if depth:
+        raise DescError("%d collection(s) left open" % depth)
+    return sizes
+
+
+def check(name, data, declared, rid):
+    parsed = parse_reports(data)
+    for (kind, pid), bits in sorted(parsed.items()):
+        if bits % 8:
+            raise DescError("%s %s report %d is %d bits, not byte aligned"
+                            % (name, kind, pid, bits))
+        if pid != rid:
+            raise DescError("%s: %s report carries ID %d, table says %d"
+                            % (name, kind, pid, rid))
+    got = {kind: bits // 8 for (kind, _), bits in parsed.items()}
+    if got != declared:
+        raise DescError("%s: descriptor gives %s, table declares %s"
+                        % (name, got, declared))
+
+
+def build(features):
+    blocks, sizes = [], {}
+    seen = set()
+    for name, rid, builder in REPORTS:
+        if rid in seen:
+            raise DescError("report ID 0x%02X used twice" % rid)
+        seen.add(rid)
+        built = builder(features)
+        if built is None:
+            continue
+        items, declared = built
+        check(name, b"".join(b for b, _ in items), declared, rid)
+        blocks.append((name, items))
+        sizes[name] = declared
+
+    # IN reports share EP1 with a Report ID prefix
+    ep_size = 1 + max(s["INPUT"] for s in sizes.values() if "INPUT" in s)
+    if ep_size > EP1_BUFFER:
+        raise DescError("largest input report needs %d bytes, EP1 buffer holds %d"
+                        % (ep_size, EP1_BUFFER))
+    if 1 + sizes["CONFIG"]["FEATURE"] != CONFIG_PACKET:
+        raise DescError("config feature report must be %d bytes including its ID"
+                        % CONFIG_PACKET)
+
+    raw = None
+    if "raw-hid" in features:
+        items, declared = raw_config(features)
+        check("RAW_CONFIG", b"".join(b for b, _ in items), declared, 0)
+        raw = items
+    return blocks, sizes, ep_size, raw
+
+
+# ============================================================================
+# Output
+# ============================================================================
+
+def listing(items, indent="    "):
+    """C initializer lines with the byte column aligned and nesting shown."""
+    lines = []
+    depth = 0
+    for b, comment in items:
+        if comment == "END_COLLECTION":
+            depth -= 1
+        code = " ".join("0x%02X," % x for x in b)
+        lines.append("%s%-18s// %s%s" % (indent, code, "  " * depth, comment))
+        if comment.startswith("COLLECTION"):
+            depth += 1
+    return lines
+
+
+def string_descriptor(name, text, comment):
+    chars = ", ".join("'%s'" % c.replace("'", "\\'") for c in text)
+    return ("__code uint16_t %s[] = {\n"
+            "    // %s\n"
+            "    (((%d + 1) * 2) | (DTYPE_String << 8)),\n"
+            "    %s,\n"
+            "};\n" % (name, comment, len(text), chars))
+
+
+def render(features, blocks, sizes, ep_size, raw):
+    tag = ",".join(f for f in FEATURES if f in features) or "none"
+    head = "// Generated by tools/usb_descgen.py (features: %s) - do not edit\n" % tag
+
+    feat = [head, "\n#pragma once\n\n"]
+    for f in FEATURES:
+        feat.append("#define USB_HID_%-14s %d\n"
+                    % (f.upper().replace("-", "_"), 1 if f in features else 0))
+    feat.append("\n// Report IDs and payload sizes (Report ID byte not included)\n")
+    active = [(name, rid) for name, rid, _ in REPORTS if name in sizes]
+    for name, rid in active:
+        feat.append("#define HID_REPORT_ID_%-10s 0x%02X\n" % (name, rid))
+    for name, _ in active:
+        for kind, n in sorted(sizes[name].items()):
+            feat.append("#define HID_%s_%s_BYTES %d\n" % (name, kind, n))
+    if "nkro" in features:
+        feat.append("#define HID_NKRO_USAGES %d  // Bitmap covers usages below this\n"
+                    % (NKRO_BYTES * 8))
+    if "hires-scroll" in features:
+        feat.append("#define HID_SCROLL_RESOLUTION %d\n" % SCROLL_RESOLUTION)
+    feat.append("\n#define KEYBOARD_MOUSE_EPSIZE %d  // Largest input report + ID\n" % ep_size)
+    feat.append("#define KEYBOARD_MOUSE_INTERVAL %d  // EP1 IN bInterval, ms\n"
+                % (1 if "fast-poll" in features else 10))
+
+    desc = [head, "\n#pragma once\n\n"]
+    items = [it for _, block in blocks for it in block]
+    total = sum(len(b) for b, _ in items)
+    desc.append("// %d bytes\n" % total)
+    desc.append("__code uint8_t ReportDescriptor[] = {\n")
+    for name, block in blocks:
+        desc.append("    // %s - Report ID %d\n" % (name.title().replace("_", " "),
+                                                     dict(active)[name]))
+        desc.append("\n".join(listing(block)) + "\n")
+    desc.append("};\n")
+    if raw:
+        desc.append("\n#ifdef USB_CONFIG_ENDPOINT\n")
+        desc.append("// Raw HID config interface: 64-byte input and output reports, no report\n"
+                    "// ID (byte 0 of the payload is still 0xF0, as in the Feature Report)\n")
+        desc.append("__code uint8_t ConfigReportDescriptor[] = {\n")
+        desc.append("\n".join(listing(raw)) + "\n};\n#endif\n")
+    desc.append("\n// String Descriptors\n")
+    desc.append("__code uint8_t LanguageDescriptor[] = {0x04, 0x03, 0x09, 0x04};\n")
+    desc.append("// Serial String Descriptor - chip ID in hex, see USB_initSerial()\n"
+                "__xdata uint16_t SerialDescriptor[1 + USB_SERIAL_CHARS];\n")
+    desc.append(string_descriptor("ProductDescriptor", PRODUCT, "Product String Descriptor"))
+    desc.append(string_descriptor("ManufacturerDescriptor", MANUFACTURER,
+                                  "Manufacturer String Descriptor"))
+    return "".join(feat), "".join(desc), total
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("--features", default=",".join(DEFAULT_FEATURES),
+                    help="comma-separated subset of: %s (default: %s)"
+                    % (", ".join(FEATURES), ",".join(DEFAULT_FEATURES)))
+    ap.add_argument("-o", "--out-dir", default=DEFAULT_OUT,
+                    help="directory for usb_features.h / usb_descriptors.h")
+    ap.add_argument("--check", action="store_true",
+                    help="compare with the existing headers instead of writing")
+    ap.add_argument("--show", action="store_true", help="print the headers only")
+    args = ap.parse_args()
+
+    features = set(f for f in args.features.split(",") if f)
+    unknown = features - set(FEATURES)
+    if unknown:
+        ap.error("unknown feature(s): %s" % ", ".join(sorted(unknown)))
+
+    try:
+        blocks, sizes, ep_size, raw = build(features)
+    except DescError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    feat, desc, total = render(features, blocks, sizes, ep_size, raw)
+
+    if args.show:
+        sys.stdout.write(feat + "\n" + desc)
+        return 0
+
+    outputs = (("usb_features.h", feat), ("usb_descriptors.h", desc))
+    if args.check:
+        stale = []
+        for name, text in outputs:
+            path = os.path.join(args.out_dir, name)
+            try:
+                with open(path, newline="") as f:
+                    if f.read() != text:
+                        stale.append(name)
+            except OSError:
+                stale.append(name)
+        if stale:
+            print("stale: %s (rerun tools/usb_descgen.py --features %s)"
+                  % (", ".join(stale), ",".join(sorted(features)) or "''"),
+                  file=sys.stderr)
+            return 1
+        return 0
+
+    for name, text in outputs:
+        with open(os.path.join(args.out_dir, name), "w", newline="\n") as f:
+            f.write(text)
+    print("report descriptor %d bytes, EP1 size %d, features: %s"
+          % (total, ep_size, ",".join(sorted(features)) or "none"), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
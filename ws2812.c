@@ -5,8 +5,12 @@
 #include <Arduino.h>
 #include "ws2812.h"
 
-// Pin definition for assembly (P3.4 = bit 4 of port 3 at 0xB0)
-__sbit __at (0xB0+4) WS2812_PIN_BIT;  // P3.4
+#if F_CPU != 16000000
+#error "WS2812 timing below is tuned for a 16 MHz clock"
+#endif
+
+// Pin definition for assembly (bit address of BOARD_LED_PIN)
+__sbit __at (BOARD_SBIT_ADDR(BOARD_LED_PIN)) WS2812_PIN_BIT;
 
 // LED buffer (GRB format: 3 bytes per LED)
 uint8_t WS2812_buffer[3 * WS2812_COUNT];
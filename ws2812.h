@@ -3,18 +3,18 @@
 // ===================================================================================
 //
 // Adapted from neo.c by Stefan Wagner for CH552G Arduino environment.
-// Supports 3 WS2812 LEDs in GRB format at 16MHz system clock.
+// Drives the board's WS2812 chain in GRB format at 16MHz system clock.
 //
-// Pin: P3.4 (Arduino pin 34) - WS2812 DATA line
-// LEDs: 3 × WS2812 addressable RGB LEDs
+// Pin and LED count come from board.h (BOARD_LED_PIN, BOARD_LED_COUNT).
 // ===================================================================================
 
 #pragma once
 #include <stdint.h>
+#include "board.h"
 
 // Configuration
-#define WS2812_COUNT     3       // Number of LEDs
-#define WS2812_PIN       34      // P3.4 (matches PIN_LED in main code)
+#define WS2812_COUNT     BOARD_LED_COUNT             // Number of LEDs
+#define WS2812_PIN       BOARD_PIN(BOARD_LED_PIN)    // Arduino pin number
 
 // Public Functions
 void WS2812_init(void);                                               // Initialize WS2812 output pin